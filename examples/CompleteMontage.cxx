@@ -18,6 +18,7 @@
 
 #include "itkAffineTransform.h"
 #include "itkImageFileWriter.h"
+#include "itkLuminanceImageAdaptor.h"
 #include "itkTileConfiguration.h"
 #include "itkRGBPixel.h"
 #include "itkRGBAPixel.h"
@@ -261,15 +262,15 @@ dividePixel(PixelType pixel, float divisor)
   return result;
 }
 
-template <typename PixelType, unsigned Dimension>
-typename itk::Image<PixelType, Dimension>::Pointer
-CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
-            typename LogBiasFieldType<Dimension>::Pointer      bsplineLattice)
+// reconstructs the multiplicative bias field on the image grid of the reference image
+template <unsigned Dimension>
+typename itk::Image<float, Dimension>::Pointer
+GetMultiplicativeBiasField(const itk::ImageBase<Dimension> *             reference,
+                           typename LogBiasFieldType<Dimension>::Pointer bsplineLattice)
 {
-  using ImageType = itk::Image<PixelType, Dimension>;
   using RealImageType = itk::Image<float, Dimension>;
 
-  typename ImageType::RegionType region = image->GetLargestPossibleRegion();
+  typename RealImageType::RegionType region = reference->GetLargestPossibleRegion();
 
   using ScalarImageType = typename N4Filter<Dimension>::ScalarImageType;
   using BSplinerType = itk::BSplineControlPointImageFilter<LogBiasFieldType<Dimension>, ScalarImageType>;
@@ -277,9 +278,9 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
   bspliner->SetInput(bsplineLattice);
   bspliner->SetSplineOrder(splineOrder);
   bspliner->SetSize(region.GetSize());
-  bspliner->SetOrigin(image->GetOrigin());
-  bspliner->SetDirection(image->GetDirection());
-  bspliner->SetSpacing(image->GetSpacing());
+  bspliner->SetOrigin(reference->GetOrigin());
+  bspliner->SetDirection(reference->GetDirection());
+  bspliner->SetSpacing(reference->GetSpacing());
   bspliner->Update();
   typename ScalarImageType::Pointer logBiasField = bspliner->GetOutput();
 
@@ -294,6 +295,7 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
   expFilter->SetInput(logBiasField);
   expFilter->Update();
   typename RealImageType::Pointer mulField = expFilter->GetOutput();
+  region = mulField->GetLargestPossibleRegion();
 
   std::mutex sumMutex;
   double     sum = 0.0;
@@ -302,7 +304,7 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
   itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
   mt->ParallelizeImageRegion<Dimension>(
     region,
-    [mulField, &sum, &sumMutex](const typename ImageType::RegionType & subRegion) {
+    [mulField, &sum, &sumMutex](const typename RealImageType::RegionType & subRegion) {
       double threadSum = 0.0;
 
       itk::ImageRegionConstIterator<RealImageType> ItM(mulField, subRegion);
@@ -320,7 +322,7 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
 
   mt->ParallelizeImageRegion<Dimension>(
     region,
-    [mulField, diff](const typename ImageType::RegionType & subRegion) {
+    [mulField, diff](const typename RealImageType::RegionType & subRegion) {
       itk::ImageRegionIterator<RealImageType> ItM(mulField, subRegion);
       for (ItM.GoToBegin(); !ItM.IsAtEnd(); ++ItM)
       {
@@ -329,6 +331,19 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
     },
     nullptr);
 
+  return mulField;
+}
+
+template <typename PixelType, unsigned Dimension>
+typename itk::Image<PixelType, Dimension>::Pointer
+CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
+            typename LogBiasFieldType<Dimension>::Pointer      bsplineLattice)
+{
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using RealImageType = itk::Image<float, Dimension>;
+
+  typename RealImageType::Pointer mulField = GetMultiplicativeBiasField<Dimension>(image, bsplineLattice);
+
   using CustomBinaryFilter = itk::BinaryGeneratorImageFilter<ImageType, RealImageType, ImageType>;
   typename CustomBinaryFilter::Pointer expAndDivFilter = CustomBinaryFilter::New();
   auto expAndDivLambda = [](PixelType input, float biasField) { return dividePixel(input, biasField); };
@@ -340,6 +355,87 @@ CorrectBias(typename itk::Image<PixelType, Dimension>::Pointer image,
   return expAndDivFilter->GetOutput();
 }
 
+// Adds the tile's luminance, normalized by its mean, to the per-pixel sum of all tiles.
+// Normalization makes bright and dark tiles contribute equally, and averaging over many tiles
+// suppresses their content, leaving the illumination profile they share. Only the sum is kept,
+// so tiles can be accumulated one at a time as they are read.
+template <typename PixelType, unsigned Dimension>
+void
+AccumulateFlatField(const itk::Image<PixelType, Dimension> * tile, typename itk::Image<float, Dimension>::Pointer & sum)
+{
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using RealImageType = itk::Image<float, Dimension>;
+  const typename ImageType::RegionType region = tile->GetLargestPossibleRegion();
+  if (sum.IsNull())
+  {
+    sum = RealImageType::New();
+    sum->SetRegions(region.GetSize()); // tiles are matched pixel-for-pixel, regardless of their index or origin
+    sum->SetSpacing(tile->GetSpacing());
+    sum->Allocate(true);
+  }
+  else if (sum->GetLargestPossibleRegion().GetSize() != region.GetSize())
+  {
+    itkGenericExceptionMacro("Shared flat-field estimation requires all tiles to have the same size. Tile size "
+                             << region.GetSize() << " differs from " << sum->GetLargestPossibleRegion().GetSize()
+                             << ". Use per-tile bias correction instead.");
+  }
+
+  const itk::Accessor::LuminancePixelAccessor<PixelType, float> luminance;
+  itk::ImageRegionConstIterator<ImageType>                      tIt(tile, region);
+
+  double tileSum = 0.0;
+  for (tIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt)
+  {
+    tileSum += luminance.Get(tIt.Get());
+  }
+  const double mean = tileSum / region.GetNumberOfPixels();
+  if (mean <= 0.0)
+  {
+    return; // a blank tile carries no information about the illumination
+  }
+
+  itk::ImageRegionIterator<RealImageType> sIt(sum, sum->GetLargestPossibleRegion());
+  for (tIt.GoToBegin(); !tIt.IsAtEnd(); ++tIt, ++sIt)
+  {
+    sIt.Set(sIt.Get() + luminance.Get(tIt.Get()) / mean);
+  }
+}
+
+// divides the image by the multiplicative field, pixel-for-pixel, in place
+template <typename PixelType, unsigned Dimension>
+void
+ApplyFlatField(itk::Image<PixelType, Dimension> * image, const itk::Image<float, Dimension> * mulField)
+{
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using RealImageType = itk::Image<float, Dimension>;
+  using RegionType = typename RealImageType::RegionType;
+  const typename ImageType::OffsetType fieldToImage =
+    image->GetLargestPossibleRegion().GetIndex() - mulField->GetLargestPossibleRegion().GetIndex();
+
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeImageRegion<Dimension>(
+    mulField->GetLargestPossibleRegion(),
+    [image, mulField, fieldToImage](const RegionType & subRegion) {
+      RegionType imageRegion = subRegion;
+      imageRegion.SetIndex(subRegion.GetIndex() + fieldToImage);
+      itk::ImageRegionConstIterator<RealImageType> ItM(mulField, subRegion);
+      itk::ImageRegionIterator<ImageType>          ItI(image, imageRegion);
+      for (; !ItM.IsAtEnd(); ++ItM, ++ItI)
+      {
+        ItI.Set(dividePixel(ItI.Get(), ItM.Get()));
+      }
+    },
+    nullptr);
+}
+
+// how tile intensities are corrected for uneven illumination
+enum class BiasCorrection : unsigned
+{
+  None = 0,
+  PerTile = 1,        // N4 on every tile, much slower
+  SharedFlatField = 2 // one model estimated from all the tiles
+};
+
 // use SFINAE to select whether to do simple assignment or RGB to Luminance conversion
 template <typename RGBImage, typename ScalarImage>
 typename std::enable_if<std::is_same<RGBImage, ScalarImage>::value, void>::type
@@ -366,14 +462,16 @@ completeMontage(const itk::TileConfiguration<Dimension> & stageTiles,
                 const std::string &                       inputPath,
                 const std::string &                       outputPath,
                 const std::string &                       outFilename,
-                bool                                      correctBias,
-                bool                                      denoiseTiles)
+                BiasCorrection                            biasCorrection,
+                bool                                      denoiseTiles,
+                bool                                      writeIntermediates)
 {
   using TileConfig = itk::TileConfiguration<Dimension>;
   using ScalarPixelType = typename itk::NumericTraits<PixelType>::ValueType;
   using TransformType = itk::TranslationTransform<double, Dimension>;
   using ScalarImageType = itk::Image<ScalarPixelType, Dimension>;
   using OriginalImageType = itk::Image<PixelType, Dimension>; // possibly RGB instead of scalar
+  using RealImageType = itk::Image<float, Dimension>;
   using BiasFieldType = LogBiasFieldType<Dimension>;
   typename ScalarImageType::SpacingType sp;
   sp.Fill(1.0);
@@ -381,16 +479,11 @@ completeMontage(const itk::TileConfiguration<Dimension> & stageTiles,
   TileConfig actualTiles = stageTiles; // we will update it later
 
   std::vector<typename OriginalImageType::Pointer> oImages(stageTiles.LinearSize());
-  std::vector<typename ScalarImageType::Pointer>   sImages(stageTiles.LinearSize());
-  std::vector<typename BiasFieldType::Pointer>     bImages(stageTiles.LinearSize());
+  typename RealImageType::Pointer                  flatFieldSum; // accumulated during reading
   std::cout << "Reading";
-  if (denoiseTiles)
+  if (biasCorrection == BiasCorrection::SharedFlatField)
   {
-    std::cout << ", denoising";
-  }
-  if (correctBias)
-  {
-    std::cout << ", bias-correcting";
+    std::cout << " and accumulating flat-field of";
   }
   std::cout << " input tiles...\n";
   typename TileConfig::TileIndexType ind;
@@ -410,56 +503,114 @@ completeMontage(const itk::TileConfiguration<Dimension> & stageTiles,
     }
     image->SetOrigin(origin);
 
+    if (biasCorrection == BiasCorrection::SharedFlatField)
+    {
+      AccumulateFlatField<PixelType, Dimension>(image, flatFieldSum);
+    }
+    oImages[t] = image;
+
+    // show image loading progress
+    ind = stageTiles.LinearIndexToNDIndex(t);
+    std::cout << " " << ind << "  " << t + 1 << "/" << stageTiles.LinearSize() << std::endl;
+  }
+  std::cout << std::endl;
+
+  typename RealImageType::Pointer mulField;
+  if (biasCorrection == BiasCorrection::SharedFlatField)
+  {
+    // N4 is run only once, on the average of all tiles
+    std::cout << "Estimating shared flat-field...";
+    typename BiasFieldType::Pointer bImage = GetLogBiasField<float, Dimension>(flatFieldSum);
+    mulField = GetMultiplicativeBiasField<Dimension>(flatFieldSum, bImage);
+    flatFieldSum = nullptr;
+    if (writeIntermediates)
+    {
+      WriteImage(mulField.GetPointer(), (outputPath + "flatField.nrrd").c_str(), true);
+    }
+    std::cout << std::endl;
+  }
+
+  // denoising and bias correction are done by montage's worker threads,
+  // in parallel with each other and with registration of the tiles already preprocessed
+  std::vector<char> preprocessed(stageTiles.LinearSize(), false); // not vector<bool>, it is written concurrently
+  auto preprocessTile = [&](OriginalImageType * tile, itk::SizeValueType t) {
+    typename OriginalImageType::Pointer image = tile;
     if (denoiseTiles)
     {
       // geometric average perserves equivalent voxel volume
       double avgSpacing = 1.0;
       for (unsigned d = 0; d < Dimension; d++)
       {
-        avgSpacing *= sp[d];
+        avgSpacing *= image->GetSpacing()[d];
       }
       avgSpacing = std::pow(avgSpacing, 1.0 / Dimension);
 
       image = denoiseImage<PixelType, Dimension>(image, avgSpacing);
-      WriteImage(image.GetPointer(), (outputPath + stageTiles.Tiles[t].FileName + "-bil.nrrd").c_str(), true);
+      if (writeIntermediates)
+      {
+        WriteImage(image.GetPointer(), (outputPath + stageTiles.Tiles[t].FileName + "-bil.nrrd").c_str(), true);
+      }
       std::cout << 'D' << std::flush;
     }
 
-    assignRGBtoScalar<OriginalImageType, ScalarImageType>(image, sImages[t]);
-
-    if (correctBias)
+    if (biasCorrection == BiasCorrection::SharedFlatField)
     {
-      bImages[t] = GetLogBiasField<ScalarPixelType, Dimension>(sImages[t]); // input image must be scalar
-      image = CorrectBias<PixelType, Dimension>(image, bImages[t]);
-
-      assignRGBtoScalar<OriginalImageType, ScalarImageType>(image, sImages[t]);
+      ApplyFlatField<PixelType, Dimension>(image, mulField); // cheap, so done in place
+      std::cout << 'F' << std::flush;
+    }
+    else if (biasCorrection == BiasCorrection::PerTile)
+    {
+      typename ScalarImageType::Pointer sImage; // N4 needs a scalar image, but only temporarily
+      assignRGBtoScalar<OriginalImageType, ScalarImageType>(image, sImage);
+      typename BiasFieldType::Pointer bImage = GetLogBiasField<ScalarPixelType, Dimension>(sImage);
+      sImage = nullptr;
+      image = CorrectBias<PixelType, Dimension>(image, bImage);
+      std::cout << 'B' << std::flush;
+    }
 
-      // write bias-corrected image
+    if (biasCorrection != BiasCorrection::None && writeIntermediates)
+    {
+      // write bias-corrected image, and refer to it from the registered tile configuration
       std::string fileNameExt = itksys::SystemTools::GetFilenameLastExtension(stageTiles.Tiles[t].FileName);
       std::string baseFileName = itksys::SystemTools::GetFilenameWithoutLastExtension(stageTiles.Tiles[t].FileName);
       std::string flatFileName = baseFileName + "-flat" + fileNameExt;
       actualTiles.Tiles[t].FileName = flatFileName;
       WriteImage(image.GetPointer(), (outputPath + flatFileName).c_str(), true);
     }
-    oImages[t] = image;
 
-    // show image loading progress
-    ind = stageTiles.LinearIndexToNDIndex(t);
-    std::cout << " " << ind << "  " << t + 1 << "/" << stageTiles.LinearSize() << std::endl;
-  }
-  std::cout << std::endl;
+    oImages[t] = image; // resampler uses the preprocessed tiles
+    preprocessed[t] = true;
+    return image;
+  };
+  const bool preprocessingNeeded = denoiseTiles || biasCorrection != BiasCorrection::None;
 
   std::cout << "Doing tile pair registrations and position optimization...";
-  using MontageType = itk::TileMontage<ScalarImageType>;
+  // color tiles are registered using their luminance, computed on the fly
+  using MontageType = itk::TileMontage<OriginalImageType>;
   typename MontageType::Pointer montage = MontageType::New();
   montage->SetMontageSize(stageTiles.AxisSizes);
   for (size_t t = 0; t < stageTiles.LinearSize(); t++)
   {
-    montage->SetInputTile(t, sImages[t]);
+    montage->SetInputTile(t, oImages[t]);
+  }
+  if (preprocessingNeeded)
+  {
+    montage->SetTilePreprocessor(preprocessTile);
+    // preprocessing is single-threaded per tile, so we want one tile per thread
+    montage->SetNumberOfWorkUnits(itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
   }
   montage->Update(); // calculate registration transforms
   std::cout << std::endl;
 
+  // tiles which are not a part of any registration pair (single tile montage)
+  for (size_t t = 0; t < stageTiles.LinearSize() && preprocessingNeeded; t++)
+  {
+    if (!preprocessed[t])
+    {
+      preprocessTile(oImages[t], t);
+    }
+  }
+
   // instantiate the resampling class
   using Resampler = itk::TileMergeImageFilter<OriginalImageType, AccumulatePixelType>;
   typename Resampler::Pointer resampleF = Resampler::New();
@@ -489,8 +640,18 @@ completeMontage(const itk::TileConfiguration<Dimension> & stageTiles,
   actualTiles.Write(outputPath + "TileConfiguration.registered.txt");
   std::cout << std::endl;
 
-  std::cout << "Resampling the tiles into the final single image...";
   // resampleF->DebugOn(); // generate an image of contributing regions
+  if (itksys::SystemTools::LowerCase(itksys::SystemTools::GetFilenameLastExtension(outFilename)) == ".nrrd" &&
+      Resampler::CanWriteCompressedNrrd()) // otherwise, ImageIO writes whatever it can
+  {
+    // slabs are compressed in parallel, and written while later slabs are being resampled
+    std::cout << "Resampling the tiles into the final single image, and writing it...";
+    resampleF->WriteCompressedNrrd(outFilename);
+    std::cout << "Done!" << std::endl;
+    return;
+  }
+
+  std::cout << "Resampling the tiles into the final single image...";
   resampleF->Update(); // invoke this explicitly, because writing itself can take a while due to compression
   std::cout << std::endl;
 
@@ -508,22 +669,23 @@ completeMontage(const itk::TileConfiguration<Dimension> & stageTiles,
                 const std::string &                       outputPath,
                 const std::string &                       outFilename,
                 itk::IOPixelEnum                          pixelType,
-                bool                                      correctBias,
-                bool                                      denoise)
+                BiasCorrection                            biasCorrection,
+                bool                                      denoise,
+                bool                                      writeIntermediates)
 {
   switch (pixelType)
   {
     case itk::IOPixelEnum::SCALAR:
       completeMontage<Dimension, ComponentType, AccumulatePixelType>(
-        stageTiles, inputPath, outputPath, outFilename, correctBias, denoise);
+        stageTiles, inputPath, outputPath, outFilename, biasCorrection, denoise, writeIntermediates);
       break;
     case itk::IOPixelEnum::RGB:
       completeMontage<Dimension, itk::RGBPixel<ComponentType>, itk::RGBPixel<AccumulatePixelType>>(
-        stageTiles, inputPath, outputPath, outFilename, correctBias, denoise);
+        stageTiles, inputPath, outputPath, outFilename, biasCorrection, denoise, writeIntermediates);
       break;
     case itk::IOPixelEnum::RGBA:
       completeMontage<Dimension, itk::RGBAPixel<ComponentType>, itk::RGBAPixel<AccumulatePixelType>>(
-        stageTiles, inputPath, outputPath, outFilename, correctBias, denoise);
+        stageTiles, inputPath, outputPath, outFilename, biasCorrection, denoise, writeIntermediates);
       break;
     default:
       itkGenericExceptionMacro("Only sclar, RGB and RGBA images are supported!") break;
@@ -545,16 +707,26 @@ mainHelper(int argc, char * argv[], std::string inputPath)
     outFile = outputPath + outFile;
   }
 
-  bool doBiasCorrection = true;
+  BiasCorrection biasCorrection = BiasCorrection::PerTile;
   if (argc > 4)
   {
-    doBiasCorrection = std::stoi(argv[4]);
+    biasCorrection = static_cast<BiasCorrection>(std::stoul(argv[4]));
+    if (biasCorrection > BiasCorrection::SharedFlatField)
+    {
+      itkGenericExceptionMacro("Bias correction needs to be 0 (none), 1 (per-tile N4) or 2 (shared flat-field), not "
+                               << argv[4]);
+    }
   }
   bool doDenoising = true;
   if (argc > 5)
   {
     doDenoising = std::stoi(argv[5]);
   }
+  bool writeIntermediates = true;
+  if (argc > 6)
+  {
+    writeIntermediates = std::stoi(argv[6]);
+  }
 
   itk::TileConfiguration<Dimension> stageTiles;
   stageTiles.Parse(inputPath + "TileConfiguration.txt");
@@ -579,15 +751,15 @@ mainHelper(int argc, char * argv[], std::string inputPath)
   {
     case itk::IOComponentEnum::UCHAR:
       completeMontage<Dimension, unsigned char, unsigned int>(
-        stageTiles, inputPath, outputPath, outFile, pixelType, doBiasCorrection, doDenoising);
+        stageTiles, inputPath, outputPath, outFile, pixelType, biasCorrection, doDenoising, writeIntermediates);
       break;
     case itk::IOComponentEnum::USHORT:
       completeMontage<Dimension, unsigned short, double>(
-        stageTiles, inputPath, outputPath, outFile, pixelType, doBiasCorrection, doDenoising);
+        stageTiles, inputPath, outputPath, outFile, pixelType, biasCorrection, doDenoising, writeIntermediates);
       break;
     case itk::IOComponentEnum::SHORT:
       completeMontage<Dimension, short, double>(
-        stageTiles, inputPath, outputPath, outFile, pixelType, doBiasCorrection, doDenoising);
+        stageTiles, inputPath, outputPath, outFile, pixelType, biasCorrection, doDenoising, writeIntermediates);
       break;
     default: // instantiating too many types leads to long compilation time and big executable
       itkGenericExceptionMacro(
@@ -605,8 +777,10 @@ main(int argc, char * argv[])
   {
     std::cout << "Usage: " << std::endl;
     std::cout << argv[0]
-              << " <directoryWtihInputData> <outputDirectory> <outputFilename> [biasCorrection] [tileDenoising]"
+              << " <directoryWtihInputData> <outputDirectory> <outputFilename>"
+              << " [biasCorrection] [tileDenoising] [writeIntermediates]"
               << std::endl;
+    std::cout << "biasCorrection: 0 = none, 1 = per-tile N4 (default), 2 = shared flat-field" << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -0,0 +1,572 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// Microbenchmarks of the Montage module's hot kernels. Each kernel is timed
+// in isolation, over a grid of image sizes, dimensions and pixel types.
+// Results are written as JSON, to compare commits and machines.
+
+#include "itkImageDuplicator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkNMinimaMaximaImageCalculator.h"
+#include "itkPhaseCorrelationImageRegistrationMethod.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkTileMergeImageFilter.h"
+#include "itkTileMontage.h"
+#include "itkTimeProbe.h"
+#include "itkVersion.h"
+
+#include <fstream>
+#include <sstream>
+
+struct BenchmarkSettings
+{
+  double   minSeconds = 0.5; // each measurement is repeated for at least this long
+  unsigned minRepetitions = 3;
+  unsigned maxRepetitions = 1000;
+};
+
+// accumulates JSON records of all the measurements
+class BenchmarkResults
+{
+public:
+  void
+  Add(const std::string &    kernel,
+      unsigned               dimension,
+      const std::string &    pixelType,
+      unsigned               size,
+      const std::string &    variant,
+      const itk::TimeProbe & probe,
+      double                 pixelsPerRepetition)
+  {
+    std::ostringstream record;
+    record << "    {\"kernel\": \"" << kernel << "\", \"dimension\": " << dimension << ", \"pixelType\": \""
+           << pixelType << "\", \"size\": " << size << ", \"variant\": \"" << variant
+           << "\", \"repetitions\": " << probe.GetNumberOfStops() << ", \"meanSeconds\": " << probe.GetMean()
+           << ", \"minSeconds\": " << probe.GetMinimum() << ", \"stdDevSeconds\": " << probe.GetStandardDeviation();
+    if (pixelsPerRepetition > 0 && probe.GetMinimum() > 0)
+    {
+      record << ", \"megapixelsPerSecond\": " << pixelsPerRepetition / probe.GetMinimum() / 1e6;
+    }
+    record << "}";
+    m_Records.push_back(record.str());
+
+    std::cout << kernel << ' ' << dimension << "D " << pixelType << ' ' << size << ' ' << variant << ": "
+              << probe.GetMean() << "s mean, " << probe.GetMinimum() << "s min" << std::endl;
+  }
+
+  void
+  Write(std::ostream & out) const
+  {
+    out << "{\n";
+    out << "  \"itkVersion\": \"" << itk::Version::GetITKVersion() << "\",\n";
+    out << "  \"threads\": " << itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() << ",\n";
+    using PCMType = itk::PhaseCorrelationImageRegistrationMethod<itk::Image<float, 2>, itk::Image<float, 2>>;
+    const auto capabilities = PCMType::GetFFTBackendCapabilities(PCMType::FFTBackendEnum::Default);
+    const bool vnl = capabilities.Implementation == PCMType::FFTBackendEnum::VNL;
+    const bool fftw = capabilities.Implementation == PCMType::FFTBackendEnum::FFTW;
+    out << "  \"fft\": \"" << (vnl ? "VNL" : (fftw ? "FFTW" : "other")) << "\",\n";
+    out << "  \"fftMultiThreaded\": " << (capabilities.MultiThreaded ? "true" : "false") << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < m_Records.size(); i++)
+    {
+      out << m_Records[i] << (i + 1 < m_Records.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+  }
+
+private:
+  std::vector<std::string> m_Records;
+};
+
+// setup is not timed, it prepares inputs which the timed function consumes
+template <typename TSetup, typename TFunction>
+itk::TimeProbe
+TimeRepeatedly(const BenchmarkSettings & settings, TSetup setup, TFunction function)
+{
+  setup();
+  function(); // warm-up: allocations, FFT plans, caches
+  itk::TimeProbe probe;
+  while (probe.GetNumberOfStops() < settings.maxRepetitions &&
+         (probe.GetNumberOfStops() < settings.minRepetitions || probe.GetTotal() < settings.minSeconds))
+  {
+    setup();
+    probe.Start();
+    function();
+    probe.Stop();
+  }
+  return probe;
+}
+
+template <typename TFunction>
+itk::TimeProbe
+TimeRepeatedly(const BenchmarkSettings & settings, TFunction function)
+{
+  return TimeRepeatedly(settings, []() {}, function);
+}
+
+template <typename TImage>
+typename TImage::Pointer
+Duplicate(const TImage * image)
+{
+  using DuplicatorType = itk::ImageDuplicator<TImage>;
+  typename DuplicatorType::Pointer dup = DuplicatorType::New();
+  dup->SetInputImage(image);
+  dup->Update();
+  return dup->GetOutput();
+}
+
+template <typename TImage>
+typename TImage::Pointer
+MakeRandomImage(const typename TImage::RegionType & region, unsigned seed)
+{
+  using PixelType = typename TImage::PixelType;
+  using RandomType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+  RandomType::Pointer rng = RandomType::New();
+  rng->SetSeed(seed);
+  const double maxValue = std::is_floating_point<PixelType>::value ? 1.0 : itk::NumericTraits<PixelType>::max();
+
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(region);
+  image->Allocate();
+  itk::ImageRegionIterator<TImage> it(image, region);
+  for (; !it.IsAtEnd(); ++it)
+  {
+    it.Set(static_cast<PixelType>(rng->GetUniformVariate(0.0, maxValue)));
+  }
+  return image;
+}
+
+template <typename TImage>
+typename TImage::Pointer
+CutTile(const TImage * whole, const typename TImage::RegionType & region)
+{
+  using RoIType = itk::RegionOfInterestImageFilter<TImage, TImage>;
+  typename RoIType::Pointer roi = RoIType::New();
+  roi->SetInput(whole);
+  roi->SetRegionOfInterest(region);
+  roi->Update();
+  typename TImage::Pointer tile = roi->GetOutput();
+  tile->DisconnectPipeline();
+  return tile;
+}
+
+// The moving tile is expected to overlap the fixed one by 20% along the first axis,
+// but it is actually 3 pixels off along every axis.
+template <typename TImage>
+std::pair<typename TImage::Pointer, typename TImage::Pointer>
+MakeTilePair(unsigned size)
+{
+  constexpr unsigned     Dimension = TImage::ImageDimension;
+  typename TImage::SizeType wholeSize;
+  wholeSize.Fill(size + 8);
+  wholeSize[0] = 2 * size;
+  typename TImage::RegionType wholeRegion(wholeSize);
+  typename TImage::Pointer    whole = MakeRandomImage<TImage>(wholeRegion, 1983);
+
+  typename TImage::SizeType tileSize;
+  tileSize.Fill(size);
+  typename TImage::RegionType tileRegion(tileSize);
+  typename TImage::Pointer    fixed = CutTile<TImage>(whole, tileRegion);
+
+  typename TImage::IndexType movingIndex;
+  movingIndex.Fill(3);
+  movingIndex[0] += 4 * size / 5;
+  tileRegion.SetIndex(movingIndex);
+  typename TImage::Pointer   moving = CutTile<TImage>(whole, tileRegion);
+  typename TImage::PointType expectedOrigin;
+  expectedOrigin.Fill(0.0);
+  expectedOrigin[0] = 4 * size / 5;
+  moving->SetOrigin(expectedOrigin);
+
+  static_assert(Dimension >= 2, "Tile pairs need at least 2 dimensions");
+  return { fixed, moving };
+}
+
+// everything except the last "::"-separated part
+std::string
+ShortEnumName(const std::string & name)
+{
+  return name.substr(name.rfind(':') + 1);
+}
+
+template <typename TImage>
+void
+BenchmarkRegistration(const std::string &       pixelName,
+                      unsigned                  size,
+                      const BenchmarkSettings & settings,
+                      BenchmarkResults &        results)
+{
+  constexpr unsigned Dimension = TImage::ImageDimension;
+  using PCMType = itk::PhaseCorrelationImageRegistrationMethod<TImage, TImage>;
+  using OperatorType = typename PCMType::OperatorType;
+  using OptimizerType = typename PCMType::OptimizerType;
+  using RealImageType = typename PCMType::RealImageType;
+  using ComplexImageType = typename PCMType::ComplexImageType;
+  using CalculatorType = itk::NMinimaMaximaImageCalculator<RealImageType>;
+
+  auto         tiles = MakeTilePair<TImage>(size);
+  const double tilePixels = tiles.first->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  // per pair, as in TileMontage::RegisterPair()
+  typename PCMType::Pointer pcm;
+  for (bool crop : { true, false })
+  {
+    itk::TimeProbe probe = TimeRepeatedly(settings, [&]() {
+      pcm = PCMType::New();
+      pcm->SetOperator(OperatorType::New());
+      pcm->SetOptimizer(OptimizerType::New());
+      pcm->SetCropToOverlap(crop);
+      pcm->SetFixedImage(tiles.first);
+      pcm->SetMovingImage(tiles.second);
+      pcm->Update();
+    });
+    results.Add("PhaseCorrelationImageRegistrationMethod",
+                Dimension,
+                pixelName,
+                size,
+                crop ? "CropToOverlap" : "NoCrop",
+                probe,
+                2 * tilePixels);
+  }
+
+  // the last registration was without cropping, so its intermediate images have the full tile extent
+  // copies are made so repeated updates below do not trigger the rest of the registration pipeline
+  typename ComplexImageType::Pointer fixedFFT = Duplicate<ComplexImageType>(pcm->GetFixedImageFFT());
+  typename ComplexImageType::Pointer movingFFT = Duplicate<ComplexImageType>(pcm->GetMovingImageFFT());
+  typename ComplexImageType::Pointer complexSurface = Duplicate<ComplexImageType>(pcm->GetComplexCorrelationSurface());
+  typename RealImageType::Pointer    realSurface = Duplicate<RealImageType>(pcm->GetPhaseCorrelationImage());
+  const double                       surfacePixels = realSurface->GetLargestPossibleRegion().GetNumberOfPixels();
+  pcm = nullptr;
+
+  typename OperatorType::Pointer pcmOperator = OperatorType::New();
+  pcmOperator->SetFixedImage(fixedFFT);
+  pcmOperator->SetMovingImage(movingFFT);
+  itk::TimeProbe probe = TimeRepeatedly(settings, [&]() {
+    pcmOperator->Modified();
+    pcmOperator->Update();
+  });
+  results.Add("PhaseCorrelationOperator",
+              Dimension,
+              pixelName,
+              size,
+              "",
+              probe,
+              fixedFFT->GetLargestPossibleRegion().GetNumberOfPixels());
+
+  for (auto method : itk::PhaseCorrelationOptimizerEnums::AllPeakInterpolationMethods())
+  {
+    typename OptimizerType::Pointer optimizer = OptimizerType::New();
+    optimizer->SetFixedImage(tiles.first);
+    optimizer->SetMovingImage(tiles.second);
+    optimizer->SetRealInput(realSurface);
+    optimizer->SetComplexInput(complexSurface);
+    optimizer->SetPeakInterpolationMethod(method);
+    probe = TimeRepeatedly(settings, [&]() {
+      optimizer->SetOffsetCount(Dimension);
+      optimizer->Modified();
+      optimizer->Update();
+    });
+    std::ostringstream methodName;
+    methodName << method;
+    results.Add("PhaseCorrelationOptimizer::ComputeOffset",
+                Dimension,
+                pixelName,
+                size,
+                ShortEnumName(methodName.str()),
+                probe,
+                surfacePixels);
+  }
+
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
+  calculator->SetImage(realSurface);
+  calculator->SetN(Dimension);
+  probe = TimeRepeatedly(settings, [&]() { calculator->ComputeMaxima(); });
+  results.Add("NMinimaMaximaImageCalculator", Dimension, pixelName, size, "ComputeMaxima", probe, surfacePixels);
+}
+
+template <typename TImage>
+void
+BenchmarkMerge(const std::string &       pixelName,
+               unsigned                  size,
+               const BenchmarkSettings & settings,
+               BenchmarkResults &        results)
+{
+  constexpr unsigned Dimension = TImage::ImageDimension;
+  using MergeType = itk::TileMergeImageFilter<TImage, double>;
+  using TransformType = typename MergeType::TransformType;
+
+  // 2 tiles along each dimension, overlapping by 20%
+  const unsigned            stride = 4 * size / 5;
+  typename TImage::SizeType wholeSize;
+  wholeSize.Fill(stride + size);
+  typename TImage::Pointer whole = MakeRandomImage<TImage>(typename TImage::RegionType(wholeSize), 1984);
+
+  typename MergeType::SizeType montageSize;
+  montageSize.Fill(2);
+  for (bool interpolate : { false, true })
+  {
+    typename MergeType::Pointer merge = MergeType::New();
+    merge->SetMontageSize(montageSize);
+    for (itk::SizeValueType t = 0; t < (1u << Dimension); t++)
+    {
+      typename MergeType::TileIndexType ind;
+      typename TImage::RegionType       tileRegion;
+      for (unsigned d = 0; d < Dimension; d++)
+      {
+        ind[d] = (t >> d) & 1u;
+        tileRegion.SetIndex(d, ind[d] * stride);
+        tileRegion.SetSize(d, size);
+      }
+      merge->SetInputTile(ind, CutTile<TImage>(whole, tileRegion));
+
+      // sub-pixel translation requires interpolation
+      typename TransformType::Pointer     transform = TransformType::New();
+      typename TransformType::OutputVectorType offset;
+      offset.Fill(interpolate && t > 0 ? 0.5 : 0.0);
+      transform->SetOffset(offset);
+      merge->SetTileTransform(ind, transform);
+    }
+
+    itk::TimeProbe probe = TimeRepeatedly(settings, [&]() {
+      merge->Modified();
+      merge->Update();
+    });
+    results.Add("TileMergeImageFilter",
+                Dimension,
+                pixelName,
+                size,
+                interpolate ? "Linear" : "NoInterpolation",
+                probe,
+                merge->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels());
+  }
+}
+
+// exposes global optimization of tile positions, fed with synthetic registration candidates
+template <unsigned Dimension>
+class SyntheticGraphMontage : public itk::TileMontage<itk::Image<float, Dimension>>
+{
+public:
+  using Self = SyntheticGraphMontage;
+  using Superclass = itk::TileMontage<itk::Image<float, Dimension>>;
+  using Pointer = itk::SmartPointer<Self>;
+  itkNewMacro(Self);
+
+  // a grid of tiles with noisy pairwise offsets, and a few outliers
+  void
+  Initialize(unsigned tilesPerDimension, double outlierProbability, unsigned seed)
+  {
+    using ImageType = typename Superclass::ImageType;
+    typename Superclass::SizeType montageSize;
+    montageSize.Fill(tilesPerDimension);
+    this->SetMontageSize(montageSize);
+
+    // only metadata of the first tile is used
+    typename ImageType::Pointer tile0 = ImageType::New();
+    typename ImageType::SizeType tileSize;
+    tileSize.Fill(1);
+    tile0->SetRegions(tileSize);
+    tile0->Allocate();
+    this->SetInputTile(0, tile0);
+
+    using RandomType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+    RandomType::Pointer rng = RandomType::New();
+    rng->SetSeed(seed);
+    this->DeterminePairs(); // adjacent tiles of the grid
+    for (itk::SizeValueType p = 0; p < this->GetPairs().size(); p++)
+    {
+      typename Superclass::OffsetVector    offsets(Dimension);
+      typename Superclass::ConfidencesType confidences(Dimension);
+      for (unsigned c = 0; c < Dimension; c++)
+      {
+        bool outlier = c > 0 || rng->GetVariateWithClosedRange() < outlierProbability;
+        for (unsigned k = 0; k < Dimension; k++)
+        {
+          offsets[c][k] = outlier ? rng->GetUniformVariate(-50.0, 50.0) : rng->GetNormalVariate(0.0, 0.1);
+        }
+        confidences[c] = 1.0 / (c + 1);
+      }
+      this->SetPairCandidates(p, offsets, confidences);
+    }
+  }
+
+  void
+  Optimize()
+  {
+    this->OptimizeTiles();
+  }
+
+protected:
+  SyntheticGraphMontage() = default;
+};
+
+template <unsigned Dimension>
+void
+BenchmarkOptimizeTiles(unsigned tilesPerDimension, const BenchmarkSettings & settings, BenchmarkResults & results)
+{
+  using MontageType = SyntheticGraphMontage<Dimension>;
+  for (double outlierProbability : { 0.0, 0.05 })
+  {
+    typename MontageType::Pointer montage;
+    unsigned                      seed = 0;
+    // candidates are consumed by outlier elimination, so the graph is rebuilt before each run
+    itk::TimeProbe probe = TimeRepeatedly(
+      settings,
+      [&]() {
+        montage = MontageType::New();
+        montage->Initialize(tilesPerDimension, outlierProbability, ++seed);
+      },
+      [&]() { montage->Optimize(); });
+    results.Add("TileMontage::OptimizeTiles",
+                Dimension,
+                "",
+                tilesPerDimension,
+                outlierProbability > 0 ? "Outliers5%" : "NoOutliers",
+                probe,
+                0);
+  }
+}
+
+// registration and global optimization of a whole mosaic, whose tiles are generated on demand
+template <unsigned Dimension>
+void
+BenchmarkSyntheticMontage(unsigned tilesPerDimension, const BenchmarkSettings & settings, BenchmarkResults & results)
+{
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+
+  const unsigned                  tileSize = Dimension == 2 ? 128 : 32;
+  typename GeneratorType::Pointer generator = GeneratorType::New();
+  typename MontageType::SizeType  montageSize;
+  montageSize.Fill(tilesPerDimension);
+  generator->SetMontageSize(montageSize);
+  typename ImageType::SizeType size;
+  size.Fill(tileSize);
+  generator->SetTileSize(size);
+  generator->SetAmplitude(4000);
+  generator->SetNoiseAmplitude(100);
+
+  for (bool tiered : { false, true })
+  {
+    for (double outlierFraction : { 0.0, 0.05 })
+    {
+      generator->SetOutlierFraction(outlierFraction);
+      typename MontageType::Pointer montage;
+      itk::TimeProbe                probe = TimeRepeatedly(
+        settings,
+        [&]() {
+          montage = MontageType::New();
+          montage->SetMontageSize(montageSize);
+          montage->SetTileSource(generator->GetTileSource());
+          montage->SetTieredRegistration(tiered);
+        },
+        [&]() { montage->Update(); });
+      results.Add("TileMontage::Update",
+                  Dimension,
+                  "ushort",
+                  tilesPerDimension,
+                  "Tile" + std::to_string(tileSize) + (outlierFraction > 0 ? "Outliers5%" : "NoOutliers") +
+                    (tiered ? "Tiered" : ""),
+                  probe,
+                  static_cast<double>(generator->GetLinearMontageSize()) * size.CalculateProductOfElements());
+    }
+  }
+}
+
+template <unsigned Dimension>
+void
+BenchmarkDimension(const std::vector<unsigned> & tileSizes,
+                   const std::vector<unsigned> & mergeSizes,
+                   const std::vector<unsigned> & graphSizes,
+                   const std::vector<unsigned> & mosaicSizes,
+                   const BenchmarkSettings &     settings,
+                   BenchmarkResults &            results)
+{
+  for (unsigned size : tileSizes)
+  {
+    BenchmarkRegistration<itk::Image<unsigned char, Dimension>>("uchar", size, settings, results);
+    BenchmarkRegistration<itk::Image<unsigned short, Dimension>>("ushort", size, settings, results);
+    BenchmarkRegistration<itk::Image<float, Dimension>>("float", size, settings, results);
+  }
+  for (unsigned size : mergeSizes)
+  {
+    BenchmarkMerge<itk::Image<unsigned char, Dimension>>("uchar", size, settings, results);
+    BenchmarkMerge<itk::Image<unsigned short, Dimension>>("ushort", size, settings, results);
+    BenchmarkMerge<itk::Image<float, Dimension>>("float", size, settings, results);
+  }
+  for (unsigned tilesPerDimension : graphSizes)
+  {
+    BenchmarkOptimizeTiles<Dimension>(tilesPerDimension, settings, results);
+  }
+  for (unsigned tilesPerDimension : mosaicSizes)
+  {
+    BenchmarkSyntheticMontage<Dimension>(tilesPerDimension, settings, results);
+  }
+}
+
+int
+main(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cout << "Usage: " << std::endl;
+    std::cout << argv[0] << " <outputJSON> [quick]" << std::endl;
+    std::cout << "quick: 1 = only the smallest sizes and a single repetition, for smoke testing" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool quick = false;
+  if (argc > 2)
+  {
+    quick = std::stoi(argv[2]);
+  }
+
+  BenchmarkSettings settings;
+  BenchmarkResults  results;
+  try
+  {
+    if (quick)
+    {
+      settings.minSeconds = 0.0;
+      settings.minRepetitions = 1;
+      BenchmarkDimension<2>({ 64 }, { 64 }, { 5 }, { 3 }, settings, results);
+      BenchmarkDimension<3>({ 16 }, { 16 }, { 3 }, { 2 }, settings, results);
+    }
+    else
+    {
+      BenchmarkDimension<2>(
+        { 64, 128, 256, 512 }, { 256, 1024 }, { 5, 10, 20, 40 }, { 10, 32, 100 }, settings, results);
+      BenchmarkDimension<3>({ 16, 32, 64, 128 }, { 32, 128 }, { 3, 5, 8 }, { 4, 8, 22 }, settings, results);
+    }
+  }
+  catch (itk::ExceptionObject & exc)
+  {
+    std::cerr << exc;
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream out(argv[1]);
+  results.Write(out);
+  if (!out)
+  {
+    std::cerr << "Could not write results to " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -34,11 +34,14 @@ ReadImage(const char * filename)
 }
 
 // taken from test/itkMontageTestHelper.hxx and simplified
+// returns false if only FFTW wisdom was trained, and tiles were not registered
 template <unsigned Dimension, typename PixelType, typename AccumulatePixelType>
-void
+bool
 refineMontage(const itk::TileConfiguration<Dimension> & stageTiles,
               itk::TileConfiguration<Dimension> &       actualTiles,
-              const std::string &                       inputPath)
+              const std::string &                       inputPath,
+              const std::string &                       wisdomFile,
+              bool                                      trainWisdom)
 {
   using TileConfig = itk::TileConfiguration<Dimension>;
   using TransformType = itk::TranslationTransform<double, Dimension>;
@@ -50,6 +53,7 @@ refineMontage(const itk::TileConfiguration<Dimension> & stageTiles,
   using MontageType = itk::TileMontage<ScalarImageType>;
   typename MontageType::Pointer montage = MontageType::New();
   montage->SetMontageSize(stageTiles.AxisSizes);
+  montage->SetFFTWWisdomFile(wisdomFile);
   for (size_t t = 0; t < stageTiles.LinearSize(); t++)
   {
     std::string                       filename = inputPath + stageTiles.Tiles[t].FileName;
@@ -67,6 +71,11 @@ refineMontage(const itk::TileConfiguration<Dimension> & stageTiles,
 
     montage->SetInputTile(t, image);
   }
+  if (trainWisdom)
+  {
+    std::cout << "Planned FFTs of " << montage->TrainFFTWWisdom() << " sizes into " << wisdomFile << std::endl;
+    return false;
+  }
   montage->Update(); // calculate registration transforms
 
   // update resulting tile configuration
@@ -83,11 +92,12 @@ refineMontage(const itk::TileConfiguration<Dimension> & stageTiles,
       actualTiles.Tiles[t].Position[d] = stageTiles.Tiles[t].Position[d] - regPos[d] / sp[d];
     }
   }
+  return true;
 }
 
 template <unsigned Dimension>
 int
-mainHelper(std::string inputPath, std::string inFile, std::string outFile)
+mainHelper(std::string inputPath, std::string inFile, std::string outFile, std::string wisdomFile, bool trainWisdom)
 {
   itk::TileConfiguration<Dimension> stageTiles;
   stageTiles.Parse(inFile);
@@ -108,16 +118,20 @@ mainHelper(std::string inputPath, std::string inFile, std::string outFile)
   }
 
   const itk::IOComponentEnum componentType = imageIO->GetComponentType();
+  bool                       registered = false;
   switch (componentType)
   {
     case itk::IOComponentEnum::UCHAR:
-      refineMontage<Dimension, unsigned char, unsigned int>(stageTiles, actualTiles, inputPath);
+      registered = refineMontage<Dimension, unsigned char, unsigned int>(
+        stageTiles, actualTiles, inputPath, wisdomFile, trainWisdom);
       break;
     case itk::IOComponentEnum::USHORT:
-      refineMontage<Dimension, unsigned short, double>(stageTiles, actualTiles, inputPath);
+      registered =
+        refineMontage<Dimension, unsigned short, double>(stageTiles, actualTiles, inputPath, wisdomFile, trainWisdom);
       break;
     case itk::IOComponentEnum::SHORT:
-      refineMontage<Dimension, short, double>(stageTiles, actualTiles, inputPath);
+      registered =
+        refineMontage<Dimension, short, double>(stageTiles, actualTiles, inputPath, wisdomFile, trainWisdom);
       break;
     default: // instantiating too many types leads to long compilation time and big executable
       itkGenericExceptionMacro(
@@ -125,7 +139,10 @@ mainHelper(std::string inputPath, std::string inFile, std::string outFile)
         << itk::ImageIOBase::GetComponentTypeAsString(componentType))
   }
 
-  actualTiles.Write(outFile);
+  if (registered)
+  {
+    actualTiles.Write(outFile);
+  }
 
   return EXIT_SUCCESS;
 }
@@ -136,7 +153,9 @@ main(int argc, char * argv[])
   if (argc < 2)
   {
     std::cout << "Usage: " << std::endl;
-    std::cout << argv[0] << " <inputTileConfiguration> [outputTileConfiguration]" << std::endl;
+    std::cout << argv[0] << " <inputTileConfiguration> [outputTileConfiguration] [fftwWisdomFile [train]]\n";
+    std::cout << "With train, FFT plans for this tile configuration are learned into the wisdom file,\n";
+    std::cout << "which later runs given the same wisdom file reuse. Tiles are not registered." << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -151,7 +170,9 @@ main(int argc, char * argv[])
   {
     outputFilename = argv[2];
   }
-  std::string outPath = itksys::SystemTools::GetFilenamePath(outputFilename);
+  const std::string wisdomFile = argc > 3 ? argv[3] : "";
+  const bool        trainWisdom = argc > 4 && std::string(argv[4]) == "train";
+  std::string       outPath = itksys::SystemTools::GetFilenamePath(outputFilename);
   if (!outPath.empty()) // a path was given in addition to file name
   {
     outPath += '/';
@@ -176,9 +197,9 @@ main(int argc, char * argv[])
     switch (dim)
     {
       case 2:
-        return mainHelper<2>(inputPath, argv[1], outputFilename);
+        return mainHelper<2>(inputPath, argv[1], outputFilename, wisdomFile, trainWisdom);
       case 3:
-        return mainHelper<3>(inputPath, argv[1], outputFilename);
+        return mainHelper<3>(inputPath, argv[1], outputFilename, wisdomFile, trainWisdom);
       default:
         std::cerr << "Only dimensions 2 and 3 are supported. You are attempting to montage dimension " << dim;
         return EXIT_FAILURE;
@@ -71,6 +71,14 @@ resampleMontage(const itk::TileConfiguration<Dimension> & actualTiles,
     resampleF->SetTileTransform(actualTiles.LinearIndexToNDIndex(t), identity);
   }
 
+  if (itksys::SystemTools::LowerCase(itksys::SystemTools::GetFilenameLastExtension(outFilename)) == ".nrrd" &&
+      Resampler::CanWriteCompressedNrrd()) // otherwise, ImageIO writes whatever it can
+  {
+    // slabs are compressed in parallel, and written while later slabs are being resampled
+    resampleF->WriteCompressedNrrd(outFilename);
+    return;
+  }
+
   // resampleF->Update(); //implicitly called by the writer
   using WriterType = itk::ImageFileWriter<OriginalImageType>;
   typename WriterType::Pointer w = WriterType::New();
@@ -0,0 +1,260 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// Registers a montage in shards, each by a separate process, followed by a single global optimization.
+// "register" mode is meant for a task of a job array, with shard files on a shared filesystem.
+// "solve" mode reads all the shards and writes the registered tile configuration.
+// "local" mode runs all the shards as processes on this machine, each with its share of the cores, then solves.
+
+#include "itkImageFileReader.h"
+#include "itkMultiThreaderBase.h"
+#include "itkTileConfiguration.h"
+#include "itkTileMontage.h"
+
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+std::string
+shardFilename(const std::string & shardPath, unsigned shard)
+{
+  return shardPath + "shard_" + std::to_string(shard) + ".txt";
+}
+
+template <unsigned Dimension, typename PixelType>
+int
+shardedMontage(const itk::TileConfiguration<Dimension> & stageTiles,
+               const std::string &                       inputPath,
+               const std::string &                       shardPath,
+               const std::string &                       mode,
+               unsigned                                  shard,
+               unsigned                                  numberOfShards,
+               unsigned                                  workUnits,
+               const std::string &                       outFile)
+{
+  using TileConfig = itk::TileConfiguration<Dimension>;
+  using ScalarImageType = itk::Image<PixelType, Dimension>;
+  using MontageType = itk::TileMontage<ScalarImageType>;
+  using RegionType = typename ScalarImageType::RegionType;
+
+  auto tileSource = [stageTiles, inputPath](itk::SizeValueType t, bool metadataOnly, const RegionType & region) {
+    using ReaderType = itk::ImageFileReader<ScalarImageType>;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(inputPath + stageTiles.Tiles[t].FileName);
+    reader->UpdateOutputInformation();
+    typename ScalarImageType::Pointer image = reader->GetOutput();
+    if (!metadataOnly)
+    {
+      RegionType requested = image->GetLargestPossibleRegion();
+      if (region.GetNumberOfPixels() > 0)
+      {
+        requested.Crop(region); // unchanged if there is no overlap
+      }
+      image->SetRequestedRegion(requested);
+      reader->Update();
+    }
+    image->DisconnectPipeline();
+
+    // tile configurations are in pixel (index) coordinates, so we convert them into physical ones
+    typename TileConfig::PointType origin = stageTiles.Tiles[t].Position;
+    for (unsigned d = 0; d < Dimension; d++)
+    {
+      origin[d] *= image->GetSpacing()[d];
+    }
+    image->SetOrigin(origin);
+    return image;
+  };
+
+  if (workUnits > 0) // also limits nested parallel work, e.g. FFTs
+  {
+    itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(workUnits);
+  }
+  typename MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(stageTiles.AxisSizes);
+  montage->SetTileSource(tileSource);
+  if (workUnits > 0)
+  {
+    montage->SetNumberOfWorkUnits(workUnits);
+  }
+
+  if (mode == "register")
+  {
+    montage->RegisterShard(shard, numberOfShards, shardFilename(shardPath, shard));
+    return EXIT_SUCCESS;
+  }
+
+  std::vector<std::string> shardFilenames;
+  for (unsigned s = 0; s < numberOfShards; s++)
+  {
+    shardFilenames.push_back(shardFilename(shardPath, s));
+  }
+  montage->ReadShards(shardFilenames);
+  montage->Update(); // only optimizes tile positions
+
+  TileConfig actualTiles = stageTiles;
+  for (size_t t = 0; t < actualTiles.LinearSize(); t++)
+  {
+    typename MontageType::TileIndexType  ind = actualTiles.LinearIndexToNDIndex(t);
+    const itk::Vector<double, Dimension> regPos = montage->GetOutputTransform(ind)->GetOffset();
+    const auto                           sp = tileSource(t, true, RegionType())->GetSpacing();
+    for (unsigned d = 0; d < Dimension; d++)
+    {
+      actualTiles.Tiles[t].Position[d] = stageTiles.Tiles[t].Position[d] - regPos[d] / sp[d];
+    }
+  }
+  actualTiles.Write(outFile);
+  return EXIT_SUCCESS;
+}
+
+template <unsigned Dimension>
+int
+mainHelper(const std::string & inputPath,
+           const std::string & shardPath,
+           const std::string & inFile,
+           const std::string & mode,
+           unsigned            shard,
+           unsigned            numberOfShards,
+           unsigned            workUnits,
+           const std::string & outFile)
+{
+  itk::TileConfiguration<Dimension> stageTiles;
+  stageTiles.Parse(inFile);
+
+  std::string               firstFilename = inputPath + stageTiles.Tiles[0].FileName;
+  itk::ImageIOBase::Pointer imageIO =
+    itk::ImageIOFactory::CreateImageIO(firstFilename.c_str(), itk::IOFileModeEnum::ReadMode);
+  imageIO->SetFileName(firstFilename);
+  imageIO->ReadImageInformation();
+
+  const itk::IOComponentEnum componentType = imageIO->GetComponentType();
+  switch (componentType)
+  {
+    case itk::IOComponentEnum::UCHAR:
+      return shardedMontage<Dimension, unsigned char>(
+        stageTiles, inputPath, shardPath, mode, shard, numberOfShards, workUnits, outFile);
+    case itk::IOComponentEnum::USHORT:
+      return shardedMontage<Dimension, unsigned short>(
+        stageTiles, inputPath, shardPath, mode, shard, numberOfShards, workUnits, outFile);
+    case itk::IOComponentEnum::SHORT:
+      return shardedMontage<Dimension, short>(
+        stageTiles, inputPath, shardPath, mode, shard, numberOfShards, workUnits, outFile);
+    default: // instantiating too many types leads to long compilation time and big executable
+      itkGenericExceptionMacro(
+        "Only unsigned char, unsigned short and short are supported as pixel component types! Trying to montage "
+        << itk::ImageIOBase::GetComponentTypeAsString(componentType))
+  }
+  return EXIT_FAILURE;
+}
+
+int
+main(int argc, char * argv[])
+{
+  const std::string mode = argc > 3 ? argv[3] : "";
+  if (argc < 5 || (mode == "register" && argc < 6) || (mode != "register" && mode != "solve" && mode != "local"))
+  {
+    std::cout << "Usage: " << std::endl;
+    std::cout << argv[0]
+              << " <inputTileConfiguration> <shardDirectory> register <shardIndex> <numberOfShards> [workUnits]\n";
+    std::cout << argv[0] << " <inputTileConfiguration> <shardDirectory> solve <numberOfShards> [outputTileConfig]\n";
+    std::cout << argv[0] << " <inputTileConfiguration> <shardDirectory> local <numberOfShards> [outputTileConfig]\n";
+    std::cout << "Shard directory must be shared by all the processes, e.g. on a shared filesystem." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string inputPath = itksys::SystemTools::GetFilenamePath(argv[1]);
+  if (!inputPath.empty()) // a path was given in addition to file name
+  {
+    inputPath += '/';
+  }
+
+  const std::string shardPath = std::string(argv[2]) + '/';
+
+  unsigned    shard = 0;
+  unsigned    numberOfShards = std::stoul(argv[4]);
+  unsigned    workUnits = 0; // default of the montage
+  std::string outputFilename = shardPath + "TileConfiguration.registered.txt";
+  if (mode == "register")
+  {
+    shard = std::stoul(argv[4]);
+    numberOfShards = std::stoul(argv[5]);
+    if (argc > 6)
+    {
+      workUnits = std::stoul(argv[6]);
+    }
+  }
+  else if (argc > 5)
+  {
+    outputFilename = argv[5];
+  }
+
+  if (mode == "local") // one process per shard, as a job array would do
+  {
+    // each process would otherwise use all the cores, and the machine would be oversubscribed
+    const unsigned           childWorkUnits = std::max(1u, std::thread::hardware_concurrency() / numberOfShards);
+    std::vector<std::thread> processes;
+    std::vector<int>         exitCodes(numberOfShards);
+    for (unsigned s = 0; s < numberOfShards; s++)
+    {
+      const std::string command = std::string("\"") + argv[0] + "\" \"" + argv[1] + "\" \"" + argv[2] +
+                                  "\" register " + std::to_string(s) + " " + std::to_string(numberOfShards) + " " +
+                                  std::to_string(childWorkUnits);
+      processes.emplace_back([command, s, &exitCodes]() { exitCodes[s] = std::system(command.c_str()); });
+    }
+    for (unsigned s = 0; s < numberOfShards; s++)
+    {
+      processes[s].join();
+      if (exitCodes[s] != 0)
+      {
+        std::cerr << "Registration of shard " << s << " failed" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  try
+  {
+    unsigned dim;
+    itk::TileConfiguration<2>::TryParse(argv[1], dim);
+
+    switch (dim)
+    {
+      case 2:
+        return mainHelper<2>(inputPath, shardPath, argv[1], mode, shard, numberOfShards, outputFilename);
+      case 3:
+        return mainHelper<3>(inputPath, shardPath, argv[1], mode, shard, numberOfShards, outputFilename);
+      default:
+        std::cerr << "Only dimensions 2 and 3 are supported. You are attempting to montage dimension " << dim;
+        return EXIT_FAILURE;
+    }
+  }
+  catch (itk::ExceptionObject & exc)
+  {
+    std::cerr << exc;
+  }
+  catch (std::runtime_error & exc)
+  {
+    std::cerr << exc.what();
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown error has occurred" << std::endl;
+  }
+  return EXIT_FAILURE;
+}
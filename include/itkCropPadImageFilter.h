@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkCropPadImageFilter_h
+#define itkCropPadImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkNumericTraits.h"
+
+namespace itk
+{
+/** \class CropPadImageFilter
+ *  \brief Crops a region of the input, casts it to the output pixel type and pads it, in a single pass.
+ *
+ * The output is equivalent to RegionOfInterestImageFilter followed by
+ * ConstantPadImageFilter or MirrorPadImageFilter, without the intermediate cropped image.
+ * Each row of the region is read once per output row which maps onto it,
+ * and the output is written exactly once.
+ *
+ * As with those two filters, the output's largest possible region starts at -PadLowerBound,
+ * index 0 corresponds to the first pixel of the region, and the origin is the region's physical location.
+ *
+ * Mirroring reflects the region about its edges, repeating the edge pixels,
+ * as many times as needed to fill the padding. With DecayBase below 1, a mirrored pixel
+ * d steps away from the region (city-block distance) is multiplied by DecayBase^d.
+ *
+ * The input can be an image adaptor, e.g. LuminanceImageAdaptor for multi-component pixels.
+ *
+ * \ingroup Montage
+ */
+template <typename TInputImage, typename TOutputImage>
+class ITK_TEMPLATE_EXPORT CropPadImageFilter : public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(CropPadImageFilter);
+
+  /** Standard class type aliases. */
+  using Self = CropPadImageFilter;
+  using Superclass = ImageToImageFilter<TInputImage, TOutputImage>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(CropPadImageFilter, ImageToImageFilter);
+
+  using InputImageType = TInputImage;
+  using OutputImageType = TOutputImage;
+  using InputImageRegionType = typename InputImageType::RegionType;
+  using OutputImageRegionType = typename OutputImageType::RegionType;
+  using OutputImagePixelType = typename OutputImageType::PixelType;
+  using SizeType = typename OutputImageType::SizeType;
+
+  static constexpr unsigned ImageDimension = TOutputImage::ImageDimension;
+
+  /** Set/Get the region of the input to be cropped. Empty means the whole input. Default: empty. */
+  itkSetMacro(RegionOfInterest, InputImageRegionType);
+  itkGetConstReferenceMacro(RegionOfInterest, InputImageRegionType);
+
+  /** Set/Get the padding before and after the region, in each dimension. */
+  itkSetMacro(PadLowerBound, SizeType);
+  itkGetConstReferenceMacro(PadLowerBound, SizeType);
+  itkSetMacro(PadUpperBound, SizeType);
+  itkGetConstReferenceMacro(PadUpperBound, SizeType);
+
+  /** Set/Get mirroring. If off, padding pixels have the constant value. Default: off. */
+  itkSetMacro(Mirror, bool);
+  itkGetConstMacro(Mirror, bool);
+  itkBooleanMacro(Mirror);
+
+  /** Set/Get the value of constant padding. Default: zero. */
+  itkSetMacro(Constant, OutputImagePixelType);
+  itkGetConstMacro(Constant, OutputImagePixelType);
+
+  /** Set/Get the base of exponential decay of mirrored pixels. Default: 1.0, no decay. */
+  itkSetClampMacro(DecayBase, double, NumericTraits<double>::min(), 1.0);
+  itkGetConstMacro(DecayBase, double);
+
+protected:
+  CropPadImageFilter();
+  ~CropPadImageFilter() override = default;
+
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  void
+  GenerateOutputInformation() override;
+
+  void
+  GenerateInputRequestedRegion() override;
+
+  void
+  DynamicThreadedGenerateData(const OutputImageRegionType & outputRegionForThread) override;
+
+  /** The region of interest, or the input's largest possible region if that is empty. */
+  InputImageRegionType
+  GetCropRegion() const;
+
+  /** Index into [0, size) of the region which index i maps onto, by reflection about the edges. */
+  static IndexValueType
+  MirrorIndex(IndexValueType i, IndexValueType size)
+  {
+    const IndexValueType period = 2 * size;
+    IndexValueType       m = i % period;
+    if (m < 0)
+    {
+      m += period;
+    }
+    return m < size ? m : period - 1 - m;
+  }
+
+  /** Distance of index i from [0, size). */
+  static IndexValueType
+  OutsideDistance(IndexValueType i, IndexValueType size)
+  {
+    return i < 0 ? -i : (i >= size ? i - size + 1 : 0);
+  }
+
+private:
+  InputImageRegionType m_RegionOfInterest;
+  SizeType             m_PadLowerBound;
+  SizeType             m_PadUpperBound;
+  bool                 m_Mirror = false;
+  OutputImagePixelType m_Constant = NumericTraits<OutputImagePixelType>::ZeroValue();
+  double               m_DecayBase = 1.0;
+};
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkCropPadImageFilter.hxx"
+#endif
+
+#endif // itkCropPadImageFilter_h
@@ -0,0 +1,213 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkCropPadImageFilter_hxx
+#define itkCropPadImageFilter_hxx
+
+#include "itkCropPadImageFilter.h"
+
+#include "itkImageRegionConstIterator.h"
+#include "itkImageScanlineIterator.h"
+#include "itkTotalProgressReporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace itk
+{
+
+template <typename TInputImage, typename TOutputImage>
+CropPadImageFilter<TInputImage, TOutputImage>::CropPadImageFilter()
+{
+  m_PadLowerBound.Fill(0);
+  m_PadUpperBound.Fill(0);
+  this->DynamicMultiThreadingOn();
+}
+
+
+template <typename TInputImage, typename TOutputImage>
+void
+CropPadImageFilter<TInputImage, TOutputImage>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Region Of Interest: " << m_RegionOfInterest << std::endl;
+  os << indent << "Pad Lower Bound: " << m_PadLowerBound << std::endl;
+  os << indent << "Pad Upper Bound: " << m_PadUpperBound << std::endl;
+  os << indent << "Mirror: " << (m_Mirror ? "On" : "Off") << std::endl;
+  os << indent << "Constant: " << static_cast<typename NumericTraits<OutputImagePixelType>::PrintType>(m_Constant)
+     << std::endl;
+  os << indent << "Decay Base: " << m_DecayBase << std::endl;
+}
+
+
+template <typename TInputImage, typename TOutputImage>
+typename CropPadImageFilter<TInputImage, TOutputImage>::InputImageRegionType
+CropPadImageFilter<TInputImage, TOutputImage>::GetCropRegion() const
+{
+  const InputImageRegionType largest = this->GetInput()->GetLargestPossibleRegion();
+  if (m_RegionOfInterest.GetNumberOfPixels() == 0)
+  {
+    return largest;
+  }
+  return m_RegionOfInterest;
+}
+
+
+template <typename TInputImage, typename TOutputImage>
+void
+CropPadImageFilter<TInputImage, TOutputImage>::GenerateOutputInformation()
+{
+  // the output is neither the same size as the input, nor is the index same
+  const InputImageType * input = this->GetInput();
+  OutputImageType *      output = this->GetOutput();
+  if (input == nullptr || output == nullptr)
+  {
+    return;
+  }
+
+  const InputImageRegionType crop = this->GetCropRegion();
+  if (!input->GetLargestPossibleRegion().IsInside(crop) || crop.GetNumberOfPixels() == 0)
+  {
+    itkExceptionMacro("Region of interest " << crop << " is empty or not inside the input's largest region "
+                                            << input->GetLargestPossibleRegion());
+  }
+
+  typename OutputImageType::PointType origin;
+  input->TransformIndexToPhysicalPoint(crop.GetIndex(), origin);
+  OutputImageRegionType outputRegion;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    outputRegion.SetIndex(d, -static_cast<IndexValueType>(m_PadLowerBound[d]));
+    outputRegion.SetSize(d, m_PadLowerBound[d] + crop.GetSize(d) + m_PadUpperBound[d]);
+  }
+  output->SetLargestPossibleRegion(outputRegion);
+  output->SetOrigin(origin);
+  output->SetSpacing(input->GetSpacing());
+  output->SetDirection(input->GetDirection());
+  output->SetNumberOfComponentsPerPixel(1);
+}
+
+
+template <typename TInputImage, typename TOutputImage>
+void
+CropPadImageFilter<TInputImage, TOutputImage>::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+  // mirroring can map any output pixel onto any pixel of the region, so all of it is needed
+  auto * input = const_cast<InputImageType *>(this->GetInput());
+  if (input != nullptr)
+  {
+    input->SetRequestedRegion(this->GetCropRegion());
+  }
+}
+
+
+template <typename TInputImage, typename TOutputImage>
+void
+CropPadImageFilter<TInputImage, TOutputImage>::DynamicThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread)
+{
+  const InputImageType *     input = this->GetInput();
+  OutputImageType *          output = this->GetOutput();
+  const InputImageRegionType crop = this->GetCropRegion();
+  TotalProgressReporter      progress(this, output->GetRequestedRegion().GetNumberOfPixels());
+
+  // powers of the decay base, up to the farthest padding pixel
+  IndexValueType maxDistance = 0;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    maxDistance += std::max(m_PadLowerBound[d], m_PadUpperBound[d]);
+  }
+  std::vector<double> decay(maxDistance + 1, 1.0);
+  for (IndexValueType k = 1; k <= maxDistance; k++)
+  {
+    decay[k] = decay[k - 1] * m_DecayBase;
+  }
+
+  const IndexValueType              rowSize = crop.GetSize(0);
+  std::vector<OutputImagePixelType> row(rowSize); // converted pixels of the current input row
+  InputImageRegionType              rowRegion = crop;
+  rowRegion.SetSize(0, rowSize);
+  for (unsigned d = 1; d < ImageDimension; d++)
+  {
+    rowRegion.SetSize(d, 1);
+  }
+  bool rowRead = false;
+
+  // output index 0 is the first pixel of the region, so output indices are relative to it
+  ImageScanlineIterator<OutputImageType> outIt(output, outputRegionForThread);
+  while (!outIt.IsAtEnd())
+  {
+    const typename OutputImageType::IndexType lineStart = outIt.GetIndex();
+    typename InputImageType::IndexType        rowIndex = crop.GetIndex();
+    IndexValueType                            lineDistance = 0;
+    bool                                      padding = false; // the whole line is constant padding
+    for (unsigned d = 1; d < ImageDimension; d++)
+    {
+      const IndexValueType size = crop.GetSize(d);
+      const IndexValueType distance = OutsideDistance(lineStart[d], size);
+      padding = padding || (distance > 0 && !m_Mirror);
+      lineDistance += distance;
+      rowIndex[d] += MirrorIndex(lineStart[d], size);
+    }
+
+    if (padding)
+    {
+      while (!outIt.IsAtEndOfLine())
+      {
+        outIt.Set(m_Constant);
+        ++outIt;
+      }
+    }
+    else
+    {
+      if (!rowRead || rowRegion.GetIndex() != rowIndex) // consecutive lines often map onto the same row
+      {
+        rowRegion.SetIndex(rowIndex);
+        ImageRegionConstIterator<InputImageType> inIt(input, rowRegion);
+        for (IndexValueType x = 0; x < rowSize; ++x, ++inIt)
+        {
+          row[x] = static_cast<OutputImagePixelType>(inIt.Get());
+        }
+        rowRead = true;
+      }
+      for (IndexValueType x = lineStart[0]; !outIt.IsAtEndOfLine(); ++x, ++outIt)
+      {
+        const IndexValueType distance = OutsideDistance(x, rowSize);
+        if (distance > 0 && !m_Mirror)
+        {
+          outIt.Set(m_Constant);
+        }
+        else if (lineDistance + distance == 0)
+        {
+          outIt.Set(row[x]);
+        }
+        else
+        {
+          outIt.Set(static_cast<OutputImagePixelType>(row[MirrorIndex(x, rowSize)] * decay[lineDistance + distance]));
+        }
+      }
+    }
+    progress.Completed(outputRegionForThread.GetSize(0));
+    outIt.NextLine();
+  }
+}
+
+} // end namespace itk
+
+#endif // itkCropPadImageFilter_hxx
@@ -0,0 +1,159 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkLuminanceImageAdaptor_h
+#define itkLuminanceImageAdaptor_h
+
+#include "itkDefaultConvertPixelTraits.h"
+#include "itkImageAdaptor.h"
+#include "itkNumericTraits.h"
+
+namespace itk
+{
+namespace Accessor
+{
+/** \class LuminancePixelAccessor
+ * \brief Presents a pixel of any type as a single scalar value.
+ *
+ * If Channel is negative (the default), luminance is computed from
+ * the first three components (R, G and B), using the same weights as
+ * RGBPixel::GetLuminance(). Pixels with fewer than three components
+ * are averaged. If Channel is non-negative, that component is returned.
+ * Scalar pixels are passed through, regardless of Channel.
+ *
+ * \ingroup Montage
+ */
+template <typename TInternalType, typename TExternalType>
+class ITK_TEMPLATE_EXPORT LuminancePixelAccessor
+{
+public:
+  /** External type alias. It defines the type that is returned by Get(). */
+  using ExternalType = TExternalType;
+
+  /** Internal type alias. It defines the type of the pixel stored in the image. */
+  using InternalType = TInternalType;
+
+  using PixelTraits = DefaultConvertPixelTraits<InternalType>;
+
+  inline void
+  Set(InternalType & output, const ExternalType & input) const
+  {
+    const unsigned length = NumericTraits<InternalType>::GetLength(output);
+    for (unsigned c = 0; c < length; c++)
+    {
+      PixelTraits::SetNthComponent(c, output, static_cast<typename PixelTraits::ComponentType>(input));
+    }
+  }
+
+  inline ExternalType
+  Get(const InternalType & input) const
+  {
+    const unsigned length = NumericTraits<InternalType>::GetLength(input);
+    if (length == 1)
+    {
+      return static_cast<ExternalType>(PixelTraits::GetNthComponent(0, input));
+    }
+    if (m_Channel >= 0)
+    {
+      return static_cast<ExternalType>(PixelTraits::GetNthComponent(m_Channel, input));
+    }
+    if (length >= 3)
+    {
+      return static_cast<ExternalType>(0.30 * PixelTraits::GetNthComponent(0, input) +
+                                       0.59 * PixelTraits::GetNthComponent(1, input) +
+                                       0.11 * PixelTraits::GetNthComponent(2, input));
+    }
+    double sum = 0.0;
+    for (unsigned c = 0; c < length; c++)
+    {
+      sum += PixelTraits::GetNthComponent(c, input);
+    }
+    return static_cast<ExternalType>(sum / length);
+  }
+
+  /** Set/Get the component to present. Negative means luminance. */
+  void
+  SetChannel(int channel)
+  {
+    m_Channel = channel;
+  }
+  int
+  GetChannel() const
+  {
+    return m_Channel;
+  }
+
+private:
+  int m_Channel = -1;
+};
+} // end namespace Accessor
+
+/** \class LuminanceImageAdaptor
+ * \brief Presents a multi-component (e.g. RGB) image as a scalar image.
+ *
+ * Luminance or a single channel is computed on the fly when a pixel
+ * is accessed, so no scalar copy of the image is ever allocated.
+ * This allows registration of color tiles without first converting
+ * them into grayscale images.
+ *
+ * \sa LuminancePixelAccessor
+ *
+ * \ingroup Montage
+ */
+template <typename TImage, typename TOutputPixelType>
+class ITK_TEMPLATE_EXPORT LuminanceImageAdaptor
+  : public ImageAdaptor<TImage, Accessor::LuminancePixelAccessor<typename TImage::PixelType, TOutputPixelType>>
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(LuminanceImageAdaptor);
+
+  /** Standard class type aliases. */
+  using Self = LuminanceImageAdaptor;
+  using Superclass =
+    ImageAdaptor<TImage, Accessor::LuminancePixelAccessor<typename TImage::PixelType, TOutputPixelType>>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(LuminanceImageAdaptor, ImageAdaptor);
+
+  /** Set/Get the component to present. Negative (the default) means luminance. */
+  void
+  SetChannel(int channel)
+  {
+    if (this->GetPixelAccessor().GetChannel() != channel)
+    {
+      this->GetPixelAccessor().SetChannel(channel);
+      this->Modified();
+    }
+  }
+  int
+  GetChannel() const
+  {
+    return this->GetPixelAccessor().GetChannel();
+  }
+
+protected:
+  LuminanceImageAdaptor() = default;
+  ~LuminanceImageAdaptor() override = default;
+};
+} // end namespace itk
+
+#endif
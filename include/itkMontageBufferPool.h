@@ -0,0 +1,144 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMontageBufferPool_h
+#define itkMontageBufferPool_h
+
+#include "itkIntTypes.h"
+#include "MontageExport.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+
+/** \class MontageBufferPool
+ * \brief Size-class pool of large pixel buffers, shared by all threads.
+ *
+ * Registration of each pair allocates images of the same few sizes:
+ * padded tiles, spectra, the cross-power spectrum and the correlation surface.
+ * Instead of returning them to the system and faulting fresh pages in for the next pair,
+ * released buffers are kept on per-size-class free lists and handed out again.
+ * Free lists are kept per NUMA node: a buffer acquired by a thread bound to a node
+ * (see MontageNUMA::ScopedNodeAffinity) is only handed out again to threads bound to the same node.
+ * Size classes are spaced at quarters of a power of two, so at most 25% of a buffer is unused.
+ * Buffers smaller than the minimum size are not pooled.
+ *
+ * Pooling applies to images allocated by a thread while it is within a Scope,
+ * and whose pixel container type is registered by a PooledImportImageContainer::Registration
+ * (see itkPooledImportImageContainer.h).
+ * On Linux, buffers of at least 2 MiB are mapped anonymously and advised to use transparent huge pages.
+ *
+ * The pool lives for the whole process. Trim() returns the free buffers to the system.
+ * Buffers released after Trim(), and before the next Acquire(), are returned to the system directly,
+ * so buffers which were still in use when pooling ended are not kept either.
+ *
+ * \ingroup Montage
+ */
+class Montage_EXPORT MontageBufferPool
+{
+public:
+  MontageBufferPool(const MontageBufferPool &) = delete;
+  MontageBufferPool &
+  operator=(const MontageBufferPool &) = delete;
+
+  /** The process-wide pool. */
+  static MontageBufferPool &
+  GetInstance();
+
+  /** Pool to be used by the calling thread, null outside of a Scope. */
+  static MontageBufferPool *
+  GetThreadPool();
+
+  /** \class Scope
+   * \brief Makes allocations of the calling thread pooled, until destruction.
+   * Scopes can be nested, a disabled one suspends pooling.
+   * \ingroup Montage */
+  class Montage_EXPORT Scope
+  {
+  public:
+    explicit Scope(bool enabled = true);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &
+    operator=(const Scope &) = delete;
+
+  private:
+    MontageBufferPool * m_Previous;
+  };
+
+  /** Returns a buffer of at least the given number of bytes, aligned for any pixel type. */
+  void *
+  Acquire(SizeValueType bytes);
+
+  /** Returns the buffer to the free list of its node, or to the system after Trim().
+   * The buffer must have been acquired from this pool. */
+  void
+  Release(void * buffer);
+
+  /** Returns all the free buffers to the system. Buffers in use are returned when released,
+   * until the pool is used again. */
+  void
+  Trim();
+
+  /** Smallest pooled buffer, in bytes. Default: 1 MiB. */
+  void
+  SetMinimumBytes(SizeValueType bytes);
+  SizeValueType
+  GetMinimumBytes() const;
+
+  /** Number of buffers obtained from the system, and number of reused ones. */
+  SizeValueType
+  GetNumberOfAllocations() const;
+  SizeValueType
+  GetNumberOfReuses() const;
+
+  /** Bytes held on the free lists. */
+  SizeValueType
+  GetFreeBytes() const;
+
+  /** Smallest size class which holds the given number of bytes. */
+  static SizeValueType
+  GetSizeClass(SizeValueType bytes);
+
+private:
+  MontageBufferPool() = default;
+
+  static void *
+  AllocateSystemBuffer(SizeValueType bytes);
+  static void
+  FreeSystemBuffer(void * buffer, SizeValueType bytes);
+
+  using FreeListKey = std::pair<int, SizeValueType>; // node (-1 if not bound) and size class
+
+  mutable std::mutex                         m_Mutex;
+  std::map<FreeListKey, std::vector<void *>> m_FreeBuffers;
+  std::unordered_map<void *, FreeListKey>    m_BuffersInUse; // where each acquired buffer returns to
+  SizeValueType                              m_MinimumBytes = 1024 * 1024;
+  SizeValueType                              m_NumberOfAllocations = 0;
+  SizeValueType                              m_NumberOfReuses = 0;
+  SizeValueType                              m_FreeBytes = 0;
+  bool                                       m_Trimmed = false; // no Acquire() since the last Trim()
+};
+
+} // namespace itk
+
+#endif // itkMontageBufferPool_h
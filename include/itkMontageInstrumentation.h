@@ -0,0 +1,334 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMontageInstrumentation_h
+#define itkMontageInstrumentation_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSize.h"
+#include "MontageExport.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace itk
+{
+
+/** \class MontageInstrumentationEnums
+ * \ingroup Montage
+ */
+class MontageInstrumentationEnums
+{
+public:
+  /** \class Stage
+   *  \brief Timed stages of registration and merging.
+   *  \ingroup Montage */
+  enum class Stage : uint8_t
+  {
+    TileRead = 0,
+    TilePreprocessing,
+    Padding, // includes cropping to the overlap, which is fused with padding
+    ForwardFFT,
+    Operator,
+    BandPass,
+    InverseFFT,
+    PeakSearch,
+    SubPixelInterpolation,
+    GlobalSolve, // one count per iteration of outlier elimination
+    Merge,       // one count per merged region
+    Count        // not a stage, the number of stages
+  };
+
+  /** \class Counter
+   *  \brief Counted events.
+   *  \ingroup Montage */
+  enum class Counter : uint8_t
+  {
+    TilesRead = 0,
+    BytesRead, // pixel data, as held in memory
+    TileCacheHits,
+    FFTCacheHits,
+    FFTCacheMisses,
+    PairsRegistered,
+    OutliersRemoved,
+    LowInformationPairs, // not registered, see TileMontage::SetInformationThreshold()
+    PairsEscalated,      // registered again, see TileMontage::SetTieredRegistration()
+    Count                // not a counter, the number of counters
+  };
+
+  /** \class MemoryCategory
+   *  \brief Accounted consumers of memory.
+   *  \ingroup Montage */
+  enum class MemoryCategory : uint8_t
+  {
+    Tiles = 0,           // read from files or preprocessed, held by the montage
+    FFTCache,            // forward FFTs of tiles, kept for reuse when not cropping to overlap
+    RegistrationBuffers, // per-pair cropped, padded and transformed images
+    CorrelationSurface,  // per-pair phase correlation image
+    MergeOutput,         // output buffer of TileMergeImageFilter
+    Count                // not a category, the number of categories
+  };
+};
+
+/** Define how to print enumerations */
+extern Montage_EXPORT std::ostream &
+                      operator<<(std::ostream & out, const MontageInstrumentationEnums::Stage value);
+extern Montage_EXPORT std::ostream &
+                      operator<<(std::ostream & out, const MontageInstrumentationEnums::Counter value);
+extern Montage_EXPORT std::ostream &
+                      operator<<(std::ostream & out, const MontageInstrumentationEnums::MemoryCategory value);
+
+
+/** \class MontageInstrumentation
+ * \brief Collects timings and counters of TileMontage and TileMergeImageFilter.
+ *
+ * Set an instance via SetInstrumentation() of TileMontage, TileMergeImageFilter,
+ * PhaseCorrelationImageRegistrationMethod or PhaseCorrelationOptimizer.
+ * After Update(), cumulative statistics of each stage, event counters,
+ * FFT sizes, per-pair stage timings, and memory held by each category
+ * (in use and high-water marks) can be queried or written as JSON.
+ * The same instance can be shared between several filters, and across updates.
+ * Collection is thread safe. When no instrumentation is set (the default),
+ * the clock is not read at all, and the overhead is a null pointer check.
+ *
+ * When instrumented, the registration method updates its internal pipeline
+ * one stage at a time, so each stage can be timed separately.
+ *
+ * \ingroup Montage
+ */
+class Montage_EXPORT MontageInstrumentation : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(MontageInstrumentation);
+
+  /** Standard class type aliases. */
+  using Self = MontageInstrumentation;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MontageInstrumentation, Object);
+
+  using StageEnum = MontageInstrumentationEnums::Stage;
+  using CounterEnum = MontageInstrumentationEnums::Counter;
+  using MemoryCategoryEnum = MontageInstrumentationEnums::MemoryCategory;
+  static constexpr unsigned NumberOfStages = static_cast<unsigned>(StageEnum::Count);
+  static constexpr unsigned NumberOfCounters = static_cast<unsigned>(CounterEnum::Count);
+  static constexpr unsigned NumberOfMemoryCategories = static_cast<unsigned>(MemoryCategoryEnum::Count);
+
+  /** Bytes, per memory category. */
+  using MemoryBytes = std::array<SizeValueType, NumberOfMemoryCategories>;
+
+  /** Seconds spent in each stage. */
+  using StageTimes = std::array<double, NumberOfStages>;
+
+  /** Cumulative statistics of a stage. */
+  struct StageStatistics
+  {
+    SizeValueType count = 0;
+    double        totalSeconds = 0.0;
+    double        maxSeconds = 0.0;
+  };
+
+  /** Stage timings of one registration pair, in linear tile indices. */
+  struct PairRecord
+  {
+    SizeValueType fixed;
+    SizeValueType moving;
+    StageTimes    seconds;
+  };
+
+  /** Adds a single execution of a stage. */
+  void
+  AddStageTime(StageEnum stage, double seconds);
+
+  /** Adds a record of a registered pair. */
+  void
+  AddPairRecord(SizeValueType fixed, SizeValueType moving, const StageTimes & seconds);
+
+  /** Increments a counter. */
+  void
+  Increment(CounterEnum counter, SizeValueType amount = 1)
+  {
+    m_Counters[static_cast<unsigned>(counter)] += amount;
+  }
+
+  /** Counts a computed FFT of the given size. */
+  template <unsigned VDimension>
+  void
+  AddFFTSize(const Size<VDimension> & size)
+  {
+    std::vector<SizeValueType> sizeVector(VDimension);
+    for (unsigned d = 0; d < VDimension; d++)
+    {
+      sizeVector[d] = size[d];
+    }
+    this->AddFFTSize(sizeVector);
+  }
+  void
+  AddFFTSize(const std::vector<SizeValueType> & size);
+
+  /** Accounts allocated bytes. */
+  void
+  AddMemory(MemoryCategoryEnum category, SizeValueType bytes);
+
+  /** Accounts released bytes. */
+  void
+  RemoveMemory(MemoryCategoryEnum category, SizeValueType bytes);
+
+  /** Replaces bytes in use by a category, e.g. for a reallocated output buffer. */
+  void
+  SetMemoryInUse(MemoryCategoryEnum category, SizeValueType bytes);
+
+  /** Bytes allocated for image's pixel buffer, zero for null. */
+  template <typename TImage>
+  static SizeValueType
+  GetBufferBytes(const TImage * image)
+  {
+    if (image == nullptr || image->GetPixelContainer() == nullptr)
+    {
+      return 0;
+    }
+    return image->GetPixelContainer()->Capacity() * sizeof(typename TImage::InternalPixelType);
+  }
+
+  MemoryBytes
+  GetMemoryInUse() const;
+
+  /** Highest number of bytes held by each category. */
+  MemoryBytes
+  GetMemoryHighWaterMarks() const;
+
+  /** Highest number of bytes held by all categories at the same time. */
+  SizeValueType
+  GetTotalMemoryHighWaterMark() const;
+
+  /** Sum of bytes over all categories. */
+  static SizeValueType
+  GetTotal(const MemoryBytes & bytes);
+
+  StageStatistics
+  GetStageStatistics(StageEnum stage) const;
+
+  SizeValueType
+  GetCounter(CounterEnum counter) const
+  {
+    return m_Counters[static_cast<unsigned>(counter)];
+  }
+
+  /** Number of computed FFTs, by size. */
+  std::map<std::vector<SizeValueType>, SizeValueType>
+  GetFFTSizes() const;
+
+  std::vector<PairRecord>
+  GetPairRecords() const;
+
+  /** Clears all the collected data. Memory in use is kept,
+   * as it is still held, and becomes the new high-water mark. */
+  void
+  Reset();
+
+  /** Writes all the collected data as a JSON object. */
+  void
+  WriteJSON(std::ostream & out) const;
+  void
+  WriteJSON(const std::string & fileName) const;
+
+  /** \class ScopedStageTimer
+   * \brief Times a stage from construction until Stop() or destruction.
+   *
+   * Time is added to instrumentation's totals, and to perRun, if they are not null.
+   * If both are null, nothing is done.
+   * \ingroup Montage */
+  class ScopedStageTimer
+  {
+  public:
+    ScopedStageTimer(MontageInstrumentation * instrumentation, StageEnum stage, StageTimes * perRun = nullptr)
+      : m_Instrumentation(instrumentation)
+      , m_Stage(stage)
+      , m_PerRun(perRun)
+    {
+      if (m_Instrumentation != nullptr || m_PerRun != nullptr)
+      {
+        m_Start = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~ScopedStageTimer() { this->Stop(); }
+
+    void
+    Stop()
+    {
+      if (m_Instrumentation == nullptr && m_PerRun == nullptr)
+      {
+        return;
+      }
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_Start;
+      if (m_Instrumentation != nullptr)
+      {
+        m_Instrumentation->AddStageTime(m_Stage, elapsed.count());
+      }
+      if (m_PerRun != nullptr)
+      {
+        (*m_PerRun)[static_cast<unsigned>(m_Stage)] += elapsed.count();
+      }
+      m_Instrumentation = nullptr;
+      m_PerRun = nullptr;
+    }
+
+  private:
+    MontageInstrumentation *              m_Instrumentation;
+    StageEnum                             m_Stage;
+    StageTimes *                          m_PerRun;
+    std::chrono::steady_clock::time_point m_Start;
+  };
+
+protected:
+  MontageInstrumentation();
+  ~MontageInstrumentation() override = default;
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+private:
+  mutable std::mutex m_Mutex; // protects everything except the counters
+
+  /** Updates high-water marks, the caller must hold the mutex. */
+  void
+  UpdateHighWaterMarks(MemoryCategoryEnum category);
+
+  std::array<StageStatistics, NumberOfStages>              m_Stages;
+  std::array<std::atomic<SizeValueType>, NumberOfCounters> m_Counters;
+  std::map<std::vector<SizeValueType>, SizeValueType>      m_FFTSizes;
+  std::vector<PairRecord>                                  m_PairRecords;
+  MemoryBytes                                              m_MemoryInUse{};
+  MemoryBytes                                              m_MemoryHighWaterMarks{};
+  SizeValueType                                            m_TotalMemoryHighWaterMark = 0;
+};
+
+} // namespace itk
+
+#endif // itkMontageInstrumentation_h
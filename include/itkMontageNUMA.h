@@ -0,0 +1,93 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMontageNUMA_h
+#define itkMontageNUMA_h
+
+#include "itkIntTypes.h"
+#include "MontageExport.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class MontageNUMA
+ * \brief NUMA topology of this machine, and binding of threads to its nodes.
+ *
+ * Memory is placed on the node of the thread which first touches it,
+ * so a thread bound to a node while it reads a tile or computes a spectrum
+ * gets node-local buffers. Binding is temporary (see ScopedNodeAffinity),
+ * because ThreadPool and MultiThreaderBase threads are shared by all filters.
+ *
+ * The topology is read from /sys/devices/system/node on Linux.
+ * Elsewhere, or if it cannot be read, there is a single node and binding does nothing.
+ *
+ * \ingroup Montage
+ */
+class Montage_EXPORT MontageNUMA
+{
+public:
+  /** Number of NUMA nodes with CPUs, at least 1. */
+  static unsigned
+  GetNumberOfNodes();
+
+  /** CPUs of the node, empty for a single node or an invalid node. */
+  static std::vector<unsigned>
+  GetNodeCPUs(unsigned node);
+
+  /** Node of contiguous partitioning of count items into the nodes, e.g. of tiles by linear index. */
+  static unsigned
+  GetItemNode(SizeValueType item, SizeValueType count)
+  {
+    return count == 0 ? 0 : static_cast<unsigned>(item * GetNumberOfNodes() / count);
+  }
+
+  /** Node to which the calling thread is bound by a ScopedNodeAffinity, -1 if it is not bound. */
+  static int
+  GetBoundNode();
+
+  /** \class ScopedNodeAffinity
+   * \brief Binds the calling thread to the CPUs of a node until destruction,
+   * then restores the previous affinity. A negative node does nothing.
+   * \ingroup Montage */
+  class Montage_EXPORT ScopedNodeAffinity
+  {
+  public:
+    explicit ScopedNodeAffinity(int node);
+    ~ScopedNodeAffinity();
+    ScopedNodeAffinity(const ScopedNodeAffinity &) = delete;
+    ScopedNodeAffinity &
+    operator=(const ScopedNodeAffinity &) = delete;
+
+    /** Whether the thread was actually bound. */
+    bool
+    IsBound() const
+    {
+      return m_Bound;
+    }
+
+  private:
+    bool                       m_Bound = false;
+    int                        m_PreviousNode = -1;
+    std::vector<unsigned char> m_PreviousAffinity; // platform's CPU set, opaque
+  };
+};
+
+} // namespace itk
+
+#endif // itkMontageNUMA_h
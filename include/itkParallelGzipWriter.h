@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkParallelGzipWriter_h
+#define itkParallelGzipWriter_h
+
+#include "itkIntTypes.h"
+#include "itkLightObject.h"
+#include "MontageExport.h"
+
+#include <fstream>
+#include <future>
+#include <string>
+
+namespace itk
+{
+
+/** \class ParallelGzipWriter
+ * \brief Writes a header followed by gzip-compressed data, compressing in the background.
+ *
+ * Each block passed to Write() is split into chunks of ChunkBytes,
+ * which are compressed in parallel as independent gzip members.
+ * Concatenated members form a valid gzip stream, which NRRD readers
+ * (and gunzip) decompress as a whole.
+ *
+ * Compression and writing of a block happen on a background thread,
+ * so the caller can produce the next block meanwhile. Write() first waits
+ * for the previous block, so at most two blocks are alive at any time:
+ * the one being written and the one being produced.
+ *
+ * Errors of the background thread are rethrown by the next Write() or by Close().
+ *
+ * \ingroup Montage
+ */
+class Montage_EXPORT ParallelGzipWriter
+{
+public:
+  /** Creates fileName, and writes the uncompressed header into it. */
+  ParallelGzipWriter(const std::string & fileName, const std::string & header);
+
+  /** Waits for the pending block. Call Close() to get errors reported. */
+  ~ParallelGzipWriter();
+
+  ParallelGzipWriter(const ParallelGzipWriter &) = delete;
+  ParallelGzipWriter &
+  operator=(const ParallelGzipWriter &) = delete;
+
+  /** Queues bytes at data for compression and writing, after waiting for the previous block.
+   * The owner is kept alive until the block is written, so data must stay valid while it lives. */
+  void
+  Write(const void * data, SizeValueType bytes, const LightObject * owner);
+
+  /** Waits for the pending block, and closes the file. */
+  void
+  Close();
+
+  /** Uncompressed bytes per gzip member. Default: 4 MiB. */
+  void
+  SetChunkBytes(SizeValueType bytes);
+  SizeValueType
+  GetChunkBytes() const
+  {
+    return m_ChunkBytes;
+  }
+
+  /** zlib compression level, from 0 (none) to 9 (best). Default: 6. */
+  void
+  SetCompressionLevel(int level);
+  int
+  GetCompressionLevel() const
+  {
+    return m_CompressionLevel;
+  }
+
+  /** Compresses bytes at data into a single gzip member. */
+  static std::string
+  CompressMember(const void * data, SizeValueType bytes, int level);
+
+private:
+  /** Compresses the block in parallel chunks, and appends them to the file. */
+  void
+  CompressAndWrite(const char * data, SizeValueType bytes);
+
+  std::ofstream     m_File;
+  std::string       m_FileName;
+  std::future<void> m_Pending; // compression and writing of the previous block
+  SizeValueType     m_ChunkBytes = 4 * 1024 * 1024;
+  int               m_CompressionLevel = 6;
+};
+
+} // namespace itk
+
+#endif // itkParallelGzipWriter_h
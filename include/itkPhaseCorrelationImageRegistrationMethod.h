@@ -18,20 +18,23 @@
 #ifndef itkPhaseCorrelationImageRegistrationMethod_h
 #define itkPhaseCorrelationImageRegistrationMethod_h
 
-#include "itkConstantPadImageFilter.h"
+#include "itkConfigure.h" // for ITK_USE_FFTWF and ITK_USE_FFTWD
+#include "itkCropPadImageFilter.h"
 #include "itkDataObjectDecorator.h"
 #include "itkFrequencyHalfHermitianFFTLayoutImageRegionIteratorWithIndex.h"
 #include "itkHalfHermitianToRealInverseFFTImageFilter.h"
 #include "itkImage.h"
-#include "itkMirrorPadImageFilter.h"
+#include "itkLuminanceImageAdaptor.h"
+#include "itkPixelTraits.h"
 #include "itkProcessObject.h"
 #include "itkRealToHalfHermitianForwardFFTImageFilter.h"
-#include "itkRegionOfInterestImageFilter.h"
 #include "itkTranslationTransform.h"
 #include "itkUnaryFrequencyDomainFilter.h"
 #include <cmath>
 #include <complex>
+#include <type_traits>
 
+#include "itkMontageInstrumentation.h"
 #include "itkPhaseCorrelationOperator.h"
 #include "itkPhaseCorrelationOptimizer.h"
 
@@ -54,10 +57,23 @@ public:
     MirrorWithExponentialDecay,
     Last = MirrorWithExponentialDecay
   };
+
+  /** \class FFTBackend
+   *  \brief Implementations of the forward and inverse FFTs.
+   *  \ingroup Montage */
+  enum class FFTBackend : uint8_t
+  {
+    Default = 0, // whatever the object factory returns, including overrides such as MKL or cuFFT
+    VNL,
+    FFTW, // requires ITK_USE_FFTWF or ITK_USE_FFTWD, matching the internal pixel type
+    Last = FFTW
+  };
 };
 
 extern Montage_EXPORT std::ostream &
                       operator<<(std::ostream & out, const PhaseCorrelationImageRegistrationMethodEnums::PaddingMethod value);
+extern Montage_EXPORT std::ostream &
+                      operator<<(std::ostream & out, const PhaseCorrelationImageRegistrationMethodEnums::FFTBackend value);
 
 /** \class PhaseCorrelationImageRegistrationMethod
  *  \brief Base class for phase-correlation-based image registration.
@@ -83,6 +99,11 @@ extern Montage_EXPORT std::ostream &
  *  This class will zero-pad the images so they have the same real size
  *  (in all dimensions) and are multiples of FFT's supported prime factors.
  *
+ *  Multi-component (e.g. RGB) input images are registered using their
+ *  luminance, or a single channel (see SetRegistrationChannel()).
+ *  The conversion happens on the fly during padding, via
+ *  LuminanceImageAdaptor, so no scalar copy of the inputs is made.
+ *
  *  Step 1. is performed by this class too using FFT filters supplied by
  *  itk::RealToHalfHermitianForwardFFTImageFilter::New() factory.
  *
@@ -215,6 +236,9 @@ public:
   /** Image's FFT type. */
   using ComplexImageType = typename FFTFilterType::OutputImageType;
 
+  /** Internal inverse FFT filter type. */
+  using IFFTFilterType = HalfHermitianToRealInverseFFTImageFilter<ComplexImageType, RealImageType>;
+
   /** Set the fixed image's cached FFT. */
   void
   SetFixedImageFFT(const ComplexImageType * fixedImageFFT);
@@ -248,11 +272,43 @@ public:
   SetOptimizer(OptimizerType *);
   itkGetConstObjectMacro(Optimizer, OptimizerType);
 
+  /** Set/Get instrumentation, which collects timings of the internal stages.
+   * It is passed on to the optimizer. When set, the internal pipeline
+   * is updated one stage at a time. Setting it does not modify the method.
+   * Null (the default) disables collection. */
+  void
+  SetInstrumentation(MontageInstrumentation * instrumentation)
+  {
+    m_Instrumentation = instrumentation;
+  }
+  MontageInstrumentation *
+  GetInstrumentation() const
+  {
+    return m_Instrumentation;
+  }
+
+  /** Seconds spent in each stage during the last update. Zeroes if not instrumented. */
+  itkGetConstReferenceMacro(StageTimes, MontageInstrumentation::StageTimes);
+
+  /** Bytes held by internal buffers: cropped, padded and transformed images,
+   * and the intermediate correlation images. Excludes the phase correlation image. */
+  SizeValueType
+  GetInternalBufferBytes() const;
+
   /** Given an image size, returns the smallest size
    *  which factorizes using FFT's prime factors. */
   SizeType
   RoundUpToFFTSize(SizeType inSize);
 
+  /** Pixels by which an overlap of overlapSize pixels is expanded when cropping to overlap,
+   * along a dimension where the smaller image has imageSize pixels. This is the median of
+   * 16 pixels, half of the overlap and 1% of the image size. With a positive tolerance
+   * (the optimizer's PixelDistanceTolerance), it is at most twice the tolerance.
+   * If the peak is then found in the outer quarter of the expansion, the translation
+   * might exceed the tolerance, so the pair is registered again without this limit. */
+  static SizeValueType
+  GetOverlapExpansion(SizeValueType overlapSize, SizeValueType imageSize, SizeValueType tolerance);
+
   /** Set/Get the PadToSize.
    *  Unset by setting a size of all zeroes.
    *
@@ -274,6 +330,33 @@ public:
   void
   SetPaddingMethod(const PaddingMethodEnum paddingMethod);
 
+  using FFTBackendEnum = PhaseCorrelationImageRegistrationMethodEnums::FFTBackend;
+
+  /** What an FFT backend prefers and how it runs. */
+  struct FFTBackendCapabilities
+  {
+    FFTBackendEnum Implementation = FFTBackendEnum::Default; // Default if the factory's choice is not recognized
+    SizeValueType  SizeGreatestPrimeFactor = 2;              // sizes with no greater prime factors are fastest
+    bool           MultiThreaded = false;                    // whether a single FFT uses multiple threads
+  };
+
+  /** Set/Get the implementation of the forward and inverse FFTs.
+   * Default is whatever the object factory returns. Requesting an implementation
+   * which was not compiled in throws an exception. Cached FFTs must come from the same backend. */
+  virtual void
+  SetFFTBackend(FFTBackendEnum backend);
+  itkGetConstMacro(FFTBackend, FFTBackendEnum);
+
+  /** Capabilities of the backend, determined from the FFT filter it creates. */
+  static FFTBackendCapabilities
+  GetFFTBackendCapabilities(FFTBackendEnum backend);
+
+  /** Creates a forward and an inverse FFT filter of the backend. */
+  static void
+  CreateFFTFilters(FFTBackendEnum                     backend,
+                   typename FFTFilterType::Pointer &  forward,
+                   typename IFFTFilterType::Pointer & inverse);
+
   /** Set/Get tile cropping. Should tiles be cropped to overlapping
    * region for computing the cross correlation? Default: True.
    *
@@ -282,6 +365,44 @@ public:
   itkSetMacro(CropToOverlap, bool);
   itkGetConstMacro(CropToOverlap, bool);
 
+  /** Set/Get pruning of the inverse FFT. Default: False.
+   *
+   * If the optimizer's PixelDistanceTolerance is set, it only searches
+   * a window of the correlation surface. When computing just that window,
+   * by a pruned inverse FFT, is estimated to be cheaper, the phase correlation
+   * image is not computed, and only holds its meta-data, so GetPhaseCorrelationImage()
+   * has no buffer. The pruned transform uses VNL, so pruning only happens with the VNL backend. */
+  itkSetMacro(PruneInverseFFT, bool);
+  itkGetConstMacro(PruneInverseFFT, bool);
+  itkBooleanMacro(PruneInverseFFT);
+
+  /** Set/Get the channel used for registration of multi-component images.
+   * Negative value (the default) means luminance. Ignored for scalar images.
+   * Throws if the channel is not less than the number of pixel components. */
+  virtual void
+  SetRegistrationChannel(int channel)
+  {
+    constexpr int fixedComponents = PixelTraits<FixedImagePixelType>::Dimension;
+    constexpr int movingComponents = PixelTraits<MovingImagePixelType>::Dimension;
+    if ((fixedComponents > 1 && channel >= fixedComponents) || (movingComponents > 1 && channel >= movingComponents))
+    {
+      itkExceptionMacro("Registration channel " << channel << " is out of range for pixels with "
+                                                << fixedComponents << " (fixed) and " << movingComponents
+                                                << " (moving) components");
+    }
+    if (m_RegistrationChannel != channel)
+    {
+      m_RegistrationChannel = channel;
+      this->Modified();
+    }
+  }
+  itkGetConstMacro(RegistrationChannel, int);
+
+  /** Set/Get number of candidate offsets to compute. At least one.
+   * Default is ImageDimension. Fewer can be found, see GetOffsets(). */
+  itkSetClampMacro(OffsetCount, unsigned, 1, NumericTraits<unsigned>::max());
+  itkGetConstMacro(OffsetCount, unsigned);
+
   /** Set/Get the order for Butterworth band-pass filtering
    * of complex correlation surface. Greater than zero. Default is 3. */
   itkSetMacro(ButterworthOrder, unsigned);
@@ -422,6 +543,11 @@ protected:
   void
   StartOptimization();
 
+  /** Updates crop, padding, forward FFT, operator and band-pass filters
+   * one at a time, timing each of them. Only invoked when instrumented. */
+  void
+  UpdateStagesSeparately();
+
   /** Method invoked by the pipeline in order to trigger the computation of
    * the registration. */
   void
@@ -436,15 +562,35 @@ protected:
 
 
   /** Types for internal componets. */
-  using FixedRoIType = RegionOfInterestImageFilter<FixedImageType, FixedImageType>;
-  using MovingRoIType = RegionOfInterestImageFilter<MovingImageType, MovingImageType>;
-  using FixedPadderImageFilter = PadImageFilter<FixedImageType, RealImageType>;
-  using MovingPadderImageFilter = PadImageFilter<MovingImageType, RealImageType>;
-  using FixedConstantPadderType = ConstantPadImageFilter<FixedImageType, RealImageType>;
-  using MovingConstantPadderType = ConstantPadImageFilter<MovingImageType, RealImageType>;
-  using FixedMirrorPadderType = MirrorPadImageFilter<FixedImageType, RealImageType>;
-  using MovingMirrorPadderType = MirrorPadImageFilter<MovingImageType, RealImageType>;
-  using IFFTFilterType = HalfHermitianToRealInverseFFTImageFilter<ComplexImageType, RealImageType>;
+  /** Scalar images are padded directly, multi-component ones through a luminance adaptor. */
+  using FixedIsScalar = typename std::is_arithmetic<FixedImagePixelType>::type;
+  using MovingIsScalar = typename std::is_arithmetic<MovingImagePixelType>::type;
+  using FixedAdaptorType = LuminanceImageAdaptor<FixedImageType, InternalPixelType>;
+  using MovingAdaptorType = LuminanceImageAdaptor<MovingImageType, InternalPixelType>;
+  using FixedPadderInputType = typename std::conditional<FixedIsScalar::value, FixedImageType, FixedAdaptorType>::type;
+  using MovingPadderInputType =
+    typename std::conditional<MovingIsScalar::value, MovingImageType, MovingAdaptorType>::type;
+
+  /** Overlaps are cropped, converted and padded in a single pass, without an intermediate cropped image. */
+  using FixedPadderImageFilter = CropPadImageFilter<FixedPadderInputType, RealImageType>;
+  using MovingPadderImageFilter = CropPadImageFilter<MovingPadderInputType, RealImageType>;
+
+  /** Whether FFTW was compiled with the precision of InternalPixelType. */
+  static constexpr bool FFTWSupportsInternalPixelType =
+#if defined(ITK_USE_FFTWF)
+    std::is_same<InternalPixelType, float>::value ||
+#endif
+#if defined(ITK_USE_FFTWD)
+    std::is_same<InternalPixelType, double>::value ||
+#endif
+    false;
+
+  static void
+  CreateFFTWFilters(typename FFTFilterType::Pointer &  forward,
+                    typename IFFTFilterType::Pointer & inverse,
+                    std::true_type);
+  static void
+  CreateFFTWFilters(typename FFTFilterType::Pointer &, typename IFFTFilterType::Pointer &, std::false_type);
   using BandBassFilterType =
     UnaryFrequencyDomainFilter<ComplexImageType,
                                FrequencyHalfHermitianFFTLayoutImageRegionIteratorWithIndex<ComplexImageType>>;
@@ -455,6 +601,23 @@ protected:
   FrequencyFunctorType       m_HighPassFunctor;
   FrequencyFunctorType       m_LowPassFunctor;
 
+  /** Connects the image to the padder, directly for scalar pixel types. */
+  template <typename TPadder, typename TAdaptor, typename TImage>
+  static void
+  ConnectPadder(TPadder * padder, TAdaptor *, const TImage * image, std::true_type)
+  {
+    padder->SetInput(image);
+  }
+
+  /** Connects the image to the padder through the adaptor for multi-component pixel types. */
+  template <typename TPadder, typename TAdaptor, typename TImage>
+  static void
+  ConnectPadder(TPadder * padder, TAdaptor * adaptor, const TImage * image, std::false_type)
+  {
+    adaptor->SetImage(const_cast<TImage *>(image));
+    padder->SetInput(adaptor);
+  }
+
 private:
   OperatorPointer  m_Operator = nullptr;
   OptimizerPointer m_Optimizer = nullptr;
@@ -469,20 +632,20 @@ private:
   SizeType          m_PadToSize;
   SizeType          m_ObligatoryPadding;
   PaddingMethodEnum m_PaddingMethod = PaddingMethodEnum::MirrorWithExponentialDecay;
+  FFTBackendEnum    m_FFTBackend = FFTBackendEnum::Default;
 
-  typename FixedRoIType::Pointer             m_FixedRoI = FixedRoIType::New();
-  typename MovingRoIType::Pointer            m_MovingRoI = MovingRoIType::New();
-  typename FixedPadderImageFilter::Pointer   m_FixedPadder = FixedPadderImageFilter::New();
-  typename MovingPadderImageFilter::Pointer  m_MovingPadder = MovingPadderImageFilter::New();
-  typename FixedConstantPadderType::Pointer  m_FixedConstantPadder = FixedConstantPadderType::New();
-  typename MovingConstantPadderType::Pointer m_MovingConstantPadder = MovingConstantPadderType::New();
-  typename FixedMirrorPadderType::Pointer    m_FixedMirrorPadder = FixedMirrorPadderType::New();
-  typename MovingMirrorPadderType::Pointer   m_MovingMirrorPadder = MovingMirrorPadderType::New();
-  typename FixedMirrorPadderType::Pointer    m_FixedMirrorWEDPadder = FixedMirrorPadderType::New();
-  typename MovingMirrorPadderType::Pointer   m_MovingMirrorWEDPadder = MovingMirrorPadderType::New();
-  typename BandBassFilterType::Pointer       m_BandPassFilter = BandBassFilterType::New();
+  typename FixedAdaptorType::Pointer        m_FixedAdaptor = FixedAdaptorType::New();
+  typename MovingAdaptorType::Pointer       m_MovingAdaptor = MovingAdaptorType::New();
+  typename FixedPadderImageFilter::Pointer  m_FixedPadder = FixedPadderImageFilter::New();
+  typename MovingPadderImageFilter::Pointer m_MovingPadder = MovingPadderImageFilter::New();
+  typename BandBassFilterType::Pointer      m_BandPassFilter = BandBassFilterType::New();
 
   bool     m_CropToOverlap = true;
+  bool     m_PruneInverseFFT = false;
+  int      m_RegistrationChannel = -1;
+  unsigned m_OffsetCount = ImageDimension;
+  bool     m_IgnoreTolerance = false; // when registering again with the usual overlap expansion
+  SizeType m_ReducedExpansion{};      // overlap expansion limited by tolerance, zero where not limited
   unsigned m_ButterworthOrder = 3;
   double   m_LowFrequency2 = 0.0004; // 0.02^2 // square of low frequency threshold
   double   m_HighFrequency2 = 0.09;  // 0.3^2 // square of high frequency threshold
@@ -490,6 +653,10 @@ private:
   typename FFTFilterType::Pointer  m_FixedFFT = FFTFilterType::New();
   typename FFTFilterType::Pointer  m_MovingFFT = FFTFilterType::New();
   typename IFFTFilterType::Pointer m_IFFT = IFFTFilterType::New();
+  typename RealImageType::Pointer  m_SurfaceInformation = RealImageType::New(); // not buffered, for pruning
+
+  MontageInstrumentation::Pointer    m_Instrumentation;
+  MontageInstrumentation::StageTimes m_StageTimes{};
 };
 
 } // end namespace itk
@@ -22,6 +22,12 @@
 
 #include "itkMath.h"
 #include "itkNumericTraits.h"
+#include "itkVnlHalfHermitianToRealInverseFFTImageFilter.h"
+#include "itkVnlRealToHalfHermitianForwardFFTImageFilter.h"
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+#  include "itkFFTWHalfHermitianToRealInverseFFTImageFilter.h"
+#  include "itkFFTWRealToHalfHermitianForwardFFTImageFilter.h"
+#endif
 
 #include <algorithm>
 #include <cmath>
@@ -37,10 +43,10 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
 
   m_BandPassFilter->SetFunctor(m_IdentityFunctor);
 
-  m_FixedConstantPadder->SetConstant(NumericTraits<FixedImagePixelType>::Zero);
-  m_MovingConstantPadder->SetConstant(NumericTraits<MovingImagePixelType>::Zero);
-  m_FixedMirrorWEDPadder->SetDecayBase(0.75);
-  m_MovingMirrorWEDPadder->SetDecayBase(0.75);
+  m_FixedPadder->SetConstant(NumericTraits<InternalPixelType>::ZeroValue());
+  m_MovingPadder->SetConstant(NumericTraits<InternalPixelType>::ZeroValue());
+  m_FixedFFT->SetInput(m_FixedPadder->GetOutput());
+  m_MovingFFT->SetInput(m_MovingPadder->GetOutput());
 
   m_BandPassFunctor = [this](typename BandBassFilterType::FrequencyIteratorType & freqIt) {
     double f2 = freqIt.GetFrequencyModuloSquare(); // square of scalar frequency
@@ -81,32 +87,136 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   {
     this->m_PaddingMethod = paddingMethod;
 
+    bool   mirror = true;
+    double decayBase = 1.0;
     switch (paddingMethod)
     {
       case PaddingMethodEnum::Zero:
-        m_FixedPadder = m_FixedConstantPadder;
-        m_MovingPadder = m_MovingConstantPadder;
+        mirror = false;
         break;
       case PaddingMethodEnum::Mirror:
-        m_FixedPadder = m_FixedMirrorPadder;
-        m_MovingPadder = m_MovingMirrorPadder;
         break;
       case PaddingMethodEnum::MirrorWithExponentialDecay:
-        m_FixedPadder = m_FixedMirrorWEDPadder;
-        m_MovingPadder = m_MovingMirrorWEDPadder;
+        decayBase = 0.75;
         break;
       default:
         itkExceptionMacro("Unknown padding method");
         break;
     }
 
+    m_FixedPadder->SetMirror(mirror);
+    m_MovingPadder->SetMirror(mirror);
+    m_FixedPadder->SetDecayBase(decayBase);
+    m_MovingPadder->SetDecayBase(decayBase);
+    this->Modified();
+  }
+}
+
+
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+void
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::CreateFFTFilters(
+  FFTBackendEnum                     backend,
+  typename FFTFilterType::Pointer &  forward,
+  typename IFFTFilterType::Pointer & inverse)
+{
+  switch (backend)
+  {
+    case FFTBackendEnum::Default:
+      forward = FFTFilterType::New();
+      inverse = IFFTFilterType::New();
+      break;
+    case FFTBackendEnum::VNL:
+      forward = VnlRealToHalfHermitianForwardFFTImageFilter<RealImageType, ComplexImageType>::New().GetPointer();
+      inverse = VnlHalfHermitianToRealInverseFFTImageFilter<ComplexImageType, RealImageType>::New().GetPointer();
+      break;
+    case FFTBackendEnum::FFTW:
+      CreateFFTWFilters(forward, inverse, std::integral_constant<bool, FFTWSupportsInternalPixelType>());
+      break;
+    default:
+      itkGenericExceptionMacro("Unknown FFT backend " << backend);
+  }
+}
+
+
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+void
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::CreateFFTWFilters(
+  typename FFTFilterType::Pointer &  forward,
+  typename IFFTFilterType::Pointer & inverse,
+  std::true_type)
+{
+  forward = FFTWRealToHalfHermitianForwardFFTImageFilter<RealImageType, ComplexImageType>::New().GetPointer();
+  inverse = FFTWHalfHermitianToRealInverseFFTImageFilter<ComplexImageType, RealImageType>::New().GetPointer();
+}
+#endif
+
+
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+void
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::CreateFFTWFilters(
+  typename FFTFilterType::Pointer &,
+  typename IFFTFilterType::Pointer &,
+  std::false_type)
+{
+  itkGenericExceptionMacro("FFTW backend was requested, but ITK was built without FFTW of "
+                           << sizeof(InternalPixelType) * 8 << "-bit precision (ITK_USE_FFTWF, ITK_USE_FFTWD)");
+}
+
+
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+void
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::SetFFTBackend(
+  FFTBackendEnum backend)
+{
+  if (m_FFTBackend != backend)
+  {
+    typename IFFTFilterType::Pointer unusedInverse;
+    CreateFFTFilters(backend, m_FixedFFT, m_IFFT);
+    CreateFFTFilters(backend, m_MovingFFT, unusedInverse);
+    m_FFTBackend = backend;
+
     m_FixedFFT->SetInput(m_FixedPadder->GetOutput());
     m_MovingFFT->SetInput(m_MovingPadder->GetOutput());
+    this->SetReleaseDataFlag(this->GetReleaseDataFlag());
+    this->SetReleaseDataBeforeUpdateFlag(this->GetReleaseDataBeforeUpdateFlag());
     this->Modified();
   }
 }
 
 
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+typename PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::FFTBackendCapabilities
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::GetFFTBackendCapabilities(
+  FFTBackendEnum backend)
+{
+  typename FFTFilterType::Pointer  forward;
+  typename IFFTFilterType::Pointer inverse;
+  CreateFFTFilters(backend, forward, inverse);
+
+  FFTBackendCapabilities capabilities;
+  capabilities.SizeGreatestPrimeFactor = forward->GetSizeGreatestPrimeFactor();
+  const std::string name = forward->GetNameOfClass();
+  if (name.compare(0, 3, "Vnl") == 0)
+  {
+    capabilities.Implementation = FFTBackendEnum::VNL;
+    capabilities.MultiThreaded = false;
+  }
+  else if (name.compare(0, 4, "FFTW") == 0)
+  {
+    capabilities.Implementation = FFTBackendEnum::FFTW;
+    capabilities.MultiThreaded = true;
+  }
+  else // other factory overrides, such as MKL and cuFFT, are parallel too
+  {
+    capabilities.Implementation = FFTBackendEnum::Default;
+    capabilities.MultiThreaded = true;
+  }
+  return capabilities;
+}
+
+
 template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
 void
 PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::Initialize()
@@ -139,19 +249,25 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
     transformOutput->Set(transform.GetPointer());
   }
 
-  // set up the pipeline
-  m_FixedRoI->SetInput(m_FixedImage);
-  m_MovingRoI->SetInput(m_MovingImage);
-  if (m_CropToOverlap)
-  {
-    m_FixedPadder->SetInput(m_FixedRoI->GetOutput());
-    m_MovingPadder->SetInput(m_MovingRoI->GetOutput());
-  }
-  else
+  // internal filters use this method's work units, e.g. a single one within a job bound to a NUMA node
+  for (ProcessObject * filter : { static_cast<ProcessObject *>(m_FixedPadder.GetPointer()),
+                                  static_cast<ProcessObject *>(m_MovingPadder.GetPointer()),
+                                  static_cast<ProcessObject *>(m_FixedFFT.GetPointer()),
+                                  static_cast<ProcessObject *>(m_MovingFFT.GetPointer()),
+                                  static_cast<ProcessObject *>(m_Operator.GetPointer()),
+                                  static_cast<ProcessObject *>(m_BandPassFilter.GetPointer()),
+                                  static_cast<ProcessObject *>(m_IFFT.GetPointer()),
+                                  static_cast<ProcessObject *>(m_Optimizer.GetPointer()) })
   {
-    m_FixedPadder->SetInput(m_FixedImage);
-    m_MovingPadder->SetInput(m_MovingImage);
+    filter->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
   }
+
+  // set up the pipeline, padders crop to overlap themselves
+  m_FixedAdaptor->SetChannel(m_RegistrationChannel);
+  m_MovingAdaptor->SetChannel(m_RegistrationChannel);
+  ConnectPadder(m_FixedPadder.GetPointer(), m_FixedAdaptor.GetPointer(), m_FixedImage.GetPointer(), FixedIsScalar());
+  ConnectPadder(
+    m_MovingPadder.GetPointer(), m_MovingAdaptor.GetPointer(), m_MovingImage.GetPointer(), MovingIsScalar());
   if (m_FixedImageFFT.IsNull())
   {
     m_Operator->SetFixedImage(m_FixedFFT->GetOutput());
@@ -194,10 +310,10 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   m_Optimizer->SetComplexInput(finalOperatorFilter->GetOutput());
   m_IFFT->SetInput(finalOperatorFilter->GetOutput());
   m_Optimizer->SetRealInput(m_IFFT->GetOutput());
-  if (m_CropToOverlap)
+  if (m_CropToOverlap) // origins of the overlaps
   {
-    m_Optimizer->SetFixedImage(m_FixedRoI->GetOutput());
-    m_Optimizer->SetMovingImage(m_MovingRoI->GetOutput());
+    m_Optimizer->SetFixedImage(m_FixedPadder->GetOutput());
+    m_Optimizer->SetMovingImage(m_MovingPadder->GetOutput());
   }
   else
   {
@@ -233,6 +349,29 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   return size;
 }
 
+
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+SizeValueType
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::GetOverlapExpansion(
+  SizeValueType overlapSize,
+  SizeValueType imageSize,
+  SizeValueType tolerance)
+{
+  std::array<SizeValueType, 3> padCandidates;
+  padCandidates[0] = 16;              // a fixed 16-pixel padding
+  padCandidates[1] = overlapSize / 2; // 50% of overlapping region
+  padCandidates[2] = imageSize / 100; // 1% of smaller image's size
+  std::sort(padCandidates.begin(), padCandidates.end());
+  SizeValueType expansion = padCandidates[1]; // pick median
+  if (tolerance > 0)
+  {
+    // the overlap moves by at most the tolerance, and we keep a margin of as much again
+    expansion = std::min(expansion, 2 * tolerance);
+  }
+  return expansion;
+}
+
+
 template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
 void
 PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::DeterminePadding()
@@ -241,6 +380,7 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   const SizeType movingSize = m_MovingImage->GetLargestPossibleRegion().GetSize();
   const SizeType size0 = SizeType::Filled(0);
   SizeType       fftSize, fixedPad, movingPad;
+  m_ReducedExpansion.Fill(0);
 
   if (m_CropToOverlap)
   {
@@ -258,27 +398,23 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
     mRegion.SetIndex(mIndex);
     fRegion.Crop(mRegion);
 
-    // now expand this region somewhat
+    // now expand this region somewhat, less if the translation is known to be small
     SizeType iSize = fRegion.GetSize();
     fIndex = fRegion.GetIndex();
-    SizeType                     extraPadding;
-    std::array<SizeValueType, 3> padCandidates;
+    SizeType            extraPadding;
+    const SizeValueType tolerance =
+      m_Optimizer.IsNotNull() && !m_IgnoreTolerance ? m_Optimizer->GetPixelDistanceTolerance() : 0;
     for (unsigned int d = 0; d < ImageDimension; ++d)
     {
-      padCandidates[0] = 16;                                          // a fixed 16-pixel padding
-      padCandidates[1] = std::ceil(iSize[d] / 2);                     // 50% of overlapping region
-      padCandidates[2] = std::min(fixedSize[d], movingSize[d]) / 100; // 1% of smaller image's size
-      std::sort(padCandidates.begin(), padCandidates.end());
-      extraPadding[d] = padCandidates[1]; // pick median
-
       // clip it to actual image sizes
-      if (extraPadding[d] + iSize[d] > fixedSize[d])
+      const SizeValueType imageSize = std::min(fixedSize[d], movingSize[d]);
+      const SizeValueType maxPadding = imageSize - iSize[d];
+      extraPadding[d] = std::min(maxPadding, GetOverlapExpansion(iSize[d], imageSize, 0));
+      const SizeValueType reduced = std::min(maxPadding, GetOverlapExpansion(iSize[d], imageSize, tolerance));
+      if (reduced < extraPadding[d])
       {
-        extraPadding[d] = fixedSize[d] - iSize[d];
-      }
-      if (extraPadding[d] + iSize[d] > movingSize[d])
-      {
-        extraPadding[d] = movingSize[d] - iSize[d];
+        extraPadding[d] = reduced;
+        m_ReducedExpansion[d] = reduced;
       }
 
       // expand regions appropriately
@@ -299,8 +435,8 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
     fRegion.SetSize(iSize);
     mRegion.SetIndex(mIndex);
     mRegion.SetSize(iSize);
-    m_FixedRoI->SetRegionOfInterest(fRegion);
-    m_MovingRoI->SetRegionOfInterest(mRegion);
+    m_FixedPadder->SetRegionOfInterest(fRegion);
+    m_MovingPadder->SetRegionOfInterest(mRegion);
 
     for (unsigned int d = 0; d < ImageDimension; ++d)
     {
@@ -315,6 +451,8 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   }
   else // do not crop to overlap
   {
+    m_FixedPadder->SetRegionOfInterest(typename FixedPadderImageFilter::InputImageRegionType());
+    m_MovingPadder->SetRegionOfInterest(typename MovingPadderImageFilter::InputImageRegionType());
     if (m_PadToSize == size0)
     {
       // set up padding to resize the images to the same size
@@ -392,6 +530,9 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   empty.Fill(0.0);
   m_TransformParameters = empty;
   itkDebugMacro("starting optimization");
+  using StageEnum = MontageInstrumentation::StageEnum;
+  m_StageTimes.fill(0.0);
+  MontageInstrumentation::StageTimes * stageTimes = m_Instrumentation ? &m_StageTimes : nullptr;
   using OffsetType = typename OptimizerType::OffsetType;
   OffsetType offset;
   try
@@ -404,26 +545,58 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
       WriteDebug(m_MovingPadder->GetOutput(), "m_MovingPadder.nrrd");
       WriteDebug(m_FixedFFT->GetOutput(), "m_FixedFFT.nrrd");
       WriteDebug(m_MovingFFT->GetOutput(), "m_MovingFFT.nrrd");
-      if (m_CropToOverlap)
-      {
-        WriteDebug(m_FixedRoI->GetOutput(), "m_FixedRoI.nrrd");
-        WriteDebug(m_MovingRoI->GetOutput(), "m_MovingRoI.nrrd");
-      }
     }
 
     m_FixedPadder->UpdateOutputInformation(); // to make sure xSize is valid
     unsigned xSize = m_FixedPadder->GetOutput()->GetLargestPossibleRegion().GetSize(0);
     m_IFFT->SetActualXDimensionIsOdd(xSize % 2 != 0);
     auto * phaseCorrelation = static_cast<RealImageType *>(this->ProcessObject::GetOutput(1));
-    phaseCorrelation->Allocate();
-    m_IFFT->GraftOutput(phaseCorrelation);
-    m_IFFT->Update();
 
-    const unsigned offsetCount = ImageDimension;
-    m_Optimizer->SetOffsetCount(offsetCount); // update can reduce this, so we have to set it each time
+    // the optimizer computes the surface over its search window from the complex correlation,
+    // if it is given the real correlation's regions and meta-data, but not its pixel buffer
+    m_IFFT->UpdateOutputInformation();
+    m_Optimizer->SetRealInput(m_IFFT->GetOutput());
+    // the pruned transform is VNL's, so it is not mixed with the surfaces of other backends
+    const bool vnlInverseFFT = std::string(m_IFFT->GetNameOfClass()).compare(0, 3, "Vnl") == 0;
+    const bool pruned = m_PruneInverseFFT && vnlInverseFFT && m_Optimizer->IsPrunedInverseFFTCheaper();
+    if (pruned)
+    {
+      m_SurfaceInformation->CopyInformation(m_IFFT->GetOutput());
+      m_SurfaceInformation->SetRegions(m_IFFT->GetOutput()->GetLargestPossibleRegion());
+      m_Optimizer->SetRealInput(m_SurfaceInformation);
+      phaseCorrelation->ReleaseData();
+      phaseCorrelation->CopyInformation(m_SurfaceInformation);
+    }
+    else
+    {
+      phaseCorrelation->Allocate();
+      m_IFFT->GraftOutput(phaseCorrelation);
+    }
+    if (m_Instrumentation)
+    {
+      this->UpdateStagesSeparately();
+    }
+    if (!pruned)
+    {
+      MontageInstrumentation::ScopedStageTimer ifftTimer(m_Instrumentation, StageEnum::InverseFFT, stageTimes);
+      m_IFFT->Update();
+    }
+
+    m_Optimizer->SetOffsetCount(m_OffsetCount); // update can reduce this, so we have to set it each time
+    m_Optimizer->SetInstrumentation(m_Instrumentation);
     m_Optimizer->Update();
+    if (m_Instrumentation)
+    {
+      for (unsigned i = 0; i < MontageInstrumentation::NumberOfStages; i++)
+      {
+        m_StageTimes[i] += m_Optimizer->GetStageTimes()[i];
+      }
+    }
     offset = m_Optimizer->GetOffsets()[0];
-    phaseCorrelation->Graft(m_IFFT->GetOutput());
+    if (!pruned)
+    {
+      phaseCorrelation->Graft(m_IFFT->GetOutput());
+    }
 
     if (m_FixedImageFFT.IsNull())
     {
@@ -481,6 +654,74 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
 }
 
 
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+void
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::UpdateStagesSeparately()
+{
+  using StageEnum = MontageInstrumentation::StageEnum;
+  using TimerType = MontageInstrumentation::ScopedStageTimer;
+  const bool fixedFFTNeeded = m_FixedImageFFT.IsNull();
+  const bool movingFFTNeeded = m_MovingImageFFT.IsNull();
+
+  {
+    // cropping is fused with padding, so its time is included in the padding stage
+    TimerType timer(m_Instrumentation, StageEnum::Padding, &m_StageTimes);
+    if (fixedFFTNeeded)
+    {
+      m_FixedPadder->Update();
+    }
+    if (movingFFTNeeded)
+    {
+      m_MovingPadder->Update();
+    }
+  }
+  {
+    TimerType timer(m_Instrumentation, StageEnum::ForwardFFT, &m_StageTimes);
+    if (fixedFFTNeeded)
+    {
+      m_FixedFFT->Update();
+    }
+    if (movingFFTNeeded)
+    {
+      m_MovingFFT->Update();
+    }
+  }
+  if (fixedFFTNeeded)
+  {
+    m_Instrumentation->AddFFTSize(m_FixedPadder->GetOutput()->GetLargestPossibleRegion().GetSize());
+  }
+  if (movingFFTNeeded)
+  {
+    m_Instrumentation->AddFFTSize(m_MovingPadder->GetOutput()->GetLargestPossibleRegion().GetSize());
+  }
+  {
+    TimerType timer(m_Instrumentation, StageEnum::Operator, &m_StageTimes);
+    m_Operator->Update();
+  }
+  if (m_IFFT->GetInput() == m_BandPassFilter->GetOutput()) // band-pass is not skipped
+  {
+    TimerType timer(m_Instrumentation, StageEnum::BandPass, &m_StageTimes);
+    m_BandPassFilter->Update();
+  }
+}
+
+
+template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
+SizeValueType
+PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::GetInternalBufferBytes() const
+{
+  SizeValueType bytes = 0;
+  bytes += MontageInstrumentation::GetBufferBytes(m_FixedPadder->GetOutput());
+  bytes += MontageInstrumentation::GetBufferBytes(m_MovingPadder->GetOutput());
+  bytes += MontageInstrumentation::GetBufferBytes(m_FixedImageFFT.GetPointer());
+  bytes += MontageInstrumentation::GetBufferBytes(m_MovingImageFFT.GetPointer());
+  bytes += MontageInstrumentation::GetBufferBytes(m_Operator->GetOutput());
+  bytes += MontageInstrumentation::GetBufferBytes(m_BandPassFilter->GetOutput());
+  bytes += MontageInstrumentation::GetBufferBytes(m_Optimizer->GetAdjustedInput());
+  return bytes;
+}
+
+
 template <typename TFixedImage, typename TMovingImage, typename TInternalPixelType>
 void
 PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::PrintSelf(std::ostream & os,
@@ -514,7 +755,11 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
       break;
   }
 
+  os << indent << "FFT Backend: " << m_FFTBackend << std::endl;
   os << indent << "Crop To Overlap: " << m_CropToOverlap << std::endl;
+  os << indent << "Prune Inverse FFT: " << m_PruneInverseFFT << std::endl;
+  os << indent << "Registration Channel: " << m_RegistrationChannel << std::endl;
+  os << indent << "Offset Count: " << m_OffsetCount << std::endl;
   os << indent << "Butterworth Order: " << m_ButterworthOrder << std::endl;
   os << indent << "Low Frequency: " << this->GetButterworthLowFrequency() << std::endl;
   os << indent << "High Frequency: " << this->GetButterworthHighFrequency() << std::endl;
@@ -524,6 +769,7 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   os << indent << "Fixed Image FFT: " << m_FixedImageFFT.GetPointer() << std::endl;
   os << indent << "Moving Image FFT: " << m_MovingImageFFT.GetPointer() << std::endl;
   os << indent << "Transform Parameters: " << m_TransformParameters << std::endl;
+  os << indent << "Instrumentation: " << m_Instrumentation.GetPointer() << std::endl;
 
   typename TransformType::ConstPointer t(this->GetOutput()->Get());
   os << indent << "Output transform: " << t.GetPointer() << std::endl;
@@ -537,6 +783,7 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   Superclass::GenerateOutputInformation();
 
   this->Initialize();
+  m_IgnoreTolerance = false;
   this->DeterminePadding();
 
   if (m_FixedImage->GetSpacing() != m_MovingImage->GetSpacing())
@@ -564,6 +811,30 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
 {
   this->Initialize();
   this->StartOptimization();
+
+  // a peak in the outer quarter of the expansion limited by tolerance might not be the true one,
+  // as the translation could exceed the tolerance, so we register again with the usual expansion
+  const typename FixedImageType::SpacingType spacing = m_FixedImage->GetSpacing();
+  bool                                       nearEdge = false;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    if (m_ReducedExpansion[d] > 0 && std::abs(m_TransformParameters[d]) / spacing[d] >= 0.75 * m_ReducedExpansion[d])
+    {
+      nearEdge = true;
+    }
+  }
+  if (nearEdge)
+  {
+    m_IgnoreTolerance = true;
+    m_FixedImageFFT = nullptr; // computed with the reduced size
+    m_MovingImageFFT = nullptr;
+    this->Initialize();
+    this->DeterminePadding();
+    m_IFFT->UpdateOutputInformation();
+    auto * phaseCorrelation = static_cast<RealImageType *>(this->ProcessObject::GetOutput(1));
+    phaseCorrelation->CopyInformation(m_IFFT->GetOutput());
+    this->StartOptimization();
+  }
 }
 
 
@@ -670,14 +941,8 @@ void
 PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixelType>::SetReleaseDataFlag(bool a_flag)
 {
   Superclass::SetReleaseDataFlag(a_flag);
-  m_FixedRoI->SetReleaseDataFlag(a_flag);
-  m_MovingRoI->SetReleaseDataFlag(a_flag);
-  m_FixedConstantPadder->SetReleaseDataFlag(a_flag);
-  m_MovingConstantPadder->SetReleaseDataFlag(a_flag);
-  m_FixedMirrorPadder->SetReleaseDataFlag(a_flag);
-  m_MovingMirrorPadder->SetReleaseDataFlag(a_flag);
-  m_FixedMirrorWEDPadder->SetReleaseDataFlag(a_flag);
-  m_MovingMirrorWEDPadder->SetReleaseDataFlag(a_flag);
+  m_FixedPadder->SetReleaseDataFlag(a_flag);
+  m_MovingPadder->SetReleaseDataFlag(a_flag);
   m_FixedFFT->SetReleaseDataFlag(a_flag);
   m_MovingFFT->SetReleaseDataFlag(a_flag);
   m_IFFT->SetReleaseDataFlag(a_flag);
@@ -690,14 +955,8 @@ PhaseCorrelationImageRegistrationMethod<TFixedImage, TMovingImage, TInternalPixe
   bool a_flag)
 {
   Superclass::SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_FixedRoI->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_MovingRoI->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_FixedConstantPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_MovingConstantPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_FixedMirrorPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_MovingMirrorPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_FixedMirrorWEDPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
-  m_MovingMirrorWEDPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
+  m_FixedPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
+  m_MovingPadder->SetReleaseDataBeforeUpdateFlag(a_flag);
   m_FixedFFT->SetReleaseDataBeforeUpdateFlag(a_flag);
   m_MovingFFT->SetReleaseDataBeforeUpdateFlag(a_flag);
   m_IFFT->SetReleaseDataBeforeUpdateFlag(a_flag);
@@ -18,6 +18,7 @@
 #ifndef itkPhaseCorrelationOptimizer_h
 #define itkPhaseCorrelationOptimizer_h
 
+#include "itkContinuousIndex.h"
 #include "itkImage.h"
 #include "itkNumericTraits.h"
 #include "itkProcessObject.h"
@@ -28,6 +29,7 @@
 #include "itkCyclicShiftImageFilter.h"
 #include "itkRealToHalfHermitianForwardFFTImageFilter.h"
 #include "itkFFTPadImageFilter.h"
+#include "itkMontageInstrumentation.h"
 
 namespace itk
 {
@@ -47,7 +49,8 @@ public:
     Parabolic = 1,
     Cosine = 2,
     WeightedMeanPhase = 3,
-    // PhaseFrequencySlope = 4,
+    UpsampledDFT = 4,
+    // PhaseFrequencySlope = 5,
   };
 
   // For iteration
@@ -59,6 +62,7 @@ public:
       PeakInterpolationMethod::Parabolic,
       PeakInterpolationMethod::Cosine,
       PeakInterpolationMethod::WeightedMeanPhase,
+      PeakInterpolationMethod::UpsampledDFT,
       // PeakInterpolationMethod::PhaseFrequencySlope
     };
     return methods;
@@ -90,6 +94,12 @@ extern Montage_EXPORT std::ostream &
  *  applies constraits from the SetMergePeaks, SetZeroSuppression, and
  *  SetPixelDistanceTolerance parameters.
  *
+ *  If PixelDistanceTolerance is set, only the search window of the real
+ *  correlation surface (see GetSearchWindow) is weighted and scanned for peaks.
+ *  The real input then need not be buffered: if only its regions and meta-data
+ *  are set, the window is computed from the complex input by a pruned inverse FFT,
+ *  which transforms one dimension at a time and keeps only the window's lines.
+ *
  *  For PeakInterpolationMethod::Parabolic or PeakInterpolationMethod::Cosine,
  *  a sub-pixel peak is found by fitting these functions to the real phase
  *  correlation surface.
@@ -103,6 +113,19 @@ extern Montage_EXPORT std::ostream &
  *
  *  Power spectrum weighted mean. (Eqn. 10)
  *
+ *  For PeakInterpolationMethod::UpsampledDFT, the first PhaseInterpolated
+ *  peaks are refined by evaluating the inverse DFT of the complex input
+ *  (the cross-power spectrum) only on a small grid around each peak,
+ *  with spacing of 1/UpsamplingFactor pixels, via separable matrix
+ *  multiplications. This is the approach of:
+ *
+ *    M. Guizar-Sicairos, S. T. Thurman, and J. R. Fienup,
+ *    "Efficient subpixel image registration algorithms,"
+ *    Opt. Lett. 33, 156-158 (2008).
+ *
+ *  The remaining peaks, and all the peaks if the complex input is not set,
+ *  are interpolated parabolically.
+ *
  *  Future work may add support for the
  *  slope of the phase-frequency least squares linear regression. (Eqn. 14)
  *
@@ -223,17 +246,56 @@ public:
   itkGetConstMacro(PixelDistanceTolerance, SizeValueType);
   itkSetMacro(PixelDistanceTolerance, SizeValueType);
 
-  /** Get correlation image biased towards the expected solution. */
+  using RegionType = typename ImageType::RegionType;
+
+  /** Region of the real input which can hold the peaks. Farther than ten times
+   * PixelDistanceTolerance from the expected offset the surface is ignored,
+   * and a margin of one pixel is kept for peak interpolation. The index is inside
+   * the real input, but the window can extend past its upper bound, as the surface
+   * wraps around. The whole real input if PixelDistanceTolerance is zero.
+   * Requires up-to-date output information of the fixed, moving and real inputs. */
+  RegionType
+  GetSearchWindow() const;
+
+  /** Whether computing only the search window, by a pruned inverse FFT of the complex input,
+   * is estimated to be cheaper than the inverse FFT of the whole real input.
+   * False if the window is the whole real input, or its size has prime factors greater than 5. */
+  bool
+  IsPrunedInverseFFTCheaper() const;
+
+  /** Get correlation image biased towards the expected solution.
+   * If PixelDistanceTolerance is set, it only covers the search window. */
   itkGetConstObjectMacro(AdjustedInput, ImageType);
 
   /** Indices of the maxima. */
   itkGetConstReferenceMacro(MaxIndices, IndexContainerType);
 
   /** Number of peaks to use phase-based sub-sample interpolation with the
-   * WeightedMeanPhase methods. */
+   * WeightedMeanPhase and UpsampledDFT methods. */
   itkGetConstMacro(PhaseInterpolated, unsigned int);
   itkSetMacro(PhaseInterpolated, unsigned int);
 
+  /** Get/Set upsampling factor of the UpsampledDFT method.
+   * Peaks are located to within 1/UpsamplingFactor of a pixel. Default is 20. */
+  itkGetConstMacro(UpsamplingFactor, unsigned int);
+  itkSetClampMacro(UpsamplingFactor, unsigned int, 1, 1000);
+
+  /** Set/Get instrumentation, which collects timings of peak search and interpolation.
+   * Setting it does not modify the optimizer. Null (the default) disables collection. */
+  void
+  SetInstrumentation(MontageInstrumentation * instrumentation)
+  {
+    m_Instrumentation = instrumentation;
+  }
+  MontageInstrumentation *
+  GetInstrumentation() const
+  {
+    return m_Instrumentation;
+  }
+
+  /** Seconds spent in each stage during the last update. Zeroes if not instrumented. */
+  itkGetConstReferenceMacro(StageTimes, MontageInstrumentation::StageTimes);
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   static_assert(!std::is_same<TRealPixel, bool>::value, "bool is not supported as RealPixelType");
 #endif
@@ -252,6 +314,34 @@ protected:
   void
   ComputeOffset();
 
+  using ContinuousIndexType = ContinuousIndex<OffsetScalarType, ImageDimension>;
+
+  /** Moves peak, an index into the real input, to the maximum of the inverse DFT
+   * of the complex input evaluated within 0.75 pixels of it, on a grid
+   * with spacing of 1/UpsamplingFactor pixels. Returns false, leaving peak unchanged,
+   * if the complex input is not available or does not match the real input.
+   * With s = ceil(1.5 * UpsamplingFactor) + 1 samples per dimension and the spectrum of N pixels
+   * contracted one dimension at a time, biggest first, the cost is O(s * N) for the first
+   * dimension, and each following one is cheaper by the ratio of s to the size of the one before. */
+  bool
+  RefinePeakUpsampledDFT(ContinuousIndexType & peak) const;
+
+  /** The complex input if it is the half-Hermitian spectrum of the real input, null otherwise. */
+  const ComplexImageType *
+  GetMatchingSpectrum() const;
+
+  /** Computes the buffered region of window, a search window of the real input,
+   * from the complex input. Inverse FFTs are done along one dimension at a time,
+   * keeping only the lines which cross the window, so the dimensions which shrink
+   * the most go first, and the half-Hermitian first dimension goes last.
+   * Returns false if the complex input does not match the real input. */
+  bool
+  PrunedInverseFFT(ImageType * window);
+
+  /** Dimensions other than the first, by increasing fraction of the real input kept in the window. */
+  static std::vector<unsigned>
+  GetPruningOrder(const RegionType & window, const RegionType & wholeImage);
+
   using Superclass::MakeOutput;
 
   /** Make a DataObject of the correct type to be used as the specified
@@ -274,18 +364,23 @@ private:
   SizeValueType                       m_PixelDistanceTolerance = 0;
 
   typename ImageType::Pointer m_AdjustedInput;
+  typename ImageType::Pointer m_SurfaceWindow; // the real input over the search window
   IndexContainerType          m_MaxIndices;
 
   using CyclicShiftFilterType = CyclicShiftImageFilter<ImageType>;
   typename CyclicShiftFilterType::Pointer m_CyclicShiftFilter = CyclicShiftFilterType::New();
 
   unsigned int m_PhaseInterpolated{ 1 };
+  unsigned int m_UpsamplingFactor{ 20 };
 
   using PadFilterType = FFTPadImageFilter<ImageType, ImageType>;
   typename PadFilterType::Pointer m_PadFilter = PadFilterType::New();
 
   using FFTFilterType = RealToHalfHermitianForwardFFTImageFilter<ImageType>;
   typename FFTFilterType::Pointer m_FFTFilter = FFTFilterType::New();
+
+  MontageInstrumentation::Pointer    m_Instrumentation;
+  MontageInstrumentation::StageTimes m_StageTimes{};
 };
 
 } // end namespace itk
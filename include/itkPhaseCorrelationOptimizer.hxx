@@ -23,9 +23,13 @@
 #include "itkImageRegionConstIterator.h"
 #include "itkImageRegionIteratorWithIndex.h"
 #include "itkCompensatedSummation.h"
+#include "vnl/algo/vnl_fft_1d.h"
+#include <algorithm>
 
 #include <cmath>
+#include <complex>
 #include <type_traits>
+#include <vector>
 
 //#ifndef NDEBUG
 #include "itkImageFileWriter.h"
@@ -70,6 +74,7 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::PhaseCorrelationOpti
   this->SetOffsetCount(4);
 
   this->m_AdjustedInput = ImageType::New();
+  this->m_SurfaceWindow = ImageType::New();
 
   this->m_PadFilter->SetSizeGreatestPrimeFactor(this->m_FFTFilter->GetSizeGreatestPrimeFactor());
   this->m_CyclicShiftFilter->SetInput(this->m_PadFilter->GetOutput());
@@ -111,6 +116,9 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::PrintSelf(std::ostre
   os << indent << "MergePeaks: " << m_MergePeaks << std::endl;
   os << indent << "ZeroSuppression: " << m_ZeroSuppression << std::endl;
   os << indent << "PixelDistanceTolerance: " << m_PixelDistanceTolerance << std::endl;
+  os << indent << "PhaseInterpolated: " << m_PhaseInterpolated << std::endl;
+  os << indent << "UpsamplingFactor: " << m_UpsamplingFactor << std::endl;
+  os << indent << "Instrumentation: " << m_Instrumentation.GetPointer() << std::endl;
 }
 
 
@@ -234,8 +242,53 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
   const typename ImageType::SizeType   size = wholeImage.GetSize();
   const typename ImageType::IndexType  oIndex = wholeImage.GetIndex();
 
+  using StageEnum = MontageInstrumentation::StageEnum;
+  m_StageTimes.fill(0.0);
+  MontageInstrumentation::StageTimes * stageTimes = m_Instrumentation ? &m_StageTimes : nullptr;
+
+  // indices of the search window can exceed the real input, as the surface wraps around
+  auto wrap = [&oIndex, &size](typename ImageType::IndexType ind) {
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      const auto n = static_cast<IndexValueType>(size[d]);
+      if (ind[d] >= oIndex[d] + n)
+      {
+        ind[d] -= n;
+      }
+    }
+    return ind;
+  };
+
+  // only the search window is weighted and scanned, so only it needs to be known
+  const typename ImageType::RegionType window = this->GetSearchWindow();
+  const ImageType *                    surface = input;
+  if (window != wholeImage)
+  {
+    m_SurfaceWindow->CopyInformation(input);
+    m_SurfaceWindow->SetRegions(window);
+    m_SurfaceWindow->Allocate(false);
+    if (input->GetBufferPointer() != nullptr && input->GetBufferedRegion().IsInside(wholeImage))
+    {
+      ImageRegionIteratorWithIndex<ImageType> wIt(m_SurfaceWindow, window);
+      for (; !wIt.IsAtEnd(); ++wIt)
+      {
+        wIt.Set(input->GetPixel(wrap(wIt.GetIndex())));
+      }
+    }
+    else // the registration method did not compute the whole surface
+    {
+      MontageInstrumentation::ScopedStageTimer ifftTimer(m_Instrumentation, StageEnum::InverseFFT, stageTimes);
+      if (!this->PrunedInverseFFT(m_SurfaceWindow))
+      {
+        itkExceptionMacro("The real input is not buffered, and the complex input is not its spectrum");
+      }
+    }
+    surface = m_SurfaceWindow.GetPointer();
+  }
+
   // ----- Start sample peak correlation optimization ----- //
-  OffsetType offset;
+  MontageInstrumentation::ScopedStageTimer peakSearchTimer(m_Instrumentation, StageEnum::PeakSearch, stageTimes);
+  OffsetType                               offset;
   offset.Fill(0);
 
   // create the image which will be biased towards the expected solution
@@ -243,7 +296,7 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
   // e^(-f*(d/s)^2), where f is distancePenaltyFactor,
   // d is pixel's distance, and s is approximate image size
   m_AdjustedInput->CopyInformation(input);
-  m_AdjustedInput->SetRegions(input->GetBufferedRegion());
+  m_AdjustedInput->SetRegions(surface->GetBufferedRegion());
   m_AdjustedInput->Allocate(false);
 
   typename ImageType::IndexType adjustedSize;
@@ -270,15 +323,15 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
 
   MultiThreaderBase * mt = this->GetMultiThreader();
   mt->ParallelizeImageRegion<ImageDimension>(
-    wholeImage,
+    window,
     [&](const typename ImageType::RegionType & region) {
-      ImageRegionConstIterator<ImageType>     iIt(input, region);
+      ImageRegionConstIterator<ImageType>     iIt(surface, region);
       ImageRegionIteratorWithIndex<ImageType> oIt(m_AdjustedInput, region);
       IndexValueType                          zeroDist2 =
         100 * m_PixelDistanceTolerance * m_PixelDistanceTolerance; // round down to zero further from this
       for (; !oIt.IsAtEnd(); ++iIt, ++oIt)
       {
-        typename ImageType::IndexType ind = oIt.GetIndex();
+        typename ImageType::IndexType ind = wrap(oIt.GetIndex());
         IndexValueType                dist = 0;
         for (unsigned d = 0; d < ImageDimension; d++)
         {
@@ -319,14 +372,14 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
   {
     constexpr IndexValueType znSize = 4; // zero neighborhood size, in city-block distance
     mt->ParallelizeImageRegion<ImageDimension>(
-      wholeImage,
+      window,
       [&](const typename ImageType::RegionType & region) {
         ImageRegionIteratorWithIndex<ImageType> oIt(m_AdjustedInput, region);
         for (; !oIt.IsAtEnd(); ++oIt)
         {
           bool                          pixelValid = false;
           typename ImageType::PixelType pixel;
-          typename ImageType::IndexType ind = oIt.GetIndex();
+          typename ImageType::IndexType ind = wrap(oIt.GetIndex());
           IndexValueType                dist = 0;
           for (unsigned d = 0; d < ImageDimension; d++)
           {
@@ -472,6 +525,13 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
     m_MaxIndices.resize(this->m_Offsets.size());
   }
 
+  // the surface is indexed by indices into the search window, the offsets by indices into the real input
+  const IndexContainerType windowIndices = m_MaxIndices;
+  for (auto & index : m_MaxIndices)
+  {
+    index = wrap(index);
+  }
+
   // double confidenceFactor = 1.0 / this->m_Confidences[0];
 
   for (unsigned m = 0; m < this->m_Confidences.size(); m++)
@@ -503,44 +563,50 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
     this->m_Offsets[m] = offset;
   }
   // ----- End sample peak correlation optimization ----- //
+  peakSearchTimer.Stop();
+  MontageInstrumentation::ScopedStageTimer interpolationTimer(
+    m_Instrumentation, StageEnum::SubPixelInterpolation, stageTimes);
 
 
-  const auto maxIndices = this->m_MaxIndices;
+  const auto                           maxIndices = this->m_MaxIndices;
+  const typename ImageType::RegionType surfaceRegion = surface->GetBufferedRegion();
 
   if (this->m_PeakInterpolationMethod != PeakInterpolationMethodEnum::None) // interpolate the peak
   {
     for (size_t offsetIndex = 0; offsetIndex < this->m_Offsets.size(); ++offsetIndex)
     {
       using ContinuousIndexType = ContinuousIndex<OffsetScalarType, ImageDimension>;
-      ContinuousIndexType           maxIndex = maxIndices[offsetIndex];
-      typename ImageType::IndexType tempIndex = maxIndices[offsetIndex];
-      typename ImageType::PixelType y0;
-      typename ImageType::PixelType y1 = input->GetPixel(tempIndex);
-      typename ImageType::PixelType y2;
+      ContinuousIndexType                 maxIndex = maxIndices[offsetIndex];
+      const typename ImageType::IndexType peakIndex = windowIndices[offsetIndex];
+      typename ImageType::IndexType       tempIndex = peakIndex;
+      typename ImageType::PixelType       y0;
+      typename ImageType::PixelType       y1 = surface->GetPixel(tempIndex);
+      typename ImageType::PixelType       y2;
 
       for (unsigned i = 0; i < ImageDimension; i++)
       {
-        tempIndex[i] = maxIndex[i] - 1;
-        if (!wholeImage.IsInside(tempIndex))
+        tempIndex[i] = peakIndex[i] - 1;
+        if (!surfaceRegion.IsInside(tempIndex))
         {
-          tempIndex[i] = maxIndex[i];
+          tempIndex[i] = peakIndex[i];
           continue;
         }
-        y0 = input->GetPixel(tempIndex);
-        tempIndex[i] = maxIndex[i] + 1;
-        if (!wholeImage.IsInside(tempIndex))
+        y0 = surface->GetPixel(tempIndex);
+        tempIndex[i] = peakIndex[i] + 1;
+        if (!surfaceRegion.IsInside(tempIndex))
         {
-          tempIndex[i] = maxIndex[i];
+          tempIndex[i] = peakIndex[i];
           continue;
         }
-        y2 = input->GetPixel(tempIndex);
-        tempIndex[i] = maxIndex[i];
+        y2 = surface->GetPixel(tempIndex);
+        tempIndex[i] = peakIndex[i];
 
         OffsetScalarType omega, theta, ratio;
         switch (this->m_PeakInterpolationMethod)
         {
           case PeakInterpolationMethodEnum::Parabolic:
           case PeakInterpolationMethodEnum::WeightedMeanPhase:
+          case PeakInterpolationMethodEnum::UpsampledDFT:
             maxIndex[i] += (y0 - y2) / (2 * (y0 - 2 * y1 + y2));
             break;
           case PeakInterpolationMethodEnum::Cosine:
@@ -575,49 +641,60 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
         // std::cout << "MAX Phase GENERATED: " << this->m_Offsets[offsetIndex] << std::endl;
       } // for ImageDimension
     }   // for offsetIndex
-    if (this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::WeightedMeanPhase)
+    if (this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::WeightedMeanPhase ||
+        this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::UpsampledDFT)
     {
       for (unsigned int peak = 0; peak < this->m_PhaseInterpolated && peak < this->m_Offsets.size(); ++peak)
       {
-        this->m_PadFilter->SetInput(this->m_AdjustedInput);
-        typename CyclicShiftFilterType::OffsetType shiftFilterOffset;
-        for (unsigned int dim = 0; dim < ImageDimension; ++dim)
+        ContinuousIndexType maxIndex = maxIndices[peak];
+        if (this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::UpsampledDFT)
         {
-          shiftFilterOffset[dim] = -maxIndices[peak][dim];
+          if (!this->RefinePeakUpsampledDFT(maxIndex))
+          {
+            break; // keep parabolic interpolation
+          }
         }
-        this->m_CyclicShiftFilter->SetShift(shiftFilterOffset);
-        this->m_FFTFilter->Update();
-        const typename FFTFilterType::OutputImageType * correlationFFT = this->m_FFTFilter->GetOutput();
-
-        using ContinuousIndexType = ContinuousIndex<OffsetScalarType, ImageDimension>;
-        ContinuousIndexType maxIndex = maxIndices[peak];
-        if (this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::WeightedMeanPhase)
+        else
         {
-          using SumType = CompensatedSummation<double>;
-          SumType                                            powerSum;
-          SumType                                            weightedPhase;
-          typename FFTFilterType::OutputImageType::IndexType index;
+          this->m_PadFilter->SetInput(this->m_AdjustedInput);
+          typename CyclicShiftFilterType::OffsetType shiftFilterOffset;
           for (unsigned int dim = 0; dim < ImageDimension; ++dim)
           {
-            powerSum.ResetToZero();
-            weightedPhase.ResetToZero();
-            index.Fill(0);
-            const SizeValueType maxFreqIndex = correlationFFT->GetLargestPossibleRegion().GetSize()[dim] / 2;
-            for (SizeValueType freqIndex = 1; freqIndex < maxFreqIndex; ++freqIndex)
+            shiftFilterOffset[dim] = window.GetIndex(dim) - windowIndices[peak][dim];
+          }
+          this->m_CyclicShiftFilter->SetShift(shiftFilterOffset);
+          this->m_FFTFilter->Update();
+          const typename FFTFilterType::OutputImageType * correlationFFT = this->m_FFTFilter->GetOutput();
+
+          if (this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::WeightedMeanPhase)
+          {
+            using SumType = CompensatedSummation<double>;
+            SumType                                            powerSum;
+            SumType                                            weightedPhase;
+            typename FFTFilterType::OutputImageType::IndexType index;
+            for (unsigned int dim = 0; dim < ImageDimension; ++dim)
             {
-              index[dim] = freqIndex;
-              const typename FFTFilterType::OutputPixelType correlation = correlationFFT->GetPixel(index);
-              const double                                  phase = std::arg(correlation);
-              const double power = correlation.imag() * correlation.imag() + correlation.real() * correlation.real();
-              weightedPhase += phase / Math::pi * power;
-              powerSum += power;
+              powerSum.ResetToZero();
+              weightedPhase.ResetToZero();
+              index.Fill(0);
+              const SizeValueType maxFreqIndex = correlationFFT->GetLargestPossibleRegion().GetSize()[dim] / 2;
+              for (SizeValueType freqIndex = 1; freqIndex < maxFreqIndex; ++freqIndex)
+              {
+                index[dim] = freqIndex;
+                const typename FFTFilterType::OutputPixelType correlation = correlationFFT->GetPixel(index);
+                const double                                  phase = std::arg(correlation);
+                const double                                  power =
+                  correlation.imag() * correlation.imag() + correlation.real() * correlation.real();
+                weightedPhase += phase / Math::pi * power;
+                powerSum += power;
+              }
+              const double deltaToF = -1 * weightedPhase.GetSum() / powerSum.GetSum();
+              maxIndex[dim] += deltaToF;
             }
-            const double deltaToF = -1 * weightedPhase.GetSum() / powerSum.GetSum();
-            maxIndex[dim] += deltaToF;
+            //} else if(this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::PhaseFrequencySlope) {
+            //// todo: compute the linear regression of the phase, use
+            //// slope, add to maxIndex
           }
-          //} else if(this->m_PeakInterpolationMethod == PeakInterpolationMethodEnum::PhaseFrequencySlope) {
-          //// todo: compute the linear regression of the phase, use
-          //// slope, add to maxIndex
         }
 
         for (unsigned i = 0; i < ImageDimension; ++i)
@@ -641,6 +718,334 @@ PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComputeOffset()
 }
 
 
+template <typename TRealPixelType, unsigned int VImageDimension>
+bool
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::RefinePeakUpsampledDFT(ContinuousIndexType & peak) const
+{
+  const ComplexImageType * spectrum = this->GetMatchingSpectrum();
+  if (spectrum == nullptr)
+  {
+    return false;
+  }
+  const auto *                                input = static_cast<const ImageType *>(this->GetInput(2));
+  const typename ImageType::RegionType        wholeImage = input->GetLargestPossibleRegion();
+  const typename ComplexImageType::RegionType spectrumRegion = spectrum->GetBufferedRegion();
+  const typename ComplexImageType::SizeType   spectrumSize = spectrumRegion.GetSize();
+
+  // grid of samples per dimension, covering +-0.75 pixel around the peak
+  const SizeValueType samples = static_cast<SizeValueType>(std::ceil(1.5 * m_UpsamplingFactor)) + 1;
+  const double        halfSpan = (samples - 1) / 2.0;
+
+  // the spectrum is contracted with the inverse DFT kernel, one dimension at a time.
+  // Each contraction costs the current data size times the number of samples, and shrinks
+  // the contracted dimension to the number of samples, so the biggest dimensions go first.
+  using ComplexType = std::complex<double>;
+  std::vector<ComplexType> data(spectrum->GetBufferPointer(),
+                                spectrum->GetBufferPointer() + spectrumRegion.GetNumberOfPixels());
+  SizeValueType            extents[ImageDimension];
+  unsigned                 order[ImageDimension];
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    extents[d] = spectrumSize[d];
+    order[d] = d;
+  }
+  std::stable_sort(order, order + ImageDimension, [&extents](unsigned a, unsigned b) {
+    return extents[a] > extents[b];
+  });
+  std::vector<ComplexType> kernel;
+  std::vector<ComplexType> contracted;
+  for (unsigned d : order)
+  {
+    const SizeValueType n = wholeImage.GetSize(d);
+    const SizeValueType frequencies = extents[d];
+    kernel.resize(samples * frequencies);
+    for (SizeValueType j = 0; j < samples; j++)
+    {
+      const double x = peak[d] - wholeImage.GetIndex(d) + (j - halfSpan) / m_UpsamplingFactor;
+      for (SizeValueType k = 0; k < frequencies; k++)
+      {
+        double frequency = k;
+        double weight = 1.0;
+        if (d == 0) // the omitted half holds complex conjugates
+        {
+          weight = (k == 0 || 2 * k == n) ? 1.0 : 2.0;
+        }
+        else if (2 * k > n)
+        {
+          frequency -= n;
+        }
+        kernel[j * frequencies + k] = weight * std::polar(1.0, 2.0 * Math::pi * frequency * x / n);
+      }
+    }
+
+    SizeValueType inner = 1; // faster-varying dimensions
+    for (unsigned e = 0; e < d; e++)
+    {
+      inner *= extents[e];
+    }
+    SizeValueType outer = 1; // slower-varying dimensions
+    for (unsigned e = d + 1; e < ImageDimension; e++)
+    {
+      outer *= extents[e];
+    }
+    contracted.assign(inner * samples * outer, ComplexType(0.0));
+    for (SizeValueType o = 0; o < outer; o++)
+    {
+      for (SizeValueType j = 0; j < samples; j++)
+      {
+        ComplexType * out = &contracted[(o * samples + j) * inner];
+        for (SizeValueType k = 0; k < frequencies; k++)
+        {
+          const ComplexType   w = kernel[j * frequencies + k];
+          const ComplexType * in = &data[(o * frequencies + k) * inner];
+          for (SizeValueType i = 0; i < inner; i++)
+          {
+            out[i] += w * in[i];
+          }
+        }
+      }
+    }
+    data.swap(contracted);
+    extents[d] = samples;
+  }
+
+  // the inverse DFT of the real surface is real, so its maximum is the peak
+  SizeValueType maxSample = 0;
+  for (SizeValueType s = 1; s < data.size(); s++)
+  {
+    if (data[s].real() > data[maxSample].real())
+    {
+      maxSample = s;
+    }
+  }
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    peak[d] += (maxSample % samples - halfSpan) / m_UpsamplingFactor;
+    maxSample /= samples;
+  }
+  return true;
+}
+
+
+template <typename TRealPixelType, unsigned int VImageDimension>
+typename PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::RegionType
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::GetSearchWindow() const
+{
+  using ImageBaseType = ImageBase<ImageDimension>;
+  const auto *     fixed = static_cast<const ImageBaseType *>(this->GetInput(0));
+  const auto *     moving = static_cast<const ImageBaseType *>(this->GetInput(1));
+  const auto *     input = static_cast<const ImageType *>(this->GetInput(2));
+  const RegionType wholeImage = input->GetLargestPossibleRegion();
+  RegionType       window = wholeImage;
+  if (m_PixelDistanceTolerance == 0)
+  {
+    return window;
+  }
+
+  // ComputeOffset zeroes the pixels farther than 10 * tolerance from the expected index
+  const SizeValueType radius = 10 * m_PixelDistanceTolerance + 1;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    if (2 * radius + 1 >= wholeImage.GetSize(d))
+    {
+      continue; // the whole dimension
+    }
+    const auto           n = static_cast<IndexValueType>(wholeImage.GetSize(d));
+    const IndexValueType expectedIndex =
+      (moving->GetOrigin()[d] - fixed->GetOrigin()[d]) / fixed->GetSpacing()[d] + wholeImage.GetIndex(d);
+    IndexValueType start = (expectedIndex - static_cast<IndexValueType>(radius) - wholeImage.GetIndex(d)) % n;
+    if (start < 0)
+    {
+      start += n;
+    }
+    window.SetIndex(d, wholeImage.GetIndex(d) + start);
+    window.SetSize(d, 2 * radius + 1);
+  }
+  return window;
+}
+
+
+template <typename TRealPixelType, unsigned int VImageDimension>
+std::vector<unsigned>
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::GetPruningOrder(const RegionType & window,
+                                                                            const RegionType & wholeImage)
+{
+  std::vector<unsigned> order;
+  for (unsigned d = 1; d < ImageDimension; d++)
+  {
+    order.push_back(d);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return window.GetSize(a) * wholeImage.GetSize(b) < window.GetSize(b) * wholeImage.GetSize(a);
+  });
+  return order;
+}
+
+
+template <typename TRealPixelType, unsigned int VImageDimension>
+bool
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::IsPrunedInverseFFTCheaper() const
+{
+  const auto *     input = static_cast<const ImageType *>(this->GetInput(2));
+  const RegionType wholeImage = input->GetLargestPossibleRegion();
+  const RegionType window = this->GetSearchWindow();
+  if (window == wholeImage)
+  {
+    return false;
+  }
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    SizeValueType n = wholeImage.GetSize(d);
+    for (SizeValueType factor : { 2, 3, 5 }) // the sizes vnl_fft_1d supports
+    {
+      while (n % factor == 0)
+      {
+        n /= factor;
+      }
+    }
+    if (n != 1)
+    {
+      return false;
+    }
+  }
+
+  // a transform of length n along each of the lines costs about n * log2(n) per line
+  const double n0 = wholeImage.GetSize(0);
+  double       lines = 1.0; // along the first dimension
+  for (unsigned d = 1; d < ImageDimension; d++)
+  {
+    lines *= wholeImage.GetSize(d);
+  }
+  const double spectrumSize = (n0 / 2 + 1) * lines;
+
+  double fullCost = lines * n0 / 2 * std::log2(n0); // half-complex transforms along the first dimension
+  double prunedCost = 0.0;
+  double remaining = spectrumSize;
+  for (unsigned d : GetPruningOrder(window, wholeImage))
+  {
+    const double n = wholeImage.GetSize(d);
+    fullCost += spectrumSize * std::log2(n);
+    prunedCost += remaining * std::log2(n);
+    remaining = remaining / n * window.GetSize(d);
+  }
+  prunedCost += remaining / (n0 / 2 + 1) * n0 * std::log2(n0); // full complex transforms of the remaining lines
+  return prunedCost < fullCost;
+}
+
+
+template <typename TRealPixelType, unsigned int VImageDimension>
+const typename PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::ComplexImageType *
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::GetMatchingSpectrum() const
+{
+  const auto * input = static_cast<const ImageType *>(this->GetInput(2));
+  const auto * spectrum = static_cast<const ComplexImageType *>(this->GetInput(3));
+  if (spectrum == nullptr || spectrum->GetBufferPointer() == nullptr)
+  {
+    return nullptr;
+  }
+  const typename ImageType::RegionType      wholeImage = input->GetLargestPossibleRegion();
+  const typename ComplexImageType::SizeType spectrumSize = spectrum->GetBufferedRegion().GetSize();
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    // the spectrum is half-Hermitian along the first dimension
+    const SizeValueType expectedSize = d == 0 ? wholeImage.GetSize(0) / 2 + 1 : wholeImage.GetSize(d);
+    if (spectrumSize[d] != expectedSize)
+    {
+      return nullptr;
+    }
+  }
+  return spectrum;
+}
+
+
+template <typename TRealPixelType, unsigned int VImageDimension>
+bool
+PhaseCorrelationOptimizer<TRealPixelType, VImageDimension>::PrunedInverseFFT(ImageType * window)
+{
+  const ComplexImageType * spectrum = this->GetMatchingSpectrum();
+  if (spectrum == nullptr)
+  {
+    return false;
+  }
+  const auto *     input = static_cast<const ImageType *>(this->GetInput(2));
+  const RegionType wholeImage = input->GetLargestPossibleRegion();
+  const RegionType windowRegion = window->GetBufferedRegion();
+
+  const SizeValueType           spectrumPixels = spectrum->GetBufferedRegion().GetNumberOfPixels();
+  std::vector<ComplexPixelType> data(spectrum->GetBufferPointer(), spectrum->GetBufferPointer() + spectrumPixels);
+  std::vector<ComplexPixelType> pruned;
+  SizeValueType                 extents[ImageDimension];
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    extents[d] = spectrum->GetBufferedRegion().GetSize(d);
+  }
+
+  std::vector<unsigned> order = GetPruningOrder(windowRegion, wholeImage);
+  order.push_back(0); // the fewest lines remain at the end
+  MultiThreaderBase * mt = this->GetMultiThreader();
+  for (unsigned d : order)
+  {
+    const SizeValueType n = wholeImage.GetSize(d);
+    const SizeValueType frequencies = extents[d]; // n/2+1 along the first dimension, otherwise n
+    const SizeValueType kept = windowRegion.GetSize(d);
+    const SizeValueType first = windowRegion.GetIndex(d) - wholeImage.GetIndex(d);
+    SizeValueType       inner = 1; // faster-varying dimensions
+    for (unsigned e = 0; e < d; e++)
+    {
+      inner *= extents[e];
+    }
+    SizeValueType outer = 1; // slower-varying dimensions
+    for (unsigned e = d + 1; e < ImageDimension; e++)
+    {
+      outer *= extents[e];
+    }
+    const SizeValueType lines = inner * outer;
+    const SizeValueType chunks = std::min<SizeValueType>(lines, mt->GetNumberOfWorkUnits());
+    pruned.resize(inner * kept * outer);
+
+    mt->ParallelizeArray(
+      0,
+      chunks,
+      [&](SizeValueType chunk) {
+        vnl_fft_1d<RealPixelType>     fft(n);
+        std::vector<ComplexPixelType> line(n);
+        for (SizeValueType l = chunk * lines / chunks; l < (chunk + 1) * lines / chunks; l++)
+        {
+          const SizeValueType      i = l % inner;
+          const SizeValueType      o = l / inner;
+          const ComplexPixelType * in = &data[o * frequencies * inner + i];
+          for (SizeValueType k = 0; k < frequencies; k++)
+          {
+            line[k] = in[k * inner];
+          }
+          for (SizeValueType k = frequencies; k < n; k++) // the omitted half holds complex conjugates
+          {
+            line[k] = std::conj(line[n - k]);
+          }
+          fft.bwd_transform(line);
+          ComplexPixelType * out = &pruned[o * kept * inner + i];
+          for (SizeValueType j = 0; j < kept; j++)
+          {
+            out[j * inner] = line[(first + j) % n];
+          }
+        }
+      },
+      nullptr);
+    data.swap(pruned);
+    extents[d] = kept;
+  }
+
+  // the result is real, and normalized as by the inverse FFT filter
+  const double    scale = 1.0 / wholeImage.GetNumberOfPixels();
+  RealPixelType * buffer = window->GetBufferPointer();
+  for (SizeValueType s = 0; s < data.size(); s++)
+  {
+    buffer[s] = data[s].real() * scale;
+  }
+  return true;
+}
+
+
 } // end namespace itk
 
 #endif
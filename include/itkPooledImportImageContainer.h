@@ -0,0 +1,165 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkPooledImportImageContainer_h
+#define itkPooledImportImageContainer_h
+
+#include "itkImportImageContainer.h"
+#include "itkMontageBufferPool.h"
+#include "itkObjectFactoryBase.h"
+#include "itkVersion.h"
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace itk
+{
+
+/** \class PooledImportImageContainer
+ * \brief Pixel container which draws large buffers from MontageBufferPool.
+ *
+ * Within a MontageBufferPool::Scope, buffers of at least the pool's minimum size
+ * are acquired from the pool, and are returned to it when the container releases them,
+ * wherever that happens. Elsewhere, this behaves exactly as ImportImageContainer:
+ * the container remembers its pooled buffers, so other buffers never touch the pool.
+ *
+ * Images create their pixel containers through the object factory. While a Registration exists,
+ * every image of that pixel type uses this container; the override is removed with the last Registration.
+ *
+ * \ingroup Montage
+ */
+template <typename TElementIdentifier, typename TElement>
+class ITK_TEMPLATE_EXPORT PooledImportImageContainer : public ImportImageContainer<TElementIdentifier, TElement>
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(PooledImportImageContainer);
+
+  /** Standard class type aliases. */
+  using Self = PooledImportImageContainer;
+  using Superclass = ImportImageContainer<TElementIdentifier, TElement>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  using ElementIdentifier = TElementIdentifier;
+  using Element = TElement;
+
+  static_assert(std::is_trivially_destructible<TElement>::value,
+                "Pooled buffers are reused without destroying their elements");
+
+  /** Method for creation, not through the object factory, which creates this class instead of the superclass. */
+  itkFactorylessNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(PooledImportImageContainer, ImportImageContainer);
+
+  /** \class Registration
+   * \brief Makes images with pixels of type TElement use this container while it exists.
+   * Registrations are counted: the factory is registered with the first one,
+   * and unregistered with the last one.
+   * \ingroup Montage */
+  class Registration
+  {
+  public:
+    ITK_DISALLOW_COPY_AND_ASSIGN(Registration);
+
+    Registration();
+    ~Registration();
+  };
+
+protected:
+  PooledImportImageContainer() = default;
+  ~PooledImportImageContainer() override;
+
+  TElement *
+  AllocateElements(ElementIdentifier size, bool UseValueInitialization = false) const override;
+
+  void
+  DeallocateManagedMemory() override;
+
+private:
+  mutable std::vector<TElement *> m_PooledBuffers; // acquired from the pool and not released yet
+
+  struct RegistrationState
+  {
+    std::mutex                 m_Mutex;
+    unsigned                   m_Count = 0;
+    ObjectFactoryBase::Pointer m_Factory; // registered while m_Count > 0
+  };
+
+  static RegistrationState &
+  GetRegistrationState();
+
+  /** \class Factory
+   * \brief Overrides ImportImageContainer by PooledImportImageContainer.
+   * \ingroup Montage */
+  class Factory : public ObjectFactoryBase
+  {
+  public:
+    using Self = Factory;
+    using Superclass = ObjectFactoryBase;
+    using Pointer = SmartPointer<Self>;
+
+    itkFactorylessNewMacro(Self);
+    itkTypeMacro(Factory, ObjectFactoryBase);
+
+    const char *
+    GetITKSourceVersion() const override
+    {
+      return ITK_SOURCE_VERSION;
+    }
+    const char *
+    GetDescription() const override
+    {
+      return "Pixel containers with buffers from MontageBufferPool";
+    }
+
+  protected:
+    Factory();
+  };
+};
+
+/** Registers PooledImportImageContainer for images with pixels of type TElement until
+ * the returned handle is released, unless its elements need destruction, which pooled buffers would skip.
+ * Then, the returned handle is null. */
+template <typename TElement>
+std::shared_ptr<void>
+RegisterPooledPixelType(std::true_type)
+{
+  return std::make_shared<typename PooledImportImageContainer<SizeValueType, TElement>::Registration>();
+}
+template <typename TElement>
+std::shared_ptr<void>
+RegisterPooledPixelType(std::false_type)
+{
+  return nullptr;
+}
+template <typename TElement>
+std::shared_ptr<void>
+RegisterPooledPixelType()
+{
+  return RegisterPooledPixelType<TElement>(std::is_trivially_destructible<TElement>());
+}
+
+} // namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkPooledImportImageContainer.hxx"
+#endif
+
+#endif // itkPooledImportImageContainer_h
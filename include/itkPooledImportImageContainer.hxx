@@ -0,0 +1,122 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkPooledImportImageContainer_hxx
+#define itkPooledImportImageContainer_hxx
+
+#include "itkPooledImportImageContainer.h"
+
+#include <algorithm>
+#include <new>
+
+namespace itk
+{
+
+template <typename TElementIdentifier, typename TElement>
+PooledImportImageContainer<TElementIdentifier, TElement>::Factory::Factory()
+{
+  this->RegisterOverride(typeid(Superclass).name(),
+                         typeid(PooledImportImageContainer).name(),
+                         "Pooled pixel container",
+                         true,
+                         CreateObjectFunction<PooledImportImageContainer>::New());
+}
+
+template <typename TElementIdentifier, typename TElement>
+auto
+PooledImportImageContainer<TElementIdentifier, TElement>::GetRegistrationState() -> RegistrationState &
+{
+  static RegistrationState state;
+  return state;
+}
+
+template <typename TElementIdentifier, typename TElement>
+PooledImportImageContainer<TElementIdentifier, TElement>::Registration::Registration()
+{
+  RegistrationState &         state = GetRegistrationState();
+  std::lock_guard<std::mutex> lock(state.m_Mutex);
+  if (state.m_Count++ == 0)
+  {
+    state.m_Factory = Factory::New();
+    ObjectFactoryBase::RegisterFactory(state.m_Factory);
+  }
+}
+
+template <typename TElementIdentifier, typename TElement>
+PooledImportImageContainer<TElementIdentifier, TElement>::Registration::~Registration()
+{
+  RegistrationState &         state = GetRegistrationState();
+  std::lock_guard<std::mutex> lock(state.m_Mutex);
+  if (--state.m_Count == 0)
+  {
+    ObjectFactoryBase::UnRegisterFactory(state.m_Factory);
+    state.m_Factory = nullptr;
+  }
+}
+
+template <typename TElementIdentifier, typename TElement>
+PooledImportImageContainer<TElementIdentifier, TElement>::~PooledImportImageContainer()
+{
+  // superclass' destructor would not call the override
+  this->DeallocateManagedMemory();
+}
+
+template <typename TElementIdentifier, typename TElement>
+TElement *
+PooledImportImageContainer<TElementIdentifier, TElement>::AllocateElements(ElementIdentifier size,
+                                                                           bool UseValueInitialization) const
+{
+  MontageBufferPool * pool = MontageBufferPool::GetThreadPool();
+  const SizeValueType bytes = static_cast<SizeValueType>(size) * sizeof(TElement);
+  if (pool == nullptr || bytes < pool->GetMinimumBytes())
+  {
+    return Superclass::AllocateElements(size, UseValueInitialization);
+  }
+
+  auto * data = static_cast<TElement *>(pool->Acquire(bytes));
+  m_PooledBuffers.push_back(data); // while growing, the old buffer is released after the new one is allocated
+  if (UseValueInitialization || !std::is_trivially_default_constructible<TElement>::value)
+  {
+    for (ElementIdentifier i = 0; i < size; i++)
+    {
+      new (data + i) TElement();
+    }
+  }
+  return data;
+}
+
+template <typename TElementIdentifier, typename TElement>
+void
+PooledImportImageContainer<TElementIdentifier, TElement>::DeallocateManagedMemory()
+{
+  TElement * data = this->GetImportPointer();
+  auto       it = std::find(m_PooledBuffers.begin(), m_PooledBuffers.end(), data);
+  if (data != nullptr && it != m_PooledBuffers.end())
+  {
+    m_PooledBuffers.erase(it);
+    if (this->GetContainerManageMemory())
+    {
+      MontageBufferPool::GetInstance().Release(data);
+      this->ContainerManageMemoryOff(); // the superclass only resets the pointer and sizes
+    }
+  }
+  Superclass::DeallocateManagedMemory();
+}
+
+} // namespace itk
+
+#endif // itkPooledImportImageContainer_hxx
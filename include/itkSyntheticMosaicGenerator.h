@@ -0,0 +1,214 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkSyntheticMosaicGenerator_h
+#define itkSyntheticMosaicGenerator_h
+
+#include "itkFixedArray.h"
+#include "itkImage.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkTileConfiguration.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace itk
+{
+/** \class SyntheticMosaicGenerator
+ * \brief Produces tiles of a procedurally textured mosaic on demand, with known positions.
+ *
+ * The mosaic is a smooth multi-octave value noise texture, defined everywhere,
+ * so tiles can be produced lazily, in any order, in parallel, and at sub-pixel positions.
+ * Nominal (stage) positions form a regular grid with the given overlap.
+ * True positions are the stage positions displaced by a pseudorandom jitter,
+ * uniformly distributed within +/- Jitter along each dimension.
+ * A fraction of tiles can be made outliers, whose content comes from an unrelated texture,
+ * so registrations of their pairs fail. Everything is determined by the seed,
+ * and nothing is stored per tile, so mosaics of millions of tiles can be produced.
+ *
+ * Positions are in index space, and tiles have unit spacing and identity direction.
+ * Tile images have origin at the stage position, and pixels sampled at the true position.
+ * Pixel type must be scalar.
+ *
+ * Feed tiles to TileMontage (or TileMergeImageFilter) via GetTileSource(),
+ * and compare the results to GetTrueConfiguration().
+ *
+ * \ingroup Montage
+ */
+template <typename TImageType>
+class ITK_TEMPLATE_EXPORT SyntheticMosaicGenerator : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(SyntheticMosaicGenerator);
+
+  /** Standard class type aliases. */
+  using Self = SyntheticMosaicGenerator;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SyntheticMosaicGenerator, Object);
+
+  using ImageType = TImageType;
+  static constexpr unsigned int ImageDimension = ImageType::ImageDimension;
+
+  using ImagePointer = typename ImageType::Pointer;
+  using PixelType = typename ImageType::PixelType;
+  using RegionType = typename ImageType::RegionType;
+  using IndexType = typename ImageType::IndexType;
+  using SizeType = typename ImageType::SizeType;
+  using ArrayType = FixedArray<double, ImageDimension>;
+  using TileConfigurationType = TileConfiguration<ImageDimension>;
+  using TileIndexType = typename TileConfigurationType::TileIndexType;
+  using PointType = typename TileConfigurationType::PointType;
+
+  /** Same signature as TileMontage::TileSourceType. */
+  using TileSourceType = std::function<ImagePointer(SizeValueType linearIndex, bool metadataOnly, const RegionType &)>;
+
+  /** Set/Get number of tiles along each dimension. */
+  itkSetMacro(MontageSize, TileIndexType);
+  itkGetConstMacro(MontageSize, TileIndexType);
+
+  /** Set/Get size of each tile, in pixels. */
+  itkSetMacro(TileSize, SizeType);
+  itkGetConstMacro(TileSize, SizeType);
+
+  /** Set/Get overlap of adjacent tiles, as a fraction of tile size, along each dimension. */
+  itkSetMacro(Overlap, ArrayType);
+  itkGetConstMacro(Overlap, ArrayType);
+
+  /** Set/Get maximum displacement of true positions from stage positions,
+   * in pixels, along each dimension. */
+  itkSetMacro(Jitter, ArrayType);
+  itkGetConstMacro(Jitter, ArrayType);
+
+  /** Set/Get the fraction of tiles whose content is unrelated to the mosaic. */
+  itkSetClampMacro(OutlierFraction, double, 0.0, 1.0);
+  itkGetConstMacro(OutlierFraction, double);
+
+  /** Set/Get size of the coarsest texture features, in pixels. */
+  itkSetClampMacro(FeatureSize, double, 1.0, NumericTraits<double>::max());
+  itkGetConstMacro(FeatureSize, double);
+
+  /** Set/Get number of texture octaves, each having half the feature size
+   * and half the amplitude of the previous one. */
+  itkSetClampMacro(NumberOfOctaves, unsigned, 1, 16);
+  itkGetConstMacro(NumberOfOctaves, unsigned);
+
+  /** Set/Get intensity range of the texture, which spans [0, Amplitude]. */
+  itkSetMacro(Amplitude, double);
+  itkGetConstMacro(Amplitude, double);
+
+  /** Set/Get amplitude of the uniform per-pixel noise, which differs between tiles. */
+  itkSetMacro(NoiseAmplitude, double);
+  itkGetConstMacro(NoiseAmplitude, double);
+
+  /** Set/Get the seed determining the texture, jitter, outliers and noise. */
+  itkSetMacro(Seed, uint64_t);
+  itkGetConstMacro(Seed, uint64_t);
+
+  /** Total number of tiles. */
+  SizeValueType
+  GetLinearMontageSize() const;
+
+  /** Nominal position of the tile, in index space. */
+  PointType
+  GetStagePosition(SizeValueType linearIndex) const;
+
+  /** Position from which the tile's content is sampled, in index space. */
+  PointType
+  GetTruePosition(SizeValueType linearIndex) const;
+
+  /** Whether tile's content is unrelated to the mosaic. */
+  bool
+  IsOutlier(SizeValueType linearIndex) const;
+
+  /** Stage positions of all tiles. File names are left empty. */
+  TileConfigurationType
+  GetStageConfiguration() const;
+
+  /** True positions of all tiles. File names are left empty. */
+  TileConfigurationType
+  GetTrueConfiguration() const;
+
+  /** Produces the tile. If metadataOnly is true, pixel buffer is not allocated.
+   * Otherwise, only the part of the tile within the region is produced,
+   * unless the region is empty or outside of the tile. Thread safe. */
+  ImagePointer
+  GenerateTile(SizeValueType linearIndex, bool metadataOnly, const RegionType & region) const;
+
+  /** Returns a callable producing tiles via GenerateTile(). It keeps this generator alive. */
+  TileSourceType
+  GetTileSource() const;
+
+protected:
+  SyntheticMosaicGenerator();
+  ~SyntheticMosaicGenerator() override = default;
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  /** Salts, which make pseudorandom streams for different purposes independent. */
+  enum : uint64_t
+  {
+    TextureSalt = 1,
+    JitterSalt,
+    OutlierSalt,
+    NoiseSalt,
+    OutlierTextureSalt
+  };
+
+  /** Pseudorandom hash of a sequence of values (splitmix64 finalizer applied after each). */
+  static uint64_t
+  Hash(uint64_t seed, uint64_t value);
+
+  /** Maps a hash to [0, 1). */
+  static double
+  ToUnit(uint64_t hash);
+
+  /** Smoothly interpolated lattice noise, in [0, 1]. */
+  static double
+  ValueNoise(const ArrayType & position, uint64_t seed);
+
+  /** Texture of the mosaic at the position, in [0, 1]. */
+  double
+  Texture(const ArrayType & position, uint64_t seed) const;
+
+private:
+  TileIndexType m_MontageSize;
+  SizeType      m_TileSize;
+  ArrayType     m_Overlap;
+  ArrayType     m_Jitter;
+  double        m_OutlierFraction = 0.0;
+  double        m_FeatureSize = 16.0;
+  unsigned      m_NumberOfOctaves = 4;
+  double        m_Amplitude = 255.0;
+  double        m_NoiseAmplitude = 0.0;
+  uint64_t      m_Seed = 1983;
+};
+
+} // namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkSyntheticMosaicGenerator.hxx"
+#endif
+
+#endif // itkSyntheticMosaicGenerator_h
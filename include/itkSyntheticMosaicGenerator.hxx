@@ -0,0 +1,282 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkSyntheticMosaicGenerator_hxx
+#define itkSyntheticMosaicGenerator_hxx
+
+#include "itkSyntheticMosaicGenerator.h"
+
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkNumericTraits.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace itk
+{
+template <typename TImageType>
+SyntheticMosaicGenerator<TImageType>::SyntheticMosaicGenerator()
+{
+  m_MontageSize.Fill(2);
+  m_TileSize.Fill(64);
+  m_Overlap.Fill(0.1);
+  m_Jitter.Fill(2.0);
+}
+
+template <typename TImageType>
+void
+SyntheticMosaicGenerator<TImageType>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Montage Size: " << m_MontageSize << std::endl;
+  os << indent << "Tile Size: " << m_TileSize << std::endl;
+  os << indent << "Overlap: " << m_Overlap << std::endl;
+  os << indent << "Jitter: " << m_Jitter << std::endl;
+  os << indent << "Outlier Fraction: " << m_OutlierFraction << std::endl;
+  os << indent << "Feature Size: " << m_FeatureSize << std::endl;
+  os << indent << "Number Of Octaves: " << m_NumberOfOctaves << std::endl;
+  os << indent << "Amplitude: " << m_Amplitude << std::endl;
+  os << indent << "Noise Amplitude: " << m_NoiseAmplitude << std::endl;
+  os << indent << "Seed: " << m_Seed << std::endl;
+}
+
+template <typename TImageType>
+uint64_t
+SyntheticMosaicGenerator<TImageType>::Hash(uint64_t seed, uint64_t value)
+{
+  uint64_t z = seed + 0x9E3779B97F4A7C15ull * (value + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+template <typename TImageType>
+double
+SyntheticMosaicGenerator<TImageType>::ToUnit(uint64_t hash)
+{
+  return (hash >> 11) * (1.0 / 9007199254740992.0); // 53 bits of mantissa
+}
+
+template <typename TImageType>
+double
+SyntheticMosaicGenerator<TImageType>::ValueNoise(const ArrayType & position, uint64_t seed)
+{
+  IndexValueType cell[ImageDimension];
+  double         t[ImageDimension];
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    const double f = std::floor(position[d]);
+    cell[d] = static_cast<IndexValueType>(f);
+    const double x = position[d] - f;
+    t[d] = x * x * (3.0 - 2.0 * x); // smoothstep, for a continuous gradient
+  }
+
+  double sum = 0.0;
+  for (unsigned corner = 0; corner < (1u << ImageDimension); corner++)
+  {
+    uint64_t h = seed;
+    double   weight = 1.0;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      const unsigned bit = (corner >> d) & 1u;
+      h = Hash(h, static_cast<uint64_t>(cell[d] + bit));
+      weight *= bit ? t[d] : 1.0 - t[d];
+    }
+    sum += weight * ToUnit(h);
+  }
+  return sum;
+}
+
+template <typename TImageType>
+double
+SyntheticMosaicGenerator<TImageType>::Texture(const ArrayType & position, uint64_t seed) const
+{
+  double sum = 0.0;
+  double norm = 0.0;
+  double amplitude = 1.0;
+  double featureSize = m_FeatureSize;
+  for (unsigned o = 0; o < m_NumberOfOctaves; o++)
+  {
+    ArrayType p;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      p[d] = position[d] / featureSize;
+    }
+    sum += amplitude * ValueNoise(p, Hash(seed, o));
+    norm += amplitude;
+    amplitude *= 0.5;
+    featureSize = std::max(1.0, featureSize * 0.5);
+  }
+  return sum / norm;
+}
+
+template <typename TImageType>
+SizeValueType
+SyntheticMosaicGenerator<TImageType>::GetLinearMontageSize() const
+{
+  SizeValueType linearSize = 1u;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    linearSize *= m_MontageSize[d];
+  }
+  return linearSize;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::PointType
+SyntheticMosaicGenerator<TImageType>::GetStagePosition(SizeValueType linearIndex) const
+{
+  PointType position;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    const SizeValueType index = linearIndex % m_MontageSize[d];
+    linearIndex /= m_MontageSize[d];
+    position[d] = index * m_TileSize[d] * (1.0 - m_Overlap[d]);
+  }
+  return position;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::PointType
+SyntheticMosaicGenerator<TImageType>::GetTruePosition(SizeValueType linearIndex) const
+{
+  PointType      position = this->GetStagePosition(linearIndex);
+  const uint64_t tileSeed = Hash(Hash(m_Seed, JitterSalt), linearIndex);
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    position[d] += m_Jitter[d] * (2.0 * ToUnit(Hash(tileSeed, d)) - 1.0);
+  }
+  return position;
+}
+
+template <typename TImageType>
+bool
+SyntheticMosaicGenerator<TImageType>::IsOutlier(SizeValueType linearIndex) const
+{
+  return ToUnit(Hash(Hash(m_Seed, OutlierSalt), linearIndex)) < m_OutlierFraction;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::TileConfigurationType
+SyntheticMosaicGenerator<TImageType>::GetStageConfiguration() const
+{
+  TileConfigurationType configuration;
+  configuration.AxisSizes = m_MontageSize;
+  configuration.Tiles.resize(configuration.LinearSize());
+  for (SizeValueType i = 0; i < configuration.Tiles.size(); i++)
+  {
+    configuration.Tiles[i].Position = this->GetStagePosition(i);
+  }
+  return configuration;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::TileConfigurationType
+SyntheticMosaicGenerator<TImageType>::GetTrueConfiguration() const
+{
+  TileConfigurationType configuration;
+  configuration.AxisSizes = m_MontageSize;
+  configuration.Tiles.resize(configuration.LinearSize());
+  for (SizeValueType i = 0; i < configuration.Tiles.size(); i++)
+  {
+    configuration.Tiles[i].Position = this->GetTruePosition(i);
+  }
+  return configuration;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::ImagePointer
+SyntheticMosaicGenerator<TImageType>::GenerateTile(SizeValueType      linearIndex,
+                                                   bool               metadataOnly,
+                                                   const RegionType & region) const
+{
+  itkAssertOrThrowMacro(linearIndex < this->GetLinearMontageSize(),
+                        "Tile index " << linearIndex << " exceeds montage size " << m_MontageSize);
+  ImagePointer     image = ImageType::New();
+  const RegionType largest(m_TileSize);
+  image->SetLargestPossibleRegion(largest);
+  const PointType               stage = this->GetStagePosition(linearIndex);
+  typename ImageType::PointType origin;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    origin[d] = stage[d];
+  }
+  image->SetOrigin(origin);
+  if (metadataOnly)
+  {
+    return image;
+  }
+
+  RegionType buffered = largest;
+  if (region.GetNumberOfPixels() > 0)
+  {
+    buffered.Crop(region); // unchanged if there is no overlap
+  }
+  image->SetBufferedRegion(buffered);
+  image->SetRequestedRegion(buffered);
+  image->Allocate(false);
+
+  const PointType position = this->GetTruePosition(linearIndex);
+  const uint64_t  textureSeed =
+    this->IsOutlier(linearIndex) ? Hash(Hash(m_Seed, OutlierTextureSalt), linearIndex) : Hash(m_Seed, TextureSalt);
+  const uint64_t noiseSeed = Hash(Hash(m_Seed, NoiseSalt), linearIndex);
+  const double   minValue = NumericTraits<PixelType>::NonpositiveMin();
+  const double   maxValue = NumericTraits<PixelType>::max();
+
+  ImageRegionIteratorWithIndex<ImageType> it(image, buffered);
+  for (; !it.IsAtEnd(); ++it)
+  {
+    const IndexType ind = it.GetIndex();
+    ArrayType       p;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      p[d] = position[d] + ind[d];
+    }
+    double value = m_Amplitude * this->Texture(p, textureSeed);
+    if (m_NoiseAmplitude != 0.0)
+    {
+      uint64_t h = noiseSeed;
+      for (unsigned d = 0; d < ImageDimension; d++)
+      {
+        h = Hash(h, static_cast<uint64_t>(ind[d]));
+      }
+      value += m_NoiseAmplitude * (2.0 * ToUnit(h) - 1.0);
+    }
+    if (std::is_integral<PixelType>::value)
+    {
+      value = std::round(value);
+    }
+    it.Set(static_cast<PixelType>(std::min(maxValue, std::max(minValue, value))));
+  }
+  return image;
+}
+
+template <typename TImageType>
+typename SyntheticMosaicGenerator<TImageType>::TileSourceType
+SyntheticMosaicGenerator<TImageType>::GetTileSource() const
+{
+  ConstPointer self = this;
+  return [self](SizeValueType linearIndex, bool metadataOnly, const RegionType & region) {
+    return self->GenerateTile(linearIndex, metadataOnly, region);
+  };
+}
+
+} // namespace itk
+
+#endif // itkSyntheticMosaicGenerator_hxx
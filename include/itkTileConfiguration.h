@@ -22,12 +22,16 @@
 #include <string>
 #include <vector>
 
+#include "itkByteSwapper.h"
 #include "itkPoint.h"
 #include "itkSize.h"
 
 #include "double-conversion/double-conversion.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <limits>
 #include <sstream>
@@ -98,16 +102,40 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
     return ind;
   }
 
+  /** First bytes of a configuration in the binary format, see WriteBinary(). */
+  static constexpr char   BinaryMagic[] = "ITKTCFG1";
+  static constexpr size_t BinaryMagicSize = sizeof(BinaryMagic) - 1;
+
   // tries parsing the file, return first file name and set dimension
   static std::string
   TryParse(const std::string & pathToFile, unsigned & dimension)
   {
-    std::ifstream tileFile(pathToFile);
+    std::ifstream tileFile(pathToFile, std::ios::binary);
     if (!tileFile)
     {
       throw std::runtime_error("Could not open for reading: " + pathToFile);
     }
 
+    char magic[BinaryMagicSize] = {};
+    tileFile.read(magic, BinaryMagicSize);
+    if (tileFile && std::equal(magic, magic + BinaryMagicSize, BinaryMagic))
+    {
+      std::uint32_t dim = 0;
+      readBinary(tileFile, &dim, 1, pathToFile);
+      std::vector<std::uint64_t> axisSizes(dim);
+      readBinary(tileFile, axisSizes.data(), dim, pathToFile);
+      std::uint64_t linearSize = 1u;
+      for (std::uint64_t axisSize : axisSizes)
+      {
+        linearSize *= axisSize;
+      }
+      tileFile.seekg(linearSize * dim * sizeof(double), std::ios::cur); // skip positions
+      dimension = dim;
+      return readBinaryString(tileFile, pathToFile);
+    }
+    tileFile.clear();
+    tileFile.seekg(0);
+
     std::string temp = getNextNonCommentLine(tileFile);
     if (temp.substr(0, 6) == "dim = ")
     {
@@ -120,24 +148,33 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
     return tile.FileName;
   }
 
+  /** Reads a configuration in either the text or the binary format. */
   void
   Parse(const std::string & pathToFile)
   {
-    std::ifstream tileFile(pathToFile);
-    if (!tileFile)
+    // the whole file is read at once, and parsed in place
+    const std::string contents = readFile(pathToFile);
+    if (contents.compare(0, BinaryMagicSize, BinaryMagic) == 0)
     {
-      throw std::runtime_error("Could not open for reading: " + pathToFile);
+      this->ParseBinary(contents, pathToFile);
+      return;
     }
-    std::string line = getNextNonCommentLine(tileFile);
-    if (line.substr(0, 6) == "dim = ")
+
+    const char * pos = contents.data();
+    const char * end = pos + contents.size();
+    const char * lineBegin = nullptr;
+    const char * lineEnd = nullptr;
+    getNextNonCommentLine(pos, end, lineBegin, lineEnd);
+    if (std::string(lineBegin, lineEnd).substr(0, 6) == "dim = ")
     {
-      unsigned dim = std::stoul(line.substr(6));
+      const std::string line(lineBegin, lineEnd);
+      unsigned          dim = std::stoul(line.substr(6));
       if (dim != Dimension)
       {
         throw std::runtime_error("Expected dimension " + std::to_string(Dimension) + ", but got " +
                                  std::to_string(dim) + " from string:\n\n" + line);
       }
-      line = TileConfiguration<Dimension>::getNextNonCommentLine(tileFile); // get next line
+      getNextNonCommentLine(pos, end, lineBegin, lineEnd); // get next line
     }
 
     AxisSizes.Fill(1);
@@ -146,41 +183,49 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
     cInd.Fill(0);
     unsigned initializedDimensions = 0; // no dimension has been initialized
 
-    std::string          timePoint;
-    itk::Tile<Dimension> tile = parseLine(line, timePoint);
-    Tiles.push_back(tile);
-    line = getNextNonCommentLine(tileFile);
+    std::string timePoint;
+    Tiles.push_back(parseLine(lineBegin, lineEnd, timePoint));
 
-    while (tileFile)
+    while (getNextNonCommentLine(pos, end, lineBegin, lineEnd))
     {
-      tile = parseLine(line, timePoint);
-      // determine dominant axis change
-      unsigned maxAxis = 0; // (0=x, 1=y, 2=z etc)
-      double   maxDiff = tile.Position[0] - Tiles.back().Position[0];
-      for (unsigned d = 1; d < Dimension; d++)
+      itk::Tile<Dimension> tile = parseLine(lineBegin, lineEnd, timePoint);
+      unsigned             maxAxis = 0; // (0=x, 1=y, 2=z etc)
+      if (initializedDimensions + 1 < Dimension)
       {
-        double diff = tile.Position[d] - Tiles.back().Position[d];
-        if (diff > maxDiff)
+        // determine dominant axis change, until sizes along all but the slowest axis are known
+        double maxDiff = tile.Position[0] - Tiles.back().Position[0];
+        for (unsigned d = 1; d < Dimension; d++)
         {
-          maxDiff = diff;
-          maxAxis = d;
+          double diff = tile.Position[d] - Tiles.back().Position[d];
+          if (diff > maxDiff)
+          {
+            maxDiff = diff;
+            maxAxis = d;
+          }
         }
-      }
 
-      if (maxAxis > initializedDimensions) // we now know the size along this dimension
-      {
-        AxisSizes[maxAxis - 1] = cInd[maxAxis - 1] + 1;
-        initializedDimensions = maxAxis;
-      }
+        if (maxAxis > initializedDimensions) // we now know the size along this dimension
+        {
+          AxisSizes[maxAxis - 1] = cInd[maxAxis - 1] + 1;
+          initializedDimensions = maxAxis;
+        }
 
-      // check consistency with previously established size
-      for (unsigned d = 0; d < maxAxis; d++)
+        // check consistency with previously established size
+        for (unsigned d = 0; d < maxAxis; d++)
+        {
+          itkAssertOrThrowMacro(cInd[d] == AxisSizes[d] - 1,
+                                "Axis sizes: " << AxisSizes << " current index: " << cInd
+                                               << ". We have reached the end along axis " << maxAxis
+                                               << "\nIndex along axis " << d << " is " << cInd[d]
+                                               << ", but it should be " << AxisSizes[d] - 1);
+        }
+      }
+      else // the rest of the tiles follow in grid order, regardless of their positions
       {
-        itkAssertOrThrowMacro(cInd[d] == AxisSizes[d] - 1,
-                              "Axis sizes: " << AxisSizes << " current index: " << cInd
-                                             << ". We have reached the end along axis " << maxAxis
-                                             << "\nIndex along axis " << d << " is " << cInd[d] << ", but it should be "
-                                             << AxisSizes[d] - 1);
+        while (maxAxis + 1 < Dimension && cInd[maxAxis] + 1 == AxisSizes[maxAxis])
+        {
+          ++maxAxis;
+        }
       }
 
       // update current tile index
@@ -198,11 +243,10 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
                                              << ". Violation along axis " << maxAxis);
       }
 
-      Tiles.push_back(tile);
-      line = getNextNonCommentLine(tileFile);
+      Tiles.push_back(std::move(tile));
     }
 
-    for (unsigned d = 0; d < Dimension; ++d)
+    for (unsigned d = initializedDimensions; d < Dimension; ++d)
     {
       AxisSizes[d] = cInd[d] + 1;
     }
@@ -212,38 +256,95 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
                           "Incorrect number of tiles: " << Tiles.size() << ". Expected: " << expectedSize);
   }
 
+  /** Writes the configuration in the text format. */
   void
   Write(const std::string & pathToFile)
   {
-    std::ofstream tileFile(pathToFile);
+    std::ofstream tileFile(pathToFile, std::ios::binary);
     if (!tileFile)
     {
       throw std::runtime_error("Could not open for writing: " + pathToFile);
     }
 
-    tileFile << "# Tile coordinates are in index space, not physical space\n";
-    tileFile << "dim = " << Dimension << "\n\n";
+    // lines are accumulated in a buffer, which is written out in big blocks
+    constexpr size_t blockSize = 1u << 20;
+    std::string      block;
+    block.reserve(blockSize + 4096);
+    block += "# Tile coordinates are in index space, not physical space\n";
+    block += "dim = " + std::to_string(Dimension) + "\n\n";
     char                             buffer[25];
     double_conversion::StringBuilder conversionResult(buffer, 25);
 
     size_t totalTiles = this->LinearSize();
     for (SizeValueType linearIndex = 0; linearIndex < totalTiles; linearIndex++)
     {
-      tileFile << Tiles[linearIndex].FileName << ";;(";
+      block += Tiles[linearIndex].FileName;
+      block += ";;(";
 
       for (unsigned d = 0; d < Dimension; d++)
       {
         if (d > 0)
         {
-          tileFile << ", ";
+          block += ", ";
         }
 
         doubleConverter.ToShortest(Tiles[linearIndex].Position[d], &conversionResult);
-        tileFile << conversionResult.Finalize();
+        block += conversionResult.Finalize();
         conversionResult.Reset();
       }
-      tileFile << ')' << std::endl;
+      block += ")\n";
+
+      if (block.size() >= blockSize)
+      {
+        tileFile.write(block.data(), block.size());
+        block.clear();
+      }
+    }
+    tileFile.write(block.data(), block.size());
+    tileFile.close();
+
+    if (!tileFile)
+    {
+      throw std::runtime_error("Writing not successful to: " + pathToFile);
     }
+  }
+
+  /** Writes the configuration in a compact binary format, which Parse() recognizes.
+   * The format is little-endian: magic bytes "ITKTCFG1", uint32 dimension,
+   * uint64 axis sizes, float64 positions of all tiles (Dimension per tile),
+   * then file names of all tiles, each as uint32 length followed by the characters.
+   * Positions are stored exactly, and loaded with a single read. */
+  void
+  WriteBinary(const std::string & pathToFile)
+  {
+    std::ofstream tileFile(pathToFile, std::ios::binary);
+    if (!tileFile)
+    {
+      throw std::runtime_error("Could not open for writing: " + pathToFile);
+    }
+
+    const size_t  totalTiles = this->LinearSize();
+    std::uint32_t dim = Dimension;
+    tileFile.write(BinaryMagic, BinaryMagicSize);
+    writeBinary(tileFile, &dim, 1);
+    std::uint64_t axisSizes[Dimension];
+    std::copy(AxisSizes.begin(), AxisSizes.end(), axisSizes);
+    writeBinary(tileFile, axisSizes, Dimension);
+
+    std::vector<double> positions(totalTiles * Dimension);
+    for (size_t t = 0; t < totalTiles; t++)
+    {
+      std::copy(Tiles[t].Position.Begin(), Tiles[t].Position.End(), positions.begin() + t * Dimension);
+    }
+    writeBinary(tileFile, positions.data(), positions.size());
+
+    for (size_t t = 0; t < totalTiles; t++)
+    {
+      std::uint32_t length = static_cast<std::uint32_t>(Tiles[t].FileName.size());
+      writeBinary(tileFile, &length, 1);
+      tileFile.write(Tiles[t].FileName.data(), length);
+    }
+    tileFile.close();
 
     if (!tileFile)
     {
@@ -254,6 +355,118 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
   static double_conversion::StringToDoubleConverter stringConverter;
   static double_conversion::DoubleToStringConverter doubleConverter;
 
+  static std::string
+  readFile(const std::string & pathToFile)
+  {
+    std::ifstream file(pathToFile, std::ios::binary);
+    if (!file)
+    {
+      throw std::runtime_error("Could not open for reading: " + pathToFile);
+    }
+    file.seekg(0, std::ios::end);
+    std::string contents(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&contents[0], contents.size());
+    if (!file)
+    {
+      throw std::runtime_error("Reading not successful from: " + pathToFile);
+    }
+    return contents;
+  }
+
+  template <typename T>
+  static void
+  writeBinary(std::ostream & out, const T * values, size_t count)
+  {
+    std::vector<T> littleEndian(values, values + count);
+    ByteSwapper<T>::SwapRangeFromSystemToLittleEndian(littleEndian.data(), count);
+    out.write(reinterpret_cast<const char *>(littleEndian.data()), count * sizeof(T));
+  }
+
+  template <typename T>
+  static void
+  readBinary(std::istream & in, T * values, size_t count, const std::string & pathToFile)
+  {
+    in.read(reinterpret_cast<char *>(values), count * sizeof(T));
+    if (!in)
+    {
+      throw std::runtime_error("Unexpected end of binary tile configuration: " + pathToFile);
+    }
+    ByteSwapper<T>::SwapRangeFromSystemToLittleEndian(values, count);
+  }
+
+  // same as above, but from a buffer
+  template <typename T>
+  static void
+  readBinary(const char *& pos, const char * end, T * values, size_t count, const std::string & pathToFile)
+  {
+    if (static_cast<size_t>(end - pos) < count * sizeof(T))
+    {
+      throw std::runtime_error("Unexpected end of binary tile configuration: " + pathToFile);
+    }
+    std::memcpy(values, pos, count * sizeof(T));
+    pos += count * sizeof(T);
+    ByteSwapper<T>::SwapRangeFromSystemToLittleEndian(values, count);
+  }
+
+  static std::string
+  readBinaryString(std::istream & in, const std::string & pathToFile)
+  {
+    std::uint32_t length = 0;
+    readBinary(in, &length, 1, pathToFile);
+    std::string result(length, '\0');
+    in.read(&result[0], length);
+    if (!in)
+    {
+      throw std::runtime_error("Unexpected end of binary tile configuration: " + pathToFile);
+    }
+    return result;
+  }
+
+  void
+  ParseBinary(const std::string & contents, const std::string & pathToFile)
+  {
+    const char *  pos = contents.data() + BinaryMagicSize;
+    const char *  end = contents.data() + contents.size();
+    std::uint32_t dim = 0;
+    readBinary(pos, end, &dim, 1, pathToFile);
+    if (dim != Dimension)
+    {
+      throw std::runtime_error("Expected dimension " + std::to_string(Dimension) + ", but got " +
+                               std::to_string(dim) + " from binary tile configuration: " + pathToFile);
+    }
+    std::uint64_t axisSizes[Dimension];
+    readBinary(pos, end, axisSizes, Dimension, pathToFile);
+    std::copy(axisSizes, axisSizes + Dimension, AxisSizes.begin());
+
+    // checked one axis at a time, as the product of corrupted axis sizes could overflow
+    const size_t maxTiles = contents.size() / (Dimension * sizeof(double));
+    size_t       totalTiles = 1;
+    for (std::uint64_t axisSize : axisSizes)
+    {
+      if (axisSize != 0 && totalTiles > maxTiles / axisSize)
+      {
+        throw std::runtime_error("Axis sizes exceed the size of binary tile configuration: " + pathToFile);
+      }
+      totalTiles *= axisSize;
+    }
+    std::vector<double> positions(totalTiles * Dimension);
+    readBinary(pos, end, positions.data(), positions.size(), pathToFile);
+    Tiles.resize(totalTiles);
+    for (size_t t = 0; t < totalTiles; t++)
+    {
+      std::copy(positions.begin() + t * Dimension, positions.begin() + (t + 1) * Dimension, Tiles[t].Position.Begin());
+      std::uint32_t length = 0;
+      readBinary(pos, end, &length, 1, pathToFile);
+      if (static_cast<size_t>(end - pos) < length)
+      {
+        throw std::runtime_error("Unexpected end of binary tile configuration: " + pathToFile);
+      }
+      Tiles[t].FileName.assign(pos, length);
+      pos += length;
+    }
+  }
+
   static std::string
   getNextNonCommentLine(std::istream & in)
   {
@@ -277,41 +490,73 @@ struct ITK_TEMPLATE_EXPORT TileConfiguration
     return temp;
   }
 
+  // same as above, but on a buffer. Returns false if there are no more lines.
+  static bool
+  getNextNonCommentLine(const char *& pos, const char * end, const char *& lineBegin, const char *& lineEnd)
+  {
+    while (pos < end)
+    {
+      lineBegin = pos;
+      lineEnd = std::find(pos, end, '\n');
+      pos = lineEnd < end ? lineEnd + 1 : end;
+      if (lineEnd > lineBegin && lineEnd[-1] == '\r')
+      {
+        --lineEnd; // line ending in CRLF
+      }
+      if (lineEnd > lineBegin && lineBegin[0] != '#')
+      {
+        return true; // this line has interesting content
+      }
+    }
+    lineBegin = end;
+    lineEnd = end;
+    return false;
+  }
+
   static Tile<Dimension>
   parseLine(const std::string line, std::string & timePointID)
+  {
+    return parseLine(line.data(), line.data() + line.size(), timePointID);
+  }
+
+  static Tile<Dimension>
+  parseLine(const char * begin, const char * end, std::string & timePointID)
   {
     itk::Tile<Dimension> tile;
-    std::stringstream    ss(line);
-    std::string          temp;
 
-    std::getline(ss, temp, ';');
-    tile.FileName = temp;
-    std::getline(ss, temp, ';');
+    const char * fileNameEnd = std::find(begin, end, ';');
+    tile.FileName.assign(begin, fileNameEnd);
+    const char * timePointBegin = std::min(fileNameEnd + 1, end);
+    const char * timePointEnd = std::find(timePointBegin, end, ';');
+    const size_t timePointLength = timePointEnd - timePointBegin;
     if (timePointID.empty())
     {
-      timePointID = temp;
+      timePointID.assign(timePointBegin, timePointEnd);
     }
     else
     {
-      itkAssertOrThrowMacro(temp == timePointID,
-                            "Only a single time point is supported. " << timePointID << " != " << temp);
+      itkAssertOrThrowMacro(timePointID.compare(0, std::string::npos, timePointBegin, timePointLength) == 0,
+                            "Only a single time point is supported. "
+                              << timePointID << " != " << std::string(timePointBegin, timePointEnd));
     }
-    std::getline(ss, temp, '(');
+    const char * pos = std::find(timePointEnd, end, '(');
+    pos = std::min(pos + 1, end);
 
-    using PointTypelocal = itk::Point<double, Dimension>;
-    PointTypelocal p;
     for (unsigned d = 0; d < Dimension; d++)
     {
-      std::getline(ss, temp, ',');
-      int processed = 0;
-      p[d] = stringConverter.StringToDouble(temp.c_str(), temp.length(), &processed);
+      const char * coordinateEnd = std::find(pos, end, ',');
+      int          processed = 0;
+      tile.Position[d] = stringConverter.StringToDouble(pos, static_cast<int>(coordinateEnd - pos), &processed);
+      pos = std::min(coordinateEnd + 1, end);
     }
-    tile.Position = p;
 
     return tile;
   }
 };
 
+template <unsigned Dimension>
+constexpr char TileConfiguration<Dimension>::BinaryMagic[];
+
 template <unsigned Dimension>
 double_conversion::StringToDoubleConverter TileConfiguration<Dimension>::stringConverter(
   double_conversion::StringToDoubleConverter::ALLOW_TRAILING_JUNK |
@@ -39,6 +39,15 @@ namespace itk
  * For example, char's default accumulation type is short,
  * but int might be preferred for montages with large overlaps of input tiles.
  *
+ * Besides the usual pipeline output, the composite image can be written
+ * as a multi-resolution pyramid in a single streaming pass over the tiles,
+ * see WriteMultiResolutionPyramid().
+ *
+ * When the output is streamed along the slowest dimension (e.g. by ImageFileWriter
+ * with several stream divisions), each tile is read once: the first request which needs
+ * a tile reads all of the tile's part needed by the rest of the write, and the tile is
+ * kept across requests until the write moves past it.
+ *
  * \author Dženan Zukić, dzenan.zukic@kitware.com
  *
  * \ingroup Montage
@@ -137,6 +146,7 @@ public:
     Superclass::SetInputTile(linearIndex, reinterpret_cast<typename Superclass::ImageType *>(image));
     m_Transforms[linearIndex] = nullptr;
     m_Tiles[linearIndex] = nullptr;
+    m_PreprocessedTiles[linearIndex] = nullptr;
   }
   void
   SetInputTile(SizeValueType linearIndex, const std::string & imageFilename)
@@ -144,6 +154,7 @@ public:
     Superclass::SetInputTile(linearIndex, imageFilename);
     m_Transforms[linearIndex] = nullptr;
     m_Tiles[linearIndex] = nullptr;
+    m_PreprocessedTiles[linearIndex] = nullptr;
   }
   void
   SetInputTile(TileIndexType position, ImageType * image)
@@ -156,6 +167,30 @@ public:
     this->SetInputTile(this->nDIndexToLinearIndex(position), imageFilename);
   }
 
+  /** Per-tile preprocessing, invoked with a whole tile and its linear index.
+   * This hides TileMontage's preprocessor, because this filter's ImageType
+   * can have multi-component pixels. It is invoked at most once per tile
+   * during an update or a streamed write, by the threads which resample the tiles.
+   * The same restrictions as in TileMontage::SetTilePreprocessor() apply. */
+  using TilePreprocessorType = std::function<ImagePointer(ImageType * tile, SizeValueType linearIndex)>;
+  void
+  SetTilePreprocessor(const TilePreprocessorType & preprocessor)
+  {
+    m_TilePreprocessor = preprocessor;
+    this->Modified();
+  }
+  const TilePreprocessorType &
+  GetTilePreprocessor() const
+  {
+    return m_TilePreprocessor;
+  }
+
+  /** Predicts peak memory usage of Update(): the output buffer, and tiles
+   * read from files or preprocessed, which are kept until merging finishes.
+   * Tiles and their transforms must be set. */
+  MontageInstrumentation::MemoryBytes
+  EstimatePeakMemoryUsage() override;
+
   /** Input tiles' transforms, as calculated by \sa{Montage}.
    * To be called for each tile position in the mosaic
    * before the call to Update(). */
@@ -176,6 +211,47 @@ public:
   itkGetMacro(CropToFill, bool);
   itkBooleanMacro(CropToFill);
 
+  /** Streams the composite image in slabs along the slowest dimension,
+   * and writes it as a multi-resolution pyramid with one file per level,
+   * named filePrefix + level + ".mha". Level 0 has full resolution,
+   * and each coarser level halves the size along every dimension
+   * by averaging blocks of 2^ImageDimension pixels of the previous level.
+   *
+   * Each slab is reduced to all the coarser levels while it is still in memory,
+   * and pasted into the level files. This way the input tiles are read once,
+   * and the written data is only slightly larger than the full resolution image.
+   *
+   * Slab thickness is rounded up to a multiple of 2^(numberOfLevels-1).
+   * Zero (the default) means the size of the first tile along the slowest dimension.
+   * Levels of odd sizes end with partial blocks, which average the pixels they have.
+   * After this call, the output's data is released and its requested region is reset,
+   * so a later Update() generates the whole image. */
+  void
+  WriteMultiResolutionPyramid(const std::string & filePrefix,
+                              unsigned            numberOfLevels,
+                              SizeValueType       slabThickness = 0);
+
+  /** Streams the composite image in slabs along the slowest dimension,
+   * and writes it as a gzip-compressed NRRD file.
+   *
+   * Each slab is split into chunks which are compressed in parallel,
+   * and written while the next slab is being merged (see ParallelGzipWriter).
+   * This way the total time is close to the longer of merging and compression,
+   * instead of their sum. Two slabs are held in memory at the same time.
+   *
+   * Zero slab thickness (the default) means the size of the first tile along the slowest dimension.
+   * After this call, the output image's data is released. */
+  void
+  WriteCompressedNrrd(const std::string & fileName, SizeValueType slabThickness = 0);
+
+  /** Whether WriteCompressedNrrd() supports the pixel's component type.
+   * If not, the output can still be written by ImageFileWriter. */
+  static bool
+  CanWriteCompressedNrrd()
+  {
+    return !GetNrrdComponentType().empty();
+  }
+
 protected:
   TileMergeImageFilter();
   ~TileMergeImageFilter() override = default;
@@ -200,7 +276,8 @@ protected:
 
   /** If not already read, reads the image into memory.
    * Only the part which overlaps output image's requested region is read.
-   * If size of the wantedRegion is zero, only reads metadata. */
+   * If size of the wantedRegion is zero, only reads metadata.
+   * If tile preprocessor is set, the whole tile is read and preprocessed. */
   ImageConstPointer
   GetImage(TileIndexType nDIndex, RegionType wantedRegion);
 
@@ -229,10 +306,41 @@ protected:
   void
   ResampleSingleRegion(SizeValueType regionIndex);
 
+  /** Averages buffered region of the input in blocks of 2^ImageDimension pixels into the output.
+   * Output's largest possible region needs to be set, its buffered region is computed here.
+   * Blocks which stick out of the input's buffered region average only the pixels inside of it.
+   * Each input pixel averages inputFactor^ImageDimension pixels of an image of fullSize,
+   * or fewer at its far edges, and is weighted accordingly, so every level is the plain average
+   * of the full resolution pixels it covers, rounded for integer pixel types. */
+  void
+  DownsampleByTwo(const ImageType * input, ImageType * output, SizeValueType inputFactor, const SizeType & fullSize);
+
+  /** Region of the tile with tileRegion as its largest possible region which is read
+   * for the current request. It is the part of the tile needed by the rest of a streamed write,
+   * assumed to proceed along the slowest dimension, expanded to include the wantedRegion. */
+  RegionType
+  GetTileReadRegion(SizeValueType linearIndex, const RegionType & tileRegion, const RegionType & wantedRegion);
+
+  /** Size of the first input tile along the slowest dimension. */
+  SizeValueType
+  GetFirstTileThickness();
+
+  /** NRRD name of the pixel's component type, empty if NRRD has none. */
+  static std::string
+  GetNrrdComponentType();
+
+  /** Header of an attached, gzip-encoded NRRD file holding the image's largest possible region.
+   * Kinds of multi-component pixels are colors only for RGB and RGBA pixels. */
+  static std::string
+  GetNrrdHeader(const ImageType * image);
+
 private:
   bool      m_CropToFill = false;       // crop to avoid background filling?
   PixelType m_Background = PixelType(); // default background value (not covered by any input tile)
 
+  TilePreprocessorType      m_TilePreprocessor;
+  std::vector<ImagePointer> m_PreprocessedTiles; // kept until the end of GenerateData()
+
   std::vector<TransformConstPointer> m_Transforms;
   std::vector<ImagePointer>         m_Tiles; // metadata/image storage (if filenames are given instead of actual images)
   typename Superclass::ConstPointer m_Montage;
@@ -21,12 +21,24 @@
 
 #include "itkTileMergeImageFilter.h"
 
+#include "itkByteSwapper.h"
+#include "itkDefaultConvertPixelTraits.h"
+#include "itkImageIOFactory.h"
+#include "itkImageIORegion.h"
+#include "itkMontageNUMA.h"
 #include "itkMultiThreaderBase.h"
+#include "itkParallelGzipWriter.h"
+#include "itkRGBAPixel.h"
+#include "itkRGBPixel.h"
+#include "itksys/SystemTools.hxx"
 
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <functional>
+#include <sstream>
+#include <type_traits>
+#include <typeinfo>
 
 namespace itk
 {
@@ -56,6 +68,7 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::PrintSelf
     return im.IsNotNull() && im->GetBufferedRegion().GetNumberOfPixels() > 0;
   });
   os << indent << "InputTiles (filled/capacity): " << fullCount << "/" << m_Tiles.size() << std::endl;
+  os << indent << "TilePreprocessor: " << (m_TilePreprocessor ? "set" : "none") << std::endl;
 
   os << indent << "Montage: " << m_Montage.GetPointer() << std::endl;
 }
@@ -71,6 +84,7 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::SetMontag
     this->m_FinishedPairs.store(montage->m_FinishedPairs);
     this->m_OriginAdjustment = montage->m_OriginAdjustment;
     this->m_ForcedSpacing = montage->m_ForcedSpacing;
+    this->m_TileSource = montage->m_TileSource;
 
     for (SizeValueType i = 0; i < this->m_LinearMontageSize; i++)
     {
@@ -130,6 +144,7 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::SetMontag
   Superclass::SetMontageSize(montageSize);
   m_Transforms.resize(this->m_LinearMontageSize);
   m_Tiles.resize(this->m_LinearMontageSize);
+  m_PreprocessedTiles.resize(this->m_LinearMontageSize);
   this->SetNumberOfRequiredOutputs(1);
 }
 
@@ -237,23 +252,104 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GetImage(
 {
   SizeValueType linearIndex = this->nDIndexToLinearIndex(nDIndex);
 
-  ImagePointer                outputImage = this->GetOutput();
-  RegionType                  reqR = outputImage->GetRequestedRegion();
   std::lock_guard<std::mutex> lockGuard(this->m_TileReadLocks[linearIndex]);
+  bool                        onlyMetadata = (wantedRegion.GetNumberOfPixels() == 0);
+  if (m_TilePreprocessor && !onlyMetadata)
+  {
+    // preprocessing might need the whole tile, e.g. filters with a neighborhood
+    if (m_PreprocessedTiles[linearIndex].IsNull())
+    {
+      RegionType   reg0;
+      ImagePointer image = Superclass::template GetImageHelper<ImageType>(nDIndex, false, reg0);
+      MontageInstrumentation::ScopedStageTimer timer(this->GetInstrumentation(),
+                                                     MontageInstrumentation::StageEnum::TilePreprocessing);
+      m_PreprocessedTiles[linearIndex] = m_TilePreprocessor(image, linearIndex);
+      itkAssertOrThrowMacro(m_PreprocessedTiles[linearIndex].IsNotNull(), "Tile preprocessor returned a null image");
+      if (this->GetInstrumentation())
+      {
+        this->GetInstrumentation()->AddMemory(
+          MontageInstrumentation::MemoryCategoryEnum::Tiles,
+          MontageInstrumentation::GetBufferBytes(m_PreprocessedTiles[linearIndex].GetPointer()));
+      }
+    }
+    return m_PreprocessedTiles[linearIndex];
+  }
+
   if (m_Tiles[linearIndex].IsNotNull())
   {
-    RegionType r = m_Tiles[linearIndex]->GetBufferedRegion();
-    if (r.Crop(reqR) && r.IsInside(wantedRegion))
+    if (onlyMetadata || m_Tiles[linearIndex]->GetBufferedRegion().IsInside(wantedRegion))
     {
+      if (this->GetInstrumentation())
+      {
+        this->GetInstrumentation()->Increment(MontageInstrumentation::CounterEnum::TileCacheHits);
+      }
       return m_Tiles[linearIndex];
     }
   }
 
-  bool onlyMetadata = (wantedRegion.GetNumberOfPixels() == 0);
-  m_Tiles[linearIndex] = Superclass::template GetImageHelper<ImageType>(nDIndex, onlyMetadata, reqR);
+  // read all of the tile which the rest of a streamed write needs, not only this request's part
+  RegionType readRegion = wantedRegion;
+  if (!onlyMetadata && linearIndex < m_InputMappings.size())
+  {
+    if (m_Tiles[linearIndex].IsNull())
+    {
+      RegionType reg0;
+      m_Tiles[linearIndex] = Superclass::template GetImageHelper<ImageType>(nDIndex, true, reg0);
+    }
+    readRegion = this->GetTileReadRegion(linearIndex, m_Tiles[linearIndex]->GetLargestPossibleRegion(), wantedRegion);
+  }
+
+  const bool ownedBuffer = this->GetInstrumentation() && this->IsTileOwned(linearIndex);
+  if (ownedBuffer)
+  {
+    this->GetInstrumentation()->RemoveMemory(MontageInstrumentation::MemoryCategoryEnum::Tiles,
+                                             MontageInstrumentation::GetBufferBytes(m_Tiles[linearIndex].GetPointer()));
+  }
+  m_Tiles[linearIndex] = Superclass::template GetImageHelper<ImageType>(nDIndex, onlyMetadata, readRegion);
+  if (ownedBuffer)
+  {
+    this->GetInstrumentation()->AddMemory(MontageInstrumentation::MemoryCategoryEnum::Tiles,
+                                          MontageInstrumentation::GetBufferBytes(m_Tiles[linearIndex].GetPointer()));
+  }
   return m_Tiles[linearIndex];
 }
 
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+typename TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::RegionType
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GetTileReadRegion(
+  SizeValueType      linearIndex,
+  const RegionType & tileRegion,
+  const RegionType & wantedRegion)
+{
+  // streamed writes proceed along the slowest dimension,
+  // so the rest of the write spans from this request to the end of the output
+  constexpr unsigned slowest = ImageDimension - 1;
+  const RegionType   largest = this->GetOutput()->GetLargestPossibleRegion();
+  RegionType         remaining = this->GetOutput()->GetRequestedRegion();
+  remaining.SetSize(slowest, largest.GetIndex(slowest) + largest.GetSize(slowest) - remaining.GetIndex(slowest));
+
+  // into tile's index space, with a margin for interpolation
+  const OffsetType outputToTile = tileRegion.GetIndex() - m_InputMappings[linearIndex].GetIndex();
+  remaining.SetIndex(remaining.GetIndex() + outputToTile);
+  remaining.PadByRadius(1);
+  if (!remaining.Crop(tileRegion))
+  {
+    return wantedRegion;
+  }
+
+  // make sure the wanted region is included
+  ImageIndexType start = remaining.GetIndex();
+  ImageIndexType end = remaining.GetUpperIndex();
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    start[d] = std::min(start[d], wantedRegion.GetIndex(d));
+    end[d] = std::max(end[d], wantedRegion.GetUpperIndex()[d]);
+  }
+  remaining.SetIndex(start);
+  remaining.SetUpperIndex(end);
+  return remaining;
+}
+
 template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
 void
 TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GenerateOutputInformation()
@@ -371,6 +467,11 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GenerateD
   RegionType   reqR = outputImage->GetRequestedRegion();
   outputImage->SetBufferedRegion(reqR);
   outputImage->Allocate(false);
+  if (this->GetInstrumentation())
+  {
+    this->GetInstrumentation()->SetMemoryInUse(MontageInstrumentation::MemoryCategoryEnum::MergeOutput,
+                                               MontageInstrumentation::GetBufferBytes(outputImage.GetPointer()));
+  }
 
   // for debugging purposes, just color the regions by their contributing tiles
   // to make sure that the regions have been generated correctly without cracks
@@ -411,18 +512,65 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GenerateD
   MultiThreaderBase::ArrayThreadingFunctorType tf = std::bind(&Self::ResampleSingleRegion, this, std::placeholders::_1);
   mt->ParallelizeArray(0, m_Regions.size(), tf, this);
 
-  // release data from input tiles
-  RegionType reg0;
+  // release data from input tiles, except those which later requests of a streamed write need.
+  // Streamed writes proceed along the slowest dimension, so those are the tiles which extend past this request.
+  // If the next request is elsewhere, the kept tiles are replaced when they do not cover it.
+  constexpr unsigned   slowest = ImageDimension - 1;
+  const RegionType     largest = outputImage->GetLargestPossibleRegion();
+  const IndexValueType requestEnd = reqR.GetIndex(slowest) + reqR.GetSize(slowest);
+  const bool           lastRequest = requestEnd >= largest.GetIndex(slowest) + IndexValueType(largest.GetSize(slowest));
+  RegionType           reg0;
   for (SizeValueType i = 0; i < this->m_LinearMontageSize; i++)
   {
+    const RegionType & mapping = m_InputMappings[i];
+    if (!lastRequest && mapping.GetIndex(slowest) + IndexValueType(mapping.GetSize(slowest)) > requestEnd)
+    {
+      continue;
+    }
+    if (this->GetInstrumentation())
+    {
+      SizeValueType bytes = MontageInstrumentation::GetBufferBytes(m_PreprocessedTiles[i].GetPointer());
+      if (this->IsTileOwned(i))
+      {
+        bytes += MontageInstrumentation::GetBufferBytes(m_Tiles[i].GetPointer());
+      }
+      this->GetInstrumentation()->RemoveMemory(MontageInstrumentation::MemoryCategoryEnum::Tiles, bytes);
+    }
     if (m_Tiles[i])
     {
+      // a new empty container frees the buffer (shrinking would keep its capacity),
+      // and leaves the buffer of an input image, which this tile might share, intact
       m_Tiles[i]->SetBufferedRegion(reg0);
-      m_Tiles[i]->Allocate(false);
+      m_Tiles[i]->SetPixelContainer(ImageType::PixelContainer::New());
     }
+    m_PreprocessedTiles[i] = nullptr;
   }
 }
 
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+MontageInstrumentation::MemoryBytes
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::EstimatePeakMemoryUsage()
+{
+  using MemoryCategoryEnum = MontageInstrumentation::MemoryCategoryEnum;
+  MontageInstrumentation::MemoryBytes estimate{};
+
+  this->UpdateOutputInformation();
+  const RegionType outputRegion = this->GetOutput()->GetLargestPossibleRegion();
+  estimate[static_cast<unsigned>(MemoryCategoryEnum::MergeOutput)] =
+    outputRegion.GetNumberOfPixels() * sizeof(PixelType);
+
+  // in the worst case, every tile is needed in whole
+  if (m_TilePreprocessor || this->IsTileOwned(0))
+  {
+    TileIndexType     nDIndex0 = { 0 };
+    RegionType        reg0;
+    ImageConstPointer input0 = this->GetImage(nDIndex0, reg0);
+    estimate[static_cast<unsigned>(MemoryCategoryEnum::Tiles)] =
+      this->m_LinearMontageSize * input0->GetLargestPossibleRegion().GetNumberOfPixels() * sizeof(PixelType);
+  }
+  return estimate;
+}
+
 template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
 void
 TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::ResampleSingleRegion(SizeValueType i)
@@ -435,6 +583,11 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::ResampleS
   {
     return; // nothing to do
   }
+
+  // output pixels of the region, and tile buffers read for it, are first touched on the node of its first tile
+  const int node = m_RegionContributors[i].empty() ? -1 : this->GetTileNode(*m_RegionContributors[i].begin());
+  MontageNUMA::ScopedNodeAffinity affinity(node);
+  MontageInstrumentation::ScopedStageTimer timer(this->GetInstrumentation(), MontageInstrumentation::StageEnum::Merge);
   ImageRegionIteratorWithIndex<ImageType> oIt(outputImage, currentRegion);
   if (m_RegionContributors[i].empty()) // not covered by any tile
   {
@@ -578,6 +731,347 @@ TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::ResampleS
   }
 }
 
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+void
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::DownsampleByTwo(const ImageType * input,
+                                                                                       ImageType *       output,
+                                                                                       SizeValueType     inputFactor,
+                                                                                       const SizeType &  fullSize)
+{
+  const RegionType inRegion = input->GetBufferedRegion();
+  RegionType       outRegion;
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    IndexValueType start = inRegion.GetIndex(d) / 2;
+    IndexValueType end = (inRegion.GetIndex(d) + IndexValueType(inRegion.GetSize(d)) + 1) / 2;
+    outRegion.SetIndex(d, start);
+    outRegion.SetSize(d, end - start);
+  }
+  assert(output->GetLargestPossibleRegion().IsInside(outRegion));
+  output->SetBufferedRegion(outRegion);
+  output->Allocate(false); // reuses the buffer of the previous slab if it is big enough
+
+  // weighted by the fraction of full resolution pixels each input pixel covers, which is less than one
+  // for input pixels which are themselves averages of partial blocks at the far edges of odd sizes
+  using RealSumType = typename NumericTraits<TPixelAccumulateType>::RealType;
+  using RealConvertType = DefaultConvertPixelTraits<RealSumType>;
+  using PixelConvertType = DefaultConvertPixelTraits<PixelType>;
+  using ComponentType = typename PixelConvertType::ComponentType;
+  constexpr unsigned blockSize = 1u << ImageDimension;
+  const RealSumType  zeroSum = NumericTraits<RealSumType>::ZeroValue();
+  this->GetMultiThreader()->template ParallelizeImageRegion<ImageDimension>(
+    outRegion,
+    [&](const RegionType & region) {
+      ImageRegionIteratorWithIndex<ImageType> oIt(output, region);
+      for (; !oIt.IsAtEnd(); ++oIt)
+      {
+        const ImageIndexType outIndex = oIt.GetIndex();
+        RealSumType          sum = zeroSum;
+        double               weights = 0.0;
+        for (unsigned n = 0; n < blockSize; n++)
+        {
+          ImageIndexType inIndex;
+          for (unsigned d = 0; d < ImageDimension; d++)
+          {
+            inIndex[d] = 2 * outIndex[d] + ((n >> d) & 1u);
+          }
+          if (inRegion.IsInside(inIndex))
+          {
+            double weight = 1.0;
+            for (unsigned d = 0; d < ImageDimension; d++)
+            {
+              const SizeValueType covered = fullSize[d] - SizeValueType(inIndex[d]) * inputFactor;
+              weight *= double(std::min(covered, inputFactor)) / inputFactor;
+            }
+            sum += RealSumType(input->GetPixel(inIndex)) * weight;
+            weights += weight;
+          }
+        }
+        sum /= weights;
+        PixelType pixel;
+        for (unsigned c = 0; c < NumericTraits<RealSumType>::GetLength(sum); c++)
+        {
+          const double component = RealConvertType::GetNthComponent(c, sum);
+          // rounded, as truncation would darken integer pixels a little more at every level
+          PixelConvertType::SetNthComponent(
+            c, pixel, ComponentType(NumericTraits<ComponentType>::is_integer ? std::round(component) : component));
+        }
+        oIt.Set(pixel);
+      }
+    },
+    nullptr);
+}
+
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+SizeValueType
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GetFirstTileThickness()
+{
+  TileIndexType nDIndex0 = { 0 };
+  RegionType    reg0;
+  return this->GetImage(nDIndex0, reg0)->GetLargestPossibleRegion().GetSize(ImageDimension - 1);
+}
+
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+void
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::WriteMultiResolutionPyramid(
+  const std::string & filePrefix,
+  unsigned            numberOfLevels,
+  SizeValueType       slabThickness)
+{
+  itkAssertOrThrowMacro(numberOfLevels > 0, "At least one pyramid level is required");
+  itkAssertOrThrowMacro(numberOfLevels <= 8 * sizeof(IndexValueType) - 2, "Too many pyramid levels requested");
+
+  this->UpdateOutputInformation();
+  ImagePointer       outputImage = this->GetOutput();
+  const RegionType   fullRegion = outputImage->GetLargestPossibleRegion();
+  constexpr unsigned slowest = ImageDimension - 1;
+
+  const SizeValueType alignment = SizeValueType(1) << (numberOfLevels - 1);
+  if (slabThickness == 0)
+  {
+    slabThickness = this->GetFirstTileThickness();
+  }
+  slabThickness = (slabThickness + alignment - 1) / alignment * alignment;
+
+  // each level image has metadata of the entire level, but buffers only the current slab
+  using ContinuousIndexD = ContinuousIndex<double, ImageDimension>;
+  std::vector<ImagePointer>         levels(numberOfLevels);
+  std::vector<ImageIOBase::Pointer> levelIOs(numberOfLevels);
+  for (unsigned l = 0; l < numberOfLevels; l++)
+  {
+    const SizeValueType factor = SizeValueType(1) << l;
+    RegionType          levelRegion; // zero index
+    SpacingType         spacing = outputImage->GetSpacing();
+    ContinuousIndexD    firstPixelCenter;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      levelRegion.SetSize(d, (fullRegion.GetSize(d) + factor - 1) / factor);
+      spacing[d] *= factor;
+      firstPixelCenter[d] = fullRegion.GetIndex(d) + 0.5 * (factor - 1);
+    }
+    PointType origin;
+    outputImage->TransformContinuousIndexToPhysicalPoint(firstPixelCenter, origin);
+
+    levels[l] = ImageType::New();
+    levels[l]->SetLargestPossibleRegion(levelRegion);
+    levels[l]->SetOrigin(origin);
+    levels[l]->SetSpacing(spacing);
+    levels[l]->SetDirection(outputImage->GetDirection());
+
+    // ImageFileWriter would make a source-less image span only its buffer,
+    // so the slabs are pasted using ImageIO directly
+    std::string fileName = filePrefix + std::to_string(l) + ".mha";
+    itksys::SystemTools::RemoveFile(fileName); // pasting into a stale file would keep its header
+    levelIOs[l] = ImageIOFactory::CreateImageIO(fileName.c_str(), IOFileModeEnum::WriteMode);
+    if (levelIOs[l].IsNull())
+    {
+      itkExceptionMacro("Could not create ImageIO for writing pyramid level " << l << " into " << fileName);
+    }
+    levelIOs[l]->SetFileName(fileName);
+    levelIOs[l]->SetUseCompression(false); // compressed files cannot be pasted into
+    levelIOs[l]->SetNumberOfDimensions(ImageDimension);
+    levelIOs[l]->SetPixelTypeInfo(static_cast<const PixelType *>(nullptr));
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      levelIOs[l]->SetDimensions(d, levelRegion.GetSize(d));
+      levelIOs[l]->SetSpacing(d, spacing[d]);
+      levelIOs[l]->SetOrigin(d, origin[d]);
+      std::vector<double> axisDirection(ImageDimension);
+      for (unsigned i = 0; i < ImageDimension; i++)
+      {
+        axisDirection[i] = outputImage->GetDirection()[i][d];
+      }
+      levelIOs[l]->SetDirection(d, axisDirection);
+    }
+  }
+
+  const IndexValueType fullThickness = fullRegion.GetSize(slowest);
+  for (IndexValueType z = 0; z < fullThickness; z += slabThickness)
+  {
+    RegionType slab = fullRegion;
+    slab.SetIndex(slowest, fullRegion.GetIndex(slowest) + z);
+    slab.SetSize(slowest, std::min<SizeValueType>(slabThickness, fullThickness - z));
+    outputImage->SetRequestedRegion(slab);
+    outputImage->PropagateRequestedRegion();
+    outputImage->UpdateOutputData();
+
+    // level 0 shares the output's buffer
+    ImageIndexType levelSlabIndex;
+    levelSlabIndex.Fill(0);
+    levelSlabIndex[slowest] = z;
+    levels[0]->SetBufferedRegion(RegionType(levelSlabIndex, slab.GetSize()));
+    levels[0]->SetPixelContainer(outputImage->GetPixelContainer());
+
+    for (unsigned l = 0; l < numberOfLevels; l++)
+    {
+      if (l > 0)
+      {
+        this->DownsampleByTwo(levels[l - 1], levels[l], SizeValueType(1) << (l - 1), fullRegion.GetSize());
+      }
+      ImageIORegion ioRegion(ImageDimension);
+      ImageIORegionAdaptor<ImageDimension>::Convert(
+        levels[l]->GetBufferedRegion(), ioRegion, levels[l]->GetLargestPossibleRegion().GetIndex());
+      levelIOs[l]->SetIORegion(ioRegion);
+      levelIOs[l]->Write(levels[l]->GetBufferPointer());
+    }
+  }
+
+  // the output holds just the last slab, so a later Update() has to generate the whole image
+  outputImage->ReleaseData();
+  outputImage->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+std::string
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GetNrrdComponentType()
+{
+  using ComponentType = typename PixelTraits<PixelType>::ValueType;
+  switch (ImageIOBase::MapPixelType<ComponentType>::CType)
+  {
+    case IOComponentEnum::UCHAR:
+      return "uint8";
+    case IOComponentEnum::CHAR:
+      return "int8";
+    case IOComponentEnum::USHORT:
+      return "uint16";
+    case IOComponentEnum::SHORT:
+      return "int16";
+    case IOComponentEnum::UINT:
+      return "uint32";
+    case IOComponentEnum::INT:
+      return "int32";
+    case IOComponentEnum::ULONG:
+    case IOComponentEnum::ULONGLONG:
+      return sizeof(ComponentType) == 8 ? "uint64" : "uint32";
+    case IOComponentEnum::LONG:
+    case IOComponentEnum::LONGLONG:
+      return sizeof(ComponentType) == 8 ? "int64" : "int32";
+    case IOComponentEnum::FLOAT:
+      return "float";
+    case IOComponentEnum::DOUBLE:
+      return "double";
+    default:
+      return std::string();
+  }
+}
+
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+std::string
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::GetNrrdHeader(const ImageType * image)
+{
+  using ComponentType = typename PixelTraits<PixelType>::ValueType;
+  constexpr unsigned numberOfComponents = PixelTraits<PixelType>::Dimension;
+
+  const std::string type = GetNrrdComponentType();
+  if (type.empty())
+  {
+    itkGenericExceptionMacro("Pixel component type " << typeid(ComponentType).name() << " cannot be written as NRRD");
+  }
+
+  const RegionType    region = image->GetLargestPossibleRegion();
+  const SpacingType   spacing = image->GetSpacing();
+  const DirectionType direction = image->GetDirection();
+  PointType           origin;
+  image->TransformIndexToPhysicalPoint(region.GetIndex(), origin);
+
+  std::ostringstream header;
+  header.precision(17);
+  header << "NRRD0004\n";
+  header << "# Complete NRRD file format specification at:\n";
+  header << "# http://teem.sourceforge.net/nrrd/format.html\n";
+  header << "type: " << type << "\n";
+  header << "dimension: " << ImageDimension + (numberOfComponents > 1) << "\n";
+  header << "space dimension: " << ImageDimension << "\n";
+  header << "sizes:";
+  if (numberOfComponents > 1)
+  {
+    header << ' ' << numberOfComponents;
+  }
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    header << ' ' << region.GetSize(d);
+  }
+  header << "\nspace directions:";
+  if (numberOfComponents > 1)
+  {
+    header << " none";
+  }
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    header << " (";
+    for (unsigned i = 0; i < ImageDimension; i++)
+    {
+      header << (i > 0 ? "," : "") << direction[i][d] * spacing[d];
+    }
+    header << ')';
+  }
+  header << "\nkinds:";
+  if (std::is_same<PixelType, RGBPixel<ComponentType>>::value)
+  {
+    header << " RGB-color";
+  }
+  else if (std::is_same<PixelType, RGBAPixel<ComponentType>>::value)
+  {
+    header << " RGBA-color";
+  }
+  else if (numberOfComponents == 3)
+  {
+    header << " 3-vector";
+  }
+  else if (numberOfComponents > 1)
+  {
+    header << " vector";
+  }
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    header << " domain";
+  }
+  header << "\nendian: " << (ByteSwapper<int>::SystemIsBigEndian() ? "big" : "little") << "\n";
+  header << "encoding: gzip\n";
+  header << "space origin: (";
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    header << (d > 0 ? "," : "") << origin[d];
+  }
+  header << ")\n\n"; // an empty line separates the header from the data
+  return header.str();
+}
+
+template <typename TImageType, typename TPixelAccumulateType, typename TInterpolator>
+void
+TileMergeImageFilter<TImageType, TPixelAccumulateType, TInterpolator>::WriteCompressedNrrd(
+  const std::string & fileName,
+  SizeValueType       slabThickness)
+{
+  this->UpdateOutputInformation();
+  ImagePointer       outputImage = this->GetOutput();
+  const RegionType   fullRegion = outputImage->GetLargestPossibleRegion();
+  constexpr unsigned slowest = ImageDimension - 1;
+  if (slabThickness == 0)
+  {
+    slabThickness = this->GetFirstTileThickness();
+  }
+
+  ParallelGzipWriter writer(fileName, GetNrrdHeader(outputImage));
+  const IndexValueType fullThickness = fullRegion.GetSize(slowest);
+  for (IndexValueType z = 0; z < fullThickness; z += slabThickness)
+  {
+    RegionType slab = fullRegion;
+    slab.SetIndex(slowest, fullRegion.GetIndex(slowest) + z);
+    slab.SetSize(slowest, std::min<SizeValueType>(slabThickness, fullThickness - z));
+    outputImage->SetRequestedRegion(slab);
+    outputImage->PropagateRequestedRegion();
+    outputImage->UpdateOutputData();
+
+    // slabs along the slowest dimension are contiguous in the file,
+    // the writer keeps this one's buffer while the next one is merged into a new buffer
+    const typename ImageType::PixelContainer * buffer = outputImage->GetPixelContainer();
+    writer.Write(buffer->GetBufferPointer(), slab.GetNumberOfPixels() * sizeof(PixelType), buffer);
+    outputImage->ReleaseData();
+  }
+  writer.Close();
+}
+
 } // namespace itk
 
 #endif // itkTileMergeImageFilter_hxx
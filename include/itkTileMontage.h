@@ -20,12 +20,18 @@
 #define itkTileMontage_h
 
 #include "itkImageFileReader.h"
+#include "itkMontageInstrumentation.h"
+#include "itkPooledImportImageContainer.h"
 #include "itkPhaseCorrelationOptimizer.h"
 #include "itkPhaseCorrelationImageRegistrationMethod.h"
 
 #include <atomic>
 #include <deque>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 namespace itk
@@ -35,6 +41,27 @@ namespace itk
  *
  * Determines registrations which can be used to resample a mosaic into a single image.
  *
+ * Tiles can have multi-component pixels (e.g. RGB). Such tiles are registered
+ * using their luminance (or a single channel, see SetRegistrationChannel()),
+ * which is computed on the fly during padding, without a scalar copy of the tile.
+ *
+ * Tiles can be preprocessed (e.g. denoised or flat-field corrected) by the same
+ * worker threads which register them, see SetTilePreprocessor().
+ *
+ * Instead of being held in memory or read from files, tiles can be
+ * produced on demand by a callable, see SetTileSource().
+ *
+ * By default, each tile is registered to its predecessor along each dimension
+ * of the montage grid. Alternatively, pairs to register can be given explicitly,
+ * see SetTilePairs(), or determined from tile positions, see SetMinimumOverlap().
+ * Then tiles can also be listed along a single dimension of the montage size,
+ * so acquisitions with irregular outlines need no dummy tiles.
+ *
+ * Pairs can be registered while the tiles are still being acquired,
+ * as soon as both of their tiles exist, see AddAcquiredTile().
+ *
+ * Per-stage timings and counters can be collected, see SetInstrumentation().
+ *
  * \author Dženan Zukić, dzenan.zukic@kitware.com
  *
  * \ingroup Montage
@@ -63,6 +90,9 @@ public:
   /** Dimensionality of input images. */
   static constexpr unsigned int ImageDimension = ImageType::ImageDimension;
 
+  /** Size, along each dimension, of the blocks over which tile information is summed. */
+  static constexpr SizeValueType InformationBlockSize = 8;
+
   /** Montage size and tile index types. */
   using SizeType = Size<ImageDimension>;
   using TileIndexType = Size<ImageDimension>;
@@ -131,10 +161,75 @@ public:
   /** Set/Get tile positioning precision.
    * Get/Set expected maximum linear translation needed, in pixels.
    * Zero (the default) means unknown, and allows translations
-   * up to about half the image size.*/
+   * up to about half the image size. When cropping to overlap,
+   * a non-zero tolerance also limits how far the overlap is expanded,
+   * which leads to smaller FFTs.*/
   itkSetMacro(PositionTolerance, SizeValueType);
   itkGetConstMacro(PositionTolerance, SizeValueType);
 
+  /** A pair of tiles to register, as linear indices of the fixed and the moving tile. */
+  using TilePairType = std::pair<SizeValueType, SizeValueType>;
+  using TilePairsType = std::vector<TilePairType>;
+
+  /** Set/Get explicit pairs of tiles to register. If not empty, only these
+   * pairs are registered and used by global optimization, instead of
+   * the adjacent tiles of the montage grid. Additional links, e.g. diagonal ones,
+   * can be included. Each connected group of tiles is positioned relative to
+   * its lowest-index tile, which keeps its expected position. */
+  void
+  SetTilePairs(const TilePairsType & pairs)
+  {
+    m_TilePairs = pairs;
+    this->Modified();
+  }
+  itkGetConstReferenceMacro(TilePairs, TilePairsType);
+
+  /** Set/Get minimum overlap of tiles to be registered, as a fraction
+   * of the smaller tile's volume. If positive, and explicit tile pairs are not set,
+   * pairs are determined from tile positions (origins and sizes) via a spatial index,
+   * instead of using the adjacent tiles of the montage grid. Default: 0.0 (grid). */
+  itkSetClampMacro(MinimumOverlap, double, 0.0, 1.0);
+  itkGetConstMacro(MinimumOverlap, double);
+
+  /** Pairs registered by the last Update(). */
+  itkGetConstReferenceMacro(Pairs, TilePairsType);
+
+  /** Set/Get minimum information content of a pair's expected overlap for it to be registered.
+   * Information is the mean squared intensity gradient of the registration channel,
+   * in squared intensity units per pixel, and is taken from the less textured tile of the pair.
+   * Squared gradients are summed once per tile, when it is read, over blocks of InformationBlockSize pixels
+   * along each dimension, and the overlap's information is estimated from the blocks it covers.
+   * Pairs below the threshold (e.g. background tiles at the specimen border)
+   * skip phase correlation, and enter global optimization as weak constraints
+   * keeping their expected (stage) positions. They are never treated as outliers.
+   * Default: 0.0 (all pairs are registered). */
+  itkSetClampMacro(InformationThreshold, double, 0.0, NumericTraits<double>::max());
+  itkGetConstMacro(InformationThreshold, double);
+
+  /** Set/Get tiered registration. If enabled, all the pairs are first registered with cheap settings:
+   * zero padding method, no obligatory padding (smaller FFTs), parabolic peak interpolation,
+   * and two candidate offsets. After a first global optimization, only the ambiguous pairs
+   * (see SetAmbiguityThreshold()) and the pairs whose residual exceeds the absolute threshold
+   * are registered again, using the configured settings. With a tile preprocessor
+   * (see SetTilePreprocessor()), preprocessed tiles are kept until escalated pairs
+   * are registered, so each tile is still preprocessed only once. Default: false. */
+  itkSetMacro(TieredRegistration, bool);
+  itkGetConstMacro(TieredRegistration, bool);
+  itkBooleanMacro(TieredRegistration);
+
+  /** Set/Get the ratio of the second to the first candidate's confidence above which
+   * a pair registered by the cheap pass of tiered registration is ambiguous. Default: 0.5. */
+  itkSetClampMacro(AmbiguityThreshold, double, 0.0, 1.0);
+  itkGetConstMacro(AmbiguityThreshold, double);
+
+  /** Whether the pair with given index into GetPairs() was skipped by the last Update()
+   * because of low information content, see SetInformationThreshold(). */
+  bool
+  IsLowInformationPair(SizeValueType pairIndex) const
+  {
+    return m_LowInformation[pairIndex] != 0;
+  }
+
   /** Set/Get tile cropping. Should tiles be cropped to overlapping
    * region for computing the cross correlation? Default: True.
    *
@@ -157,6 +252,26 @@ public:
   }
   itkGetConstMacro(ObligatoryPadding, SizeType);
 
+  /** Set/Get the channel used for registration of multi-component tiles.
+   * Negative value (the default) means luminance. Ignored for scalar images.
+   * Throws if the channel is not less than the number of pixel components. */
+  virtual void
+  SetRegistrationChannel(int channel)
+  {
+    constexpr int components = PixelTraits<PixelType>::Dimension;
+    if (components > 1 && channel >= components)
+    {
+      itkExceptionMacro("Registration channel " << channel << " is out of range for pixels with " << components
+                                                << " components");
+    }
+    if (m_RegistrationChannel != channel)
+    {
+      m_RegistrationChannel = channel;
+      this->Modified();
+    }
+  }
+  itkGetConstMacro(RegistrationChannel, int);
+
   /** Set/Get the padding method. */
   itkSetEnumMacro(PaddingMethod, typename PCMType::PaddingMethodEnum);
   itkGetConstMacro(PaddingMethod, typename PCMType::PaddingMethodEnum);
@@ -165,6 +280,177 @@ public:
   itkSetEnumMacro(PeakInterpolationMethod, typename PCMOptimizerType::PeakInterpolationMethodEnum);
   itkGetConstMacro(PeakInterpolationMethod, typename PCMOptimizerType::PeakInterpolationMethodEnum);
 
+  /** Set/Get the upsampling factor of the UpsampledDFT peak interpolation method. Default: 20. */
+  itkSetClampMacro(UpsamplingFactor, unsigned, 1, 1000);
+  itkGetConstMacro(UpsamplingFactor, unsigned);
+
+  /** Set/Get the FFT implementation, see PhaseCorrelationImageRegistrationMethod::SetFFTBackend().
+   * Also sets the number of work units from the backend's capabilities: one per thread
+   * if a single FFT is single threaded, so pairs are registered in parallel, otherwise only a few,
+   * to overlap reading of tiles with computation. Set the number of work units afterwards to override;
+   * setting the same backend again keeps it. */
+  using FFTBackendEnum = typename PCMType::FFTBackendEnum;
+  virtual void
+  SetFFTBackend(FFTBackendEnum backend);
+  itkGetConstMacro(FFTBackend, FFTBackendEnum);
+
+  /** Set/Get the file with FFTW wisdom, i.e. learned FFT plans of the internal precision.
+   * If set, wisdom is imported before registration and exported after it,
+   * so later runs reuse plans made by earlier ones, and can afford measure-quality planning
+   * (see FFTWGlobalConfiguration::SetPlanRigor()). Ignored if ITK is built without FFTW.
+   * Default: empty, wisdom is not persisted. */
+  itkSetMacro(FFTWWisdomFile, std::string);
+  itkGetConstReferenceMacro(FFTWWisdomFile, std::string);
+
+  /** Plans FFTs of all the sizes which registration of this montage needs,
+   * with at least FFTW_MEASURE rigor, and exports the wisdom to FFTWWisdomFile.
+   * Sizes are determined from tile metadata, without reading pixels.
+   * Meant to be run once per tile configuration (tile sizes and overlaps).
+   * Returns the number of distinct FFT sizes. */
+  SizeValueType
+  TrainFFTWWisdom();
+
+  /** Set/Get NUMA awareness. If enabled on a machine with several NUMA nodes (see MontageNUMA),
+   * tiles are partitioned into contiguous blocks of linear indices, one block per node.
+   * Pairs completed by a tile are registered on a thread bound to the tile's node,
+   * so the tile and its spectrum are allocated there by first touch,
+   * and most pairs (adjacent tiles) find both of their tiles node-local.
+   * Such a pair is registered single-threaded, as threads of nested parallel work are not bound;
+   * parallelism comes from registering many pairs at once.
+   * Jobs of different nodes are interleaved, so all the nodes work at once.
+   * TileMergeImageFilter binds resampling of a region to the node of its first contributing tile.
+   * Default: false. */
+  itkSetMacro(NUMAAware, bool);
+  itkGetConstMacro(NUMAAware, bool);
+  itkBooleanMacro(NUMAAware);
+
+  /** Set/Get buffer pooling. If enabled, images allocated while registering a pair
+   * (tiles, cropped and padded images, spectra, correlation surfaces) take their large buffers
+   * from MontageBufferPool, and return them to it when released. After the first few pairs,
+   * registration then allocates no more large buffers. The free buffers are returned
+   * to the system at the end of Update(), and buffers still in use then (e.g. held by outputs)
+   * are returned to the system when released. Images allocated outside of registration
+   * do not use the pool. The pooled pixel container is only installed from the start of registration
+   * to the end of Update() (or RegisterShard()), so other images of the process are not affected
+   * afterwards. Default: false. */
+  itkSetMacro(BufferPooling, bool);
+  itkGetConstMacro(BufferPooling, bool);
+  itkBooleanMacro(BufferPooling);
+
+  /** Per-tile preprocessing, invoked with a tile and its linear index.
+   * It is invoked once per tile, the first time the tile's pixels are needed,
+   * and the result is kept until all the tile's pairs are registered
+   * (with tiered registration, until the end of Update()).
+   * Tiles are preprocessed in parallel by the worker threads, so the preprocessor
+   * must be thread safe. It must not change tile's size, origin, spacing or direction.
+   * Tile's buffer can be shared with the image passed to SetInputTile(),
+   * in which case in-place modifications are visible to the caller. */
+  using TilePreprocessorType = std::function<typename ImageType::Pointer(ImageType * tile, SizeValueType linearIndex)>;
+  void
+  SetTilePreprocessor(const TilePreprocessorType & preprocessor)
+  {
+    m_TilePreprocessor = preprocessor;
+    this->Modified();
+  }
+  const TilePreprocessorType &
+  GetTilePreprocessor() const
+  {
+    return m_TilePreprocessor;
+  }
+
+  /** Produces a tile on demand, invoked with its linear index, whether only metadata
+   * (largest possible region, origin, spacing, direction) is needed, and the region
+   * of pixels needed (all of them if the region is empty). The source is used for
+   * tiles which have neither an image nor a file name, and is invoked whenever
+   * such tile would otherwise be read from a file. Tiles are obtained in parallel
+   * by the worker threads, so the source must be thread safe, and it must return
+   * a new image on each invocation. \sa SyntheticMosaicGenerator */
+  using TileSourceType =
+    std::function<typename ImageType::Pointer(SizeValueType linearIndex, bool metadataOnly, const RegionType & region)>;
+
+  /** Sets the tile source. To be called after SetMontageSize(),
+   * as all the tiles which have no input yet are marked to be obtained from the source. */
+  void
+  SetTileSource(const TileSourceType & source);
+  const TileSourceType &
+  GetTileSource() const
+  {
+    return m_TileSource;
+  }
+
+  /** Set/Get instrumentation, which collects per-stage timings, counters and memory usage
+   * of tile reading, pairwise registration, global optimization and merging.
+   * Memory of tiles passed to SetInputTile() as images is not accounted,
+   * as it is held by the caller.
+   * Setting it does not modify the montage. Null (the default) disables collection. */
+  void
+  SetInstrumentation(MontageInstrumentation * instrumentation)
+  {
+    m_Instrumentation = instrumentation;
+  }
+  MontageInstrumentation *
+  GetInstrumentation() const
+  {
+    return m_Instrumentation;
+  }
+
+  /** Predicts peak memory usage of Update(), for each category,
+   * from the current parameters (cropping, padding, number of work units)
+   * and metadata of the tiles. All tiles are assumed to be as big as the first one.
+   * Tile images or filenames must be set. Compare with the high-water marks
+   * of the instrumentation, see SetInstrumentation(). */
+  virtual MontageInstrumentation::MemoryBytes
+  EstimatePeakMemoryUsage();
+
+  /** Registers only the pairs of one shard, and writes their registration candidates
+   * to a file, instead of optimizing tile positions. The montage grid is split into numberOfShards
+   * spatial blocks of tiles, the prime factors of numberOfShards being distributed among dimensions
+   * so that blocks are as close to square as possible. A pair belongs to the block of its tile
+   * with the higher linear index, so the pairs completed by a tile are not split,
+   * and only tiles on block boundaries are read by two shards. Shards are independent, so they can be registered
+   * by separate processes, e.g. tasks of a job array on a shared filesystem.
+   * Tiles and parameters must be set as for Update(). Tiered registration is not applied.
+   * The file is written under a temporary name and renamed when complete. \sa ReadShards() */
+  void
+  RegisterShard(unsigned shardIndex, unsigned numberOfShards, const std::string & shardFilename);
+
+  /** Reads registration candidates from files written by RegisterShard(),
+   * so that the next Update() only optimizes tile positions, without reading tile pixels.
+   * Montage size, tile metadata and pair determination parameters must be the same
+   * as when the shards were registered, and the shards must together cover all the pairs. */
+  void
+  ReadShards(const std::vector<std::string> & shardFilenames);
+
+  /** Indices into GetPairs() of the pairs in the given shard, see RegisterShard().
+   * Pairs must have been determined. */
+  std::vector<SizeValueType>
+  GetShardPairs(unsigned shardIndex, unsigned numberOfShards) const;
+
+  /** Tells the montage that the tile at position has been acquired, e.g. by a microscope,
+   * so the pairs it completes with already acquired tiles are registered in the background.
+   * The first call determines the pairs, so montage size, explicit tile pairs and registration
+   * parameters must be set before it. Pairs found from overlaps (see SetMinimumOverlap())
+   * are not supported, as they depend on tiles yet to be acquired.
+   * The tile's image must be available, either as an input tile or from the tile source.
+   * When registration lags behind acquisition, the call blocks until a registration finishes,
+   * which bounds the memory held by tiles waiting for registration. Calls must come from a single thread.
+   * Acquisition ends with Update(), which only registers the pairs not registered yet
+   * and optimizes tile positions. Errors of background registrations are rethrown
+   * by the next call, by UpdateProvisionalTransforms() or by Update(). */
+  void
+  AddAcquiredTile(TileIndexType position);
+  void
+  AddAcquiredTile(TileIndexType position, ImageType * image);
+  void
+  AddAcquiredTile(TileIndexType position, const std::string & imageFilename);
+
+  /** Waits for the background registrations, and optimizes positions of the tiles from the pairs
+   * registered so far, starting from the previous provisional positions. Tiles without
+   * registered pairs keep their expected positions. Output transforms are updated, but mosaic
+   * bounds are not, so only GetOutputTransform() is meaningful until Update(). */
+  void
+  UpdateProvisionalTransforms();
+
   /** Get/Set size of the image mosaic. */
   itkGetConstMacro(MontageSize, SizeType);
   void
@@ -178,6 +464,7 @@ public:
     this->SetNthInput(linearIndex, image);
     m_FFTCache[linearIndex] = nullptr;
     m_Tiles[linearIndex] = nullptr;
+    m_TileInformation[linearIndex] = TileInformation();
   }
   void
   SetInputTile(SizeValueType linearIndex, const std::string & imageFilename)
@@ -205,7 +492,7 @@ public:
 
 protected:
   TileMontage();
-  ~TileMontage() override = default;
+  ~TileMontage() override;
   void
   PrintSelf(std::ostream & os, Indent indent) const override;
 
@@ -233,22 +520,117 @@ protected:
   typename TImageToRead::Pointer
   GetImageHelper(TileIndexType nDIndex, bool metadataOnly, RegionType region);
 
-  /** Just get image pointer if the image is present, otherwise read it from file. */
+  /** Just get image pointer if the image is present, otherwise read it from file.
+   * If tile preprocessor is set, pixel data is preprocessed and cached. */
   typename ImageType::Pointer
   GetImage(TileIndexType nDIndex, bool metadataOnly);
 
+  /** Whether tile's pixels are read from a file or obtained from the tile source,
+   * as opposed to being held by the caller. */
+  bool
+  IsTileOwned(SizeValueType linearIndex) const
+  {
+    return this->GetInput(linearIndex) == m_Dummy.GetPointer();
+  }
+
   DataObjectPointerArraySizeType
   nDIndexToLinearIndex(TileIndexType nDIndex) const;
   TileIndexType
   LinearIndexTonDIndex(DataObjectPointerArraySizeType linearIndex) const;
 
-  /** Register a pair of images with given indices. Handles FFTcaching. */
+  /** Determines pairs to register: the explicit ones, the ones overlapping
+   * by at least MinimumOverlap, or the adjacent ones in the montage grid.
+   * Pairs are ordered by the higher of their tile indices. */
+  void
+  DeterminePairs();
+
+  /** Finds pairs of tiles whose bounding boxes overlap by at least MinimumOverlap. */
+  TilePairsType
+  FindOverlappingPairs();
+
+  /** Register a pair of images with given index into m_Pairs. Handles FFTcaching.
+   * Cheap registration uses the settings of the first pass of tiered registration,
+   * and neither uses nor populates the FFT cache. */
+  void
+  RegisterPair(SizeValueType pairIndex, bool cheap = false);
+
+  /** Creates a registration method, configured by the parameters of this montage.
+   * A cheap one uses zero padding and parabolic peak interpolation, see SetTieredRegistration(). */
+  typename PCMType::Pointer
+  CreateRegistrationMethod(bool cheap) const;
+
+  /** Registers the pairs with given indices into m_Pairs, which must be in increasing order,
+   * in parallel. Tiles are released once all of their pairs among these are registered.
+   * Progress goes from progressFrom to progressTo. */
+  void
+  RegisterPairs(const std::vector<SizeValueType> & pairIndices, bool cheap, float progressFrom, float progressTo);
+
+  /** Optimizes tile positions from the cheaply registered candidates,
+   * and returns indices of the pairs which are ambiguous or have large residuals.
+   * Registration candidates are left as they were before the optimization. */
+  std::vector<SizeValueType>
+  SelectPairsToEscalate();
+
+  /** Registers pooled pixel types if buffer pooling is on, and makes sure the thread pool
+   * has more threads than work units, as registration jobs wait on nested parallel work. */
+  void
+  PrepareRegistration();
+
+  /** Removes the pooled pixel container registrations made by PrepareRegistration(),
+   * and returns the free pooled buffers to the system. */
   void
-  RegisterPair(TileIndexType fixed, TileIndexType moving);
+  EndBufferPooling();
 
-  /** If possible, removes from memory tile with index smaller by 1 along all dimensions. */
+  /** Determines pairs and prepares for registration, on the first AddAcquiredTile(). */
   void
-  ReleaseMemory(TileIndexType finishedTile);
+  StartAcquisition();
+
+  /** Waits for all background registrations of acquired tiles, rethrowing their errors. */
+  void
+  WaitForAcquisitionJobs();
+
+  /** Spacing of the first tile, or of the first acquired one during acquisition. */
+  SpacingType
+  GetTileSpacing();
+
+  /** Number of work units suited to the FFT backend's parallelism, see SetFFTBackend(). */
+  static unsigned
+  GetBackendNumberOfWorkUnits(FFTBackendEnum backend);
+
+  /** Imports FFTW wisdom from FFTWWisdomFile, if set. */
+  void
+  ImportFFTWWisdom();
+
+  /** Node to which work on the tile is bound, -1 if not NUMA aware. */
+  int
+  GetTileNode(SizeValueType linearIndex) const;
+
+  /** Exports FFTW wisdom to FFTWWisdomFile, if set. The file is replaced atomically
+   * by renaming a temporary file unique to this export, as several processes
+   * might be registering shards of the same montage. */
+  void
+  ExportFFTWWisdom();
+
+  /** Sums squared forward differences of the tile's registration channel per block of pixels,
+   * unless the information threshold is zero or the tile's sums are already computed. */
+  void
+  ComputeTileInformation(SizeValueType linearIndex, const ImageType * tile);
+
+  /** Mean squared gradient of tile's registration channel within its expected overlap with the other tile,
+   * estimated from the tile's block sums, where partially covered blocks contribute proportionally.
+   * The overlap is determined from tile origins. Zero if tiles do not overlap. */
+  double
+  ComputeOverlapInformation(SizeValueType linearIndex, const ImageType * tile, const ImageType * other) const;
+
+  /** Removes from memory tiles of the finished pair which no other pair needs.
+   * After a cheap registration, preprocessed tiles are kept for escalation. */
+  void
+  ReleaseMemory(SizeValueType pairIndex, bool cheap);
+
+  /** Releases tile's cached FFT and, unless kept, its preprocessed image,
+   * accounting for the freed memory. The caller is responsible for synchronization. */
+  void
+  ReleaseCachedTile(SizeValueType linearIndex, bool keepPreprocessed = false);
 
   /** Accesses output, sets a transform to it, and updates progress. */
   void
@@ -270,8 +652,17 @@ protected:
   using OffsetVector = std::vector<TranslationOffset>;
   using ConfidencesType = typename PCMType::ConfidencesVector;
 
+  /** Optimizes tile positions from the registration candidates.
+   * With warmStart, the iterative solver starts from the current adjustments,
+   * which UpdateProvisionalTransforms() uses to refine the previous provisional solution. */
   void
-  OptimizeTiles();
+  OptimizeTiles(bool warmStart = false);
+
+  /** Stores registration candidates for the pair with given index into GetPairs(),
+   * as RegisterPair() does. Together with DeterminePairs() and OptimizeTiles(),
+   * this allows global optimization to be exercised without registering any images. */
+  void
+  SetPairCandidates(SizeValueType pairIndex, const OffsetVector & offsets, const ConfidencesType & confidences);
 
   std::deque<std::mutex> m_TileReadLocks; // to avoid reading the same tile by more than one thread in parallel
   // deque is not reallocated when resized, so no mutex moving causing a crash
@@ -289,19 +680,55 @@ private:
   float         m_RelativeThreshold = 3.0;
   SizeValueType m_PositionTolerance = 0;
   bool          m_CropToOverlap = true;
+  int           m_RegistrationChannel = -1;
   SizeType      m_ObligatoryPadding;
+  double        m_MinimumOverlap = 0.0;
+  double        m_InformationThreshold = 0.0;
+  bool          m_TieredRegistration = false;
+  unsigned      m_UpsamplingFactor = 20;
+  double        m_AmbiguityThreshold = 0.5;
+  bool          m_GridPairs = true; // whether m_Pairs are the adjacent tiles of the montage grid
+  bool          m_CandidatesRead = false;
+  bool          m_Acquiring = false; // tiles are being added, see AddAcquiredTile()
+  bool          m_NUMAAware = false;
+  bool          m_BufferPooling = false;
+
+  /** Squared forward differences of a tile's registration channel, summed per block of pixels. */
+  struct TileInformation
+  {
+    RegionType                 m_Region; // buffered region of the tile, blocks start at its index
+    std::vector<double>        m_Sums;   // per block, the first dimension varying fastest
+    std::vector<SizeValueType> m_Counts; // differences summed, per block
+  };
 
   std::mutex m_MemberProtector; // to prevent concurrent access to non-thread-safe internal member variables
 
   typename PCMType::PaddingMethodEnum m_PaddingMethod = PCMType::PaddingMethodEnum::MirrorWithExponentialDecay;
+  FFTBackendEnum                      m_FFTBackend = FFTBackendEnum::Default;
 
+  std::string                    m_FFTWWisdomFile;
   std::vector<std::string>       m_Filenames;
   std::vector<FFTConstPointer>   m_FFTCache;
-  std::vector<ImagePointer>      m_Tiles; // metadata/image storage (if filenames are given instead of actual images)
-  std::vector<OffsetVector>      m_TransformCandidates; // to adjacent tiles
+  std::vector<ImagePointer>      m_Tiles; // preprocessed tiles, kept until all their pairs are registered
+  std::vector<TileInformation>   m_TileInformation; // per tile, computed when read, see ComputeTileInformation()
+  TilePairsType                  m_TilePairs;           // explicitly set
+  TilePairsType                  m_Pairs;               // being registered
+  std::vector<SizeValueType>     m_RemainingPairs;      // per tile, to release it when all its pairs are done
+  std::vector<OffsetVector>      m_TransformCandidates; // per pair
   std::vector<ConfidencesType>   m_CandidateConfidences;
+  std::vector<char>              m_LowInformation; // per pair, not vector<bool> as pairs are written concurrently
   std::vector<TranslationOffset> m_CurrentAdjustments;
 
+  std::vector<char>                       m_TileAcquired;   // per tile, during acquisition
+  std::vector<char>                       m_PairRegistered; // per pair, written by acquisition jobs
+  std::vector<std::vector<SizeValueType>> m_PairsOfTile;    // indices into m_Pairs, per tile
+  std::deque<std::future<void>>           m_AcquisitionJobs;
+  std::vector<std::shared_ptr<void>>      m_PoolRegistrations; // see PrepareRegistration()
+
+  TilePreprocessorType            m_TilePreprocessor;
+  TileSourceType                  m_TileSource;
+  MontageInstrumentation::Pointer m_Instrumentation;
+
   typename PCMOptimizerType::PeakInterpolationMethodEnum m_PeakInterpolationMethod =
     PCMOptimizerType::PeakInterpolationMethodEnum::Parabolic;
 
@@ -21,20 +21,46 @@
 
 #include "itkTileMontage.h"
 
+#include "itkImageScanlineConstIterator.h"
+#include "itkMontageNUMA.h"
 #include "itkMultiThreaderBase.h"
 #include "itkNumericTraits.h"
 #include "itkThreadPool.h"
-#include "itkConfigure.h" // for ITK_USE_FFTWF and ITK_USE_FFTWD
+#include "itksys/SystemInformation.hxx"
 
 #include "itk_eigen.h"
 #include ITK_EIGEN(Sparse)
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+#  include "itkFFTWGlobalConfiguration.h"
+#endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <iomanip>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
 
 namespace itk
 {
+/** Name of a temporary file in the directory of fileName,
+ * distinct for every call in every process, so concurrent writers never share one. */
+inline std::string
+MontageTemporaryFilename(const std::string & fileName)
+{
+  static std::atomic<unsigned> count{ 0 };
+  std::ostringstream           name;
+  name << fileName << '.' << itksys::SystemInformation::GetProcessId() << '.' << count++ << ".tmp";
+  return name.str();
+}
+
 template <typename TImageType, typename TCoordinate>
 TileMontage<TImageType, TCoordinate>::TileMontage()
 {
@@ -44,7 +70,7 @@ TileMontage<TImageType, TCoordinate>::TileMontage()
   // make default padding sufficient for exponential decay to zero
   m_ObligatoryPadding.Fill(0);
   SizeType pad;
-  pad.Fill(8 * sizeof(typename TImageType::PixelType));
+  pad.Fill(8 * sizeof(typename NumericTraits<PixelType>::ValueType)); // per component
   this->SetObligatoryPadding(pad);
 
   SizeType initialSize;
@@ -52,17 +78,49 @@ TileMontage<TImageType, TCoordinate>::TileMontage()
   initialSize[0] = 2;
   this->SetMontageSize(initialSize);
 
-#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD) // FFTW, MKL and cuFFT are already parallel
-  // we want light parallelism, just to overlap IO with computation
-  this->SetNumberOfWorkUnits(std::max(2u, MultiThreaderBase::GetGlobalDefaultNumberOfThreads() / 16));
-#else // we are dealing with VNL's single threaded implementation
-  this->SetNumberOfWorkUnits(MultiThreaderBase::GetGlobalDefaultNumberOfThreads()); // we want full parallelism
-#endif
+  this->SetNumberOfWorkUnits(GetBackendNumberOfWorkUnits(m_FFTBackend));
 
   // required for GenerateOutputInformation to be called
   this->SetNthOutput(0, this->MakeOutput(0).GetPointer());
 }
 
+template <typename TImageType, typename TCoordinate>
+TileMontage<TImageType, TCoordinate>::~TileMontage()
+{
+  for (std::future<void> & job : m_AcquisitionJobs)
+  {
+    job.wait(); // background registrations access this object
+  }
+  this->EndBufferPooling();
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::SetFFTBackend(FFTBackendEnum backend)
+{
+  if (m_FFTBackend != backend) // an explicitly set number of work units survives setting the same backend again
+  {
+    m_FFTBackend = backend;
+    this->SetNumberOfWorkUnits(GetBackendNumberOfWorkUnits(backend));
+    m_FFTCache.assign(m_FFTCache.size(), nullptr); // FFTs from different backends are not mixed
+    this->Modified();
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+unsigned
+TileMontage<TImageType, TCoordinate>::GetBackendNumberOfWorkUnits(FFTBackendEnum backend)
+{
+  const typename PCMType::FFTBackendCapabilities capabilities = PCMType::GetFFTBackendCapabilities(backend);
+  if (capabilities.MultiThreaded) // e.g. FFTW, MKL and cuFFT
+  {
+    // we want light parallelism, just to overlap IO with computation
+    return std::max(2u, MultiThreaderBase::GetGlobalDefaultNumberOfThreads() / 16);
+  }
+  // e.g. VNL's single threaded implementation
+  return MultiThreaderBase::GetGlobalDefaultNumberOfThreads(); // we want full parallelism
+}
+
 template <typename TImageType, typename TCoordinate>
 void
 TileMontage<TImageType, TCoordinate>::PrintSelf(std::ostream & os, Indent indent) const
@@ -80,6 +138,21 @@ TileMontage<TImageType, TCoordinate>::PrintSelf(std::ostream & os, Indent indent
   os << indent << "Absolute Threshold: " << m_AbsoluteThreshold << std::endl;
   os << indent << "Relative Threshold: " << m_RelativeThreshold << std::endl;
   os << indent << "Position Tolerance: " << m_PositionTolerance << std::endl;
+  os << indent << "Minimum Overlap: " << m_MinimumOverlap << std::endl;
+  os << indent << "Information Threshold: " << m_InformationThreshold << std::endl;
+  os << indent << "Tiered Registration: " << (m_TieredRegistration ? "On" : "Off") << std::endl;
+  os << indent << "Ambiguity Threshold: " << m_AmbiguityThreshold << std::endl;
+  os << indent << "Upsampling Factor: " << m_UpsamplingFactor << std::endl;
+  os << indent << "FFT Backend: " << m_FFTBackend << std::endl;
+  os << indent << "FFTW Wisdom File: " << m_FFTWWisdomFile << std::endl;
+  os << indent << "NUMA Aware: " << (m_NUMAAware ? "On" : "Off") << std::endl;
+  os << indent << "Buffer Pooling: " << (m_BufferPooling ? "On" : "Off") << std::endl;
+  os << indent << "Acquiring: " << (m_Acquiring ? "Yes" : "No") << std::endl;
+  os << indent << "Tile Pairs (explicit/registered): " << m_TilePairs.size() << "/" << m_Pairs.size() << std::endl;
+  os << indent << "Registration Channel: " << m_RegistrationChannel << std::endl;
+  os << indent << "Tile Preprocessor: " << (m_TilePreprocessor ? "set" : "none") << std::endl;
+  os << indent << "Tile Source: " << (m_TileSource ? "set" : "none") << std::endl;
+  os << indent << "Instrumentation: " << m_Instrumentation.GetPointer() << std::endl;
 
   auto nullCount = std::count(m_Filenames.begin(), m_Filenames.end(), std::string());
   os << indent << "Filenames (filled/capacity): " << m_Filenames.size() - nullCount << "/" << m_Filenames.size()
@@ -112,13 +185,31 @@ TileMontage<TImageType, TCoordinate>::SetMontageSize(SizeType montageSize)
     m_Filenames.resize(m_LinearMontageSize);
     m_FFTCache.resize(m_LinearMontageSize);
     m_Tiles.resize(m_LinearMontageSize);
+    m_TileInformation.resize(m_LinearMontageSize);
     m_CurrentAdjustments.resize(m_LinearMontageSize);
-    m_TransformCandidates.resize(ImageDimension * m_LinearMontageSize); // adjacency along each dimension
-    m_CandidateConfidences.resize(ImageDimension * m_LinearMontageSize);
+    m_Pairs.clear(); // determined on update
+    m_TransformCandidates.clear();
+    m_CandidateConfidences.clear();
+    m_CandidatesRead = false;
     this->Modified();
   }
 }
 
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::SetTileSource(const TileSourceType & source)
+{
+  m_TileSource = source;
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    if (this->GetInput(i) == nullptr)
+    {
+      this->SetInputTile(i, m_Dummy);
+    }
+  }
+  this->Modified();
+}
+
 template <typename TImageType, typename TCoordinate>
 template <typename TImageToRead>
 typename TImageToRead::Pointer
@@ -138,6 +229,19 @@ TileMontage<TImageType, TCoordinate>::GetImageHelper(TileIndexType nDIndex, bool
     result->SetDirection(input->GetDirection());
     result->SetPixelContainer(input->GetPixelContainer());
   }
+  else if (this->m_Filenames[linearIndex].empty() && m_TileSource)
+  {
+    MontageInstrumentation::ScopedStageTimer timer(metadataOnly ? nullptr : m_Instrumentation.GetPointer(),
+                                                   MontageInstrumentation::StageEnum::TileRead);
+    result = m_TileSource(linearIndex, metadataOnly, region);
+    itkAssertOrThrowMacro(result.IsNotNull(), "Tile source returned a null image for tile " << nDIndex);
+    if (m_Instrumentation && !metadataOnly)
+    {
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::TilesRead);
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::BytesRead,
+                                   MontageInstrumentation::GetBufferBytes(result.GetPointer()));
+    }
+  }
   else // examine cache and read from file if necessary
   {
     using ImageReaderType = ImageFileReader<TImageToRead>;
@@ -148,6 +252,7 @@ TileMontage<TImageType, TCoordinate>::GetImageHelper(TileIndexType nDIndex, bool
 
     if (!metadataOnly)
     {
+      MontageInstrumentation::ScopedStageTimer timer(m_Instrumentation, MontageInstrumentation::StageEnum::TileRead);
       RegionType regionToRead = result->GetLargestPossibleRegion();
       if (region.GetNumberOfPixels() > 0)
       {
@@ -155,6 +260,13 @@ TileMontage<TImageType, TCoordinate>::GetImageHelper(TileIndexType nDIndex, bool
         result->SetRequestedRegion(regionToRead);
       }
       iReader->Update();
+      if (m_Instrumentation)
+      {
+        m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::TilesRead);
+        m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::BytesRead,
+                                     result->GetPixelContainer()->Size() *
+                                       sizeof(typename TImageToRead::InternalPixelType));
+      }
     }
     result->DisconnectPipeline();
   }
@@ -181,18 +293,43 @@ TileMontage<TImageType, TCoordinate>::GetImage(TileIndexType nDIndex, bool metad
   RegionType                  reg0; // default-initialized to zeroes
   SizeValueType               linearIndex = this->nDIndexToLinearIndex(nDIndex);
   std::lock_guard<std::mutex> lockGuard(m_TileReadLocks[linearIndex]);
-  // if we are not cropping to overlap, FFTCache will kick in later
-  // and we don't want to double-cache the input tiles
-  if (!m_CropToOverlap && m_Tiles[linearIndex].IsNotNull())
+  // only preprocessed tiles are cached, as the others are cheap to get again,
+  // and if we are not cropping to overlap, FFTCache will kick in anyway
+  if (m_Tiles[linearIndex].IsNotNull())
   {
-    RegionType r = m_Tiles[linearIndex]->GetBufferedRegion();
-    if (metadataOnly || r.GetNumberOfPixels() > 0)
+    if (m_Instrumentation)
     {
-      return m_Tiles[linearIndex];
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::TileCacheHits);
     }
+    return m_Tiles[linearIndex];
+  }
+
+  if (metadataOnly)
+  {
+    return GetImageHelper<ImageType>(nDIndex, true, reg0);
+  }
+  if (!m_TilePreprocessor)
+  {
+    ImagePointer image = GetImageHelper<ImageType>(nDIndex, false, reg0);
+    this->ComputeTileInformation(linearIndex, image); // the lock makes sure it is computed only once
+    return image;
   }
 
-  return GetImageHelper<ImageType>(nDIndex, metadataOnly, reg0);
+  // the lock makes sure each tile is preprocessed only once
+  ImagePointer image = GetImageHelper<ImageType>(nDIndex, false, reg0);
+  {
+    MontageInstrumentation::ScopedStageTimer timer(m_Instrumentation,
+                                                   MontageInstrumentation::StageEnum::TilePreprocessing);
+    m_Tiles[linearIndex] = m_TilePreprocessor(image, linearIndex);
+  }
+  itkAssertOrThrowMacro(m_Tiles[linearIndex].IsNotNull(), "Tile preprocessor returned a null image");
+  if (m_Instrumentation)
+  {
+    m_Instrumentation->AddMemory(MontageInstrumentation::MemoryCategoryEnum::Tiles,
+                                 MontageInstrumentation::GetBufferBytes(m_Tiles[linearIndex].GetPointer()));
+  }
+  this->ComputeTileInformation(linearIndex, m_Tiles[linearIndex]);
+  return m_Tiles[linearIndex];
 }
 
 template <typename TImageType, typename TCoordinate>
@@ -230,16 +367,193 @@ TileMontage<TImageType, TCoordinate>::LinearIndexTonDIndex(DataObject::DataObjec
 
 template <typename TImageType, typename TCoordinate>
 void
-TileMontage<TImageType, TCoordinate>::RegisterPair(TileIndexType fixed, TileIndexType moving)
+TileMontage<TImageType, TCoordinate>::DeterminePairs()
+{
+  m_Pairs.clear();
+  m_GridPairs = false;
+  if (!m_TilePairs.empty())
+  {
+    for (const TilePairType & pair : m_TilePairs)
+    {
+      itkAssertOrThrowMacro(pair.first < m_LinearMontageSize && pair.second < m_LinearMontageSize,
+                            "Tile pair (" << pair.first << ", " << pair.second << ") exceeds montage size "
+                                          << m_LinearMontageSize);
+      itkAssertOrThrowMacro(pair.first != pair.second, "Tile " << pair.first << " is paired with itself");
+    }
+    m_Pairs = m_TilePairs;
+  }
+  else if (m_MinimumOverlap > 0.0)
+  {
+    m_Pairs = this->FindOverlappingPairs();
+  }
+  else // each tile and its predecessor along each dimension
+  {
+    m_GridPairs = true;
+    for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+    {
+      const TileIndexType ind = this->LinearIndexTonDIndex(i);
+      SizeValueType       stride = 1u;
+      for (unsigned d = 0; d < ImageDimension; d++)
+      {
+        if (ind[d] > 0)
+        {
+          m_Pairs.emplace_back(i - stride, i);
+        }
+        stride *= m_MontageSize[d];
+      }
+    }
+  }
+
+  // a tile's job registers all the pairs it completes
+  std::stable_sort(m_Pairs.begin(), m_Pairs.end(), [](const TilePairType & a, const TilePairType & b) {
+    return std::max(a.first, a.second) < std::max(b.first, b.second);
+  });
+
+  m_NumberOfPairs = m_Pairs.size();
+  m_TransformCandidates.assign(m_NumberOfPairs, OffsetVector());
+  m_CandidateConfidences.assign(m_NumberOfPairs, ConfidencesType());
+  m_LowInformation.assign(m_NumberOfPairs, 0);
+}
+
+template <typename TImageType, typename TCoordinate>
+typename TileMontage<TImageType, TCoordinate>::TilePairsType
+TileMontage<TImageType, TCoordinate>::FindOverlappingPairs()
 {
-  SizeValueType lFixedInd = nDIndexToLinearIndex(fixed);
-  SizeValueType lMovingInd = nDIndexToLinearIndex(moving);
+  // axis-aligned bounding boxes of tiles, in physical space
+  std::vector<PointType> minCorners(m_LinearMontageSize);
+  std::vector<PointType> maxCorners(m_LinearMontageSize);
+  PointType              globalMin;
+  globalMin.Fill(NumericTraits<typename PointType::ValueType>::max());
+  SpacingType cellSize;
+  cellSize.Fill(0.0);
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    const ImagePointer tile = this->GetImage(this->LinearIndexTonDIndex(i), true);
+    const RegionType   region = tile->GetLargestPossibleRegion();
+    ImageIndexType     ind = region.GetIndex();
+    PointType          p0, p1;
+    tile->TransformIndexToPhysicalPoint(ind, p0);
+    ind += region.GetSize();
+    tile->TransformIndexToPhysicalPoint(ind, p1);
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      minCorners[i][d] = std::min(p0[d], p1[d]);
+      maxCorners[i][d] = std::max(p0[d], p1[d]);
+      globalMin[d] = std::min(globalMin[d], minCorners[i][d]);
+      cellSize[d] = std::max(cellSize[d], maxCorners[i][d] - minCorners[i][d]);
+    }
+  }
+
+  // with cells as big as the biggest tile, overlapping tiles are in the same or adjacent cells
+  auto cellOf = [&](SizeValueType tile) {
+    TileIndexType cell;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      cell[d] = static_cast<SizeValueType>((minCorners[tile][d] - globalMin[d]) / cellSize[d]);
+    }
+    return cell;
+  };
+  SizeType cellCounts;
+  cellCounts.Fill(1);
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    const TileIndexType cell = cellOf(i);
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      cellCounts[d] = std::max<SizeValueType>(cellCounts[d], cell[d] + 2); // a spare cell on the high side
+    }
+  }
+  auto linearCell = [&cellCounts](const TileIndexType & cell) {
+    SizeValueType linear = 0;
+    SizeValueType stride = 1u;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      linear += cell[d] * stride;
+      stride *= cellCounts[d];
+    }
+    return linear;
+  };
+  std::unordered_map<SizeValueType, std::vector<SizeValueType>> cells;
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    cells[linearCell(cellOf(i))].push_back(i);
+  }
+
+  TilePairsType pairs;
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    const TileIndexType cell = cellOf(i);
+    double              volumeI = 1.0;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      volumeI *= maxCorners[i][d] - minCorners[i][d];
+    }
+    SizeValueType neighborCount = 1u;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      neighborCount *= 3;
+    }
+    for (SizeValueType n = 0; n < neighborCount; n++) // cells offset by -1, 0 or +1 along each dimension
+    {
+      TileIndexType neighbor = cell;
+      SizeValueType code = n;
+      bool          valid = true;
+      for (unsigned d = 0; d < ImageDimension; d++)
+      {
+        const IndexValueType c = static_cast<IndexValueType>(cell[d]) + static_cast<IndexValueType>(code % 3) - 1;
+        code /= 3;
+        if (c < 0 || c >= static_cast<IndexValueType>(cellCounts[d]))
+        {
+          valid = false;
+          break;
+        }
+        neighbor[d] = c;
+      }
+      if (!valid)
+      {
+        continue;
+      }
+      auto it = cells.find(linearCell(neighbor));
+      if (it == cells.end())
+      {
+        continue;
+      }
+      for (SizeValueType j : it->second)
+      {
+        if (j <= i)
+        {
+          continue; // each pair once
+        }
+        double overlap = 1.0;
+        double volumeJ = 1.0;
+        for (unsigned d = 0; d < ImageDimension; d++)
+        {
+          const double extent =
+            std::min(maxCorners[i][d], maxCorners[j][d]) - std::max(minCorners[i][d], minCorners[j][d]);
+          overlap *= std::max(0.0, extent);
+          volumeJ *= maxCorners[j][d] - minCorners[j][d];
+        }
+        if (overlap > 0.0 && overlap >= m_MinimumOverlap * std::min(volumeI, volumeJ))
+        {
+          pairs.emplace_back(i, j);
+        }
+      }
+    }
+  }
+  return pairs;
+}
 
+template <typename TImageType, typename TCoordinate>
+typename TileMontage<TImageType, TCoordinate>::PCMType::Pointer
+TileMontage<TImageType, TCoordinate>::CreateRegistrationMethod(bool cheap) const
+{
   typename PCMType::Pointer          m_PCM = PCMType::New();
   typename PCMOperatorType::Pointer  m_PCMOperator = PCMOperatorType::New();
   typename PCMOptimizerType::Pointer m_PCMOptimizer = PCMOptimizerType::New();
+  m_PCM->SetFFTBackend(m_FFTBackend);
   m_PCM->SetPaddingMethod(m_PaddingMethod);
   m_PCM->SetCropToOverlap(m_CropToOverlap);
+  m_PCM->SetRegistrationChannel(m_RegistrationChannel);
   m_PCM->SetOperator(m_PCMOperator);
   m_PCM->SetOptimizer(m_PCMOptimizer);
   m_PCM->SetObligatoryPadding(m_ObligatoryPadding);
@@ -247,201 +561,646 @@ TileMontage<TImageType, TCoordinate>::RegisterPair(TileIndexType fixed, TileInde
   m_PCM->SetReleaseDataBeforeUpdateFlag(this->GetReleaseDataBeforeUpdateFlag());
   m_PCMOptimizer->SetPixelDistanceTolerance(m_PositionTolerance);
   m_PCMOptimizer->SetPeakInterpolationMethod(m_PeakInterpolationMethod);
+  m_PCMOptimizer->SetUpsamplingFactor(m_UpsamplingFactor);
+  m_PCM->SetInstrumentation(m_Instrumentation);
+  if (cheap)
+  {
+    m_PCM->SetPaddingMethod(PCMType::PaddingMethodEnum::Zero);
+    m_PCM->SetObligatoryPadding(SizeType::Filled(0));
+    m_PCM->SetOffsetCount(2); // the second peak tells whether the first one is ambiguous
+    if (m_PeakInterpolationMethod != PCMOptimizerType::PeakInterpolationMethodEnum::None)
+    {
+      m_PCMOptimizer->SetPeakInterpolationMethod(PCMOptimizerType::PeakInterpolationMethodEnum::Parabolic);
+    }
+  }
+  return m_PCM;
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::RegisterPair(SizeValueType pairIndex, bool cheap)
+{
+  const SizeValueType lFixedInd = m_Pairs[pairIndex].first;
+  const SizeValueType lMovingInd = m_Pairs[pairIndex].second;
+  const TileIndexType fixed = this->LinearIndexTonDIndex(lFixedInd);
+  const TileIndexType moving = this->LinearIndexTonDIndex(lMovingInd);
 
+  MontageBufferPool::Scope  poolScope(m_BufferPooling); // images of this pair draw from the pool
+  typename PCMType::Pointer m_PCM = this->CreateRegistrationMethod(cheap);
+  const bool                useFFTCache = !m_CropToOverlap && !cheap; // cheap spectra differ from the full ones
+  if (MontageNUMA::GetBoundNode() >= 0)
+  {
+    // threads of nested parallel work are not bound, and would first-touch buffers on other nodes
+    m_PCM->SetNumberOfWorkUnits(1);
+  }
+
+  // time to get the tiles, including waiting for other threads to read or preprocess them
+  MontageInstrumentation::StageTimes       pairTimes{};
+  MontageInstrumentation::ScopedStageTimer tileTimer(
+    nullptr, MontageInstrumentation::StageEnum::TileRead, m_Instrumentation ? &pairTimes : nullptr);
+  auto fImage = this->GetImage(fixed, false);
   auto mImage = this->GetImage(moving, false);
-  m_PCM->SetFixedImage(this->GetImage(fixed, false));
+  m_PCM->SetFixedImage(fImage);
   m_PCM->SetMovingImage(mImage);
-  // scoping the lock
+  tileTimer.Stop();
+
+  // blank or low-texture overlaps yield spurious peaks, so such pairs are not registered
+  if (m_InformationThreshold > 0.0 &&
+      std::min(this->ComputeOverlapInformation(lFixedInd, fImage, mImage),
+               this->ComputeOverlapInformation(lMovingInd, mImage, fImage)) < m_InformationThreshold)
+  {
+    m_LowInformation[pairIndex] = 1;
+    m_TransformCandidates[pairIndex].assign(1, TranslationOffset(0.0)); // stage position
+    m_CandidateConfidences[pairIndex].assign(1, 1.0f); // weight is set by OptimizeTiles()
+    if (m_Instrumentation)
+    {
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::LowInformationPairs);
+    }
+    return;
+  }
+
+  // tiles read from files or obtained from the tile source just for this pair,
+  // preprocessed ones are accounted by GetImage()
+  using MemoryCategoryEnum = MontageInstrumentation::MemoryCategoryEnum;
+  SizeValueType pairTileBytes = 0;
+  if (m_Instrumentation && !m_TilePreprocessor)
+  {
+    if (this->IsTileOwned(lFixedInd))
+    {
+      pairTileBytes += MontageInstrumentation::GetBufferBytes(fImage.GetPointer());
+    }
+    if (this->IsTileOwned(lMovingInd))
+    {
+      pairTileBytes += MontageInstrumentation::GetBufferBytes(mImage.GetPointer());
+    }
+    m_Instrumentation->AddMemory(MemoryCategoryEnum::Tiles, pairTileBytes);
+  }
+  if (useFFTCache)
   {
     std::lock_guard<std::mutex> lock(m_MemberProtector);
     m_PCM->SetFixedImageFFT(m_FFTCache[lFixedInd]);   // maybe null
     m_PCM->SetMovingImageFFT(m_FFTCache[lMovingInd]); // maybe null
+    if (m_Instrumentation)
+    {
+      const SizeValueType hits = (m_FFTCache[lFixedInd] != nullptr) + (m_FFTCache[lMovingInd] != nullptr);
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::FFTCacheHits, hits);
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::FFTCacheMisses, 2 - hits);
+    }
   }
   // m_PCM->DebugOn();
   m_PCM->Update();
 
-  if (!m_CropToOverlap)
+  if (m_Instrumentation)
+  {
+    for (unsigned i = 0; i < MontageInstrumentation::NumberOfStages; i++)
+    {
+      pairTimes[i] += m_PCM->GetStageTimes()[i];
+    }
+    m_Instrumentation->AddPairRecord(lFixedInd, lMovingInd, pairTimes);
+    m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::PairsRegistered);
+  }
+
+  if (useFFTCache)
   {
     std::lock_guard<std::mutex> lock(m_MemberProtector);
+    if (m_Instrumentation)
+    {
+      m_Instrumentation->RemoveMemory(MemoryCategoryEnum::FFTCache,
+                                      MontageInstrumentation::GetBufferBytes(m_FFTCache[lFixedInd].GetPointer()) +
+                                        MontageInstrumentation::GetBufferBytes(m_FFTCache[lMovingInd].GetPointer()));
+    }
     m_FFTCache[lFixedInd] = m_PCM->GetFixedImageFFT();   // certainly not null
     m_FFTCache[lMovingInd] = m_PCM->GetMovingImageFFT(); // certrainly not null
+    if (m_Instrumentation)
+    {
+      m_Instrumentation->AddMemory(MemoryCategoryEnum::FFTCache,
+                                   MontageInstrumentation::GetBufferBytes(m_FFTCache[lFixedInd].GetPointer()) +
+                                     MontageInstrumentation::GetBufferBytes(m_FFTCache[lMovingInd].GetPointer()));
+    }
   }
 
-  const typename PCMType::OffsetVector & offsets = m_PCM->GetOffsets();
-  SizeValueType                          regLinearIndex = lMovingInd;
-  for (unsigned d = 0; d < ImageDimension; d++)
+  // buffers of this pair are held until m_PCM goes out of scope
+  SizeValueType registrationBytes = 0;
+  SizeValueType surfaceBytes = 0;
+  if (m_Instrumentation)
   {
-    if (fixed[d] != moving[d]) // this is the different dimension
+    registrationBytes = m_PCM->GetInternalBufferBytes();
+    if (useFFTCache) // spectra are accounted in the FFT cache
     {
-      regLinearIndex += d * m_LinearMontageSize;
-      break;
+      registrationBytes -= std::min(registrationBytes,
+                                    MontageInstrumentation::GetBufferBytes(m_PCM->GetFixedImageFFT()) +
+                                      MontageInstrumentation::GetBufferBytes(m_PCM->GetMovingImageFFT()));
     }
+    surfaceBytes = MontageInstrumentation::GetBufferBytes(m_PCM->GetPhaseCorrelationImage());
+    m_Instrumentation->AddMemory(MemoryCategoryEnum::RegistrationBuffers, registrationBytes);
+    m_Instrumentation->AddMemory(MemoryCategoryEnum::CorrelationSurface, surfaceBytes);
   }
 
-  m_CandidateConfidences[regLinearIndex] = m_PCM->GetConfidences();
-  m_TransformCandidates[regLinearIndex].resize(offsets.size());
+  const typename PCMType::OffsetVector & offsets = m_PCM->GetOffsets();
+  m_CandidateConfidences[pairIndex] = m_PCM->GetConfidences();
+  m_TransformCandidates[pairIndex].resize(offsets.size());
   PointType p0;
   p0.Fill(0.0);
   for (unsigned i = 0; i < offsets.size(); i++)
   {
-    m_TransformCandidates[regLinearIndex][i] = offsets[i] - p0;
+    m_TransformCandidates[pairIndex][i] = offsets[i] - p0;
+  }
+
+  if (m_Instrumentation)
+  {
+    m_Instrumentation->RemoveMemory(MemoryCategoryEnum::Tiles, pairTileBytes);
+    m_Instrumentation->RemoveMemory(MemoryCategoryEnum::RegistrationBuffers, registrationBytes);
+    m_Instrumentation->RemoveMemory(MemoryCategoryEnum::CorrelationSurface, surfaceBytes);
   }
 }
 
 template <typename TImageType, typename TCoordinate>
 void
-TileMontage<TImageType, TCoordinate>::ReleaseMemory(TileIndexType finishedTile)
+TileMontage<TImageType, TCoordinate>::SetPairCandidates(SizeValueType           pairIndex,
+                                                        const OffsetVector &    offsets,
+                                                        const ConfidencesType & confidences)
+{
+  itkAssertOrThrowMacro(pairIndex < m_Pairs.size(), "Pair index " << pairIndex << " exceeds " << m_Pairs.size());
+  itkAssertOrThrowMacro(offsets.size() == confidences.size(), "Each offset candidate needs a confidence");
+  m_TransformCandidates[pairIndex] = offsets;
+  m_CandidateConfidences[pairIndex] = confidences;
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::ComputeTileInformation(SizeValueType linearIndex, const ImageType * tile)
 {
-  TileIndexType oldIndex;
-  bool          releaseTile = true;
-  for (unsigned dim = 0; dim < ImageDimension; dim++)
+  TileInformation & information = m_TileInformation[linearIndex];
+  if (m_InformationThreshold <= 0.0 || !information.m_Sums.empty())
   {
-    if (finishedTile[dim] > 0)
-    {
-      oldIndex[dim] = finishedTile[dim] - 1;
-    }
-    else
-    {
-      releaseTile = false;
-    }
+    return;
   }
-  if (releaseTile)
+
+  const RegionType region = tile->GetBufferedRegion();
+  SizeValueType    blockStrides[ImageDimension];
+  SizeValueType    numberOfBlocks = 1;
+  for (unsigned d = 0; d < ImageDimension; d++)
   {
-    SizeValueType               linearIndex = this->nDIndexToLinearIndex(oldIndex);
-    std::lock_guard<std::mutex> lock(m_MemberProtector);
-    m_FFTCache[linearIndex] = nullptr;
-    if (!m_Filenames[linearIndex].empty()) // release the input image too
+    blockStrides[d] = numberOfBlocks;
+    numberOfBlocks *= (region.GetSize(d) + InformationBlockSize - 1) / InformationBlockSize;
+  }
+  information.m_Region = region;
+  information.m_Sums.assign(numberOfBlocks, 0.0);
+  information.m_Counts.assign(numberOfBlocks, 0);
+
+  // forward differences along each dimension, iterating the tile without its last slice and the shifted tile
+  Accessor::LuminancePixelAccessor<typename ImageType::PixelType, double> accessor;
+  accessor.SetChannel(m_RegistrationChannel);
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    if (region.GetSize(d) < 2)
     {
-      this->SetInputTile(oldIndex, m_Dummy);
+      continue;
     }
-    if (m_Tiles[linearIndex])
+    RegionType current = region;
+    current.SetSize(d, region.GetSize(d) - 1);
+    RegionType next = current;
+    next.SetIndex(d, current.GetIndex(d) + 1);
+
+    ImageScanlineConstIterator<ImageType> cIt(tile, current);
+    ImageScanlineConstIterator<ImageType> nIt(tile, next);
+    while (!cIt.IsAtEnd())
     {
-      RegionType reg0;
-      m_Tiles[linearIndex]->SetBufferedRegion(reg0);
-      m_Tiles[linearIndex]->Allocate(false);
+      const ImageIndexType ind = cIt.GetIndex();
+      SizeValueType        lineBlock = 0;
+      for (unsigned i = 1; i < ImageDimension; i++)
+      {
+        lineBlock += (ind[i] - region.GetIndex(i)) / InformationBlockSize * blockStrides[i];
+      }
+      for (SizeValueType x = ind[0] - region.GetIndex(0); !cIt.IsAtEndOfLine(); ++cIt, ++nIt, ++x)
+      {
+        const double        difference = accessor.Get(nIt.Get()) - accessor.Get(cIt.Get());
+        const SizeValueType block = lineBlock + x / InformationBlockSize;
+        information.m_Sums[block] += difference * difference;
+        ++information.m_Counts[block];
+      }
+      cIt.NextLine();
+      nIt.NextLine();
     }
   }
 }
 
 template <typename TImageType, typename TCoordinate>
-void
-TileMontage<TImageType, TCoordinate>::WriteOutTransform(TileIndexType index, TranslationOffset offset)
+double
+TileMontage<TImageType, TCoordinate>::ComputeOverlapInformation(SizeValueType     linearIndex,
+                                                                const ImageType * tile,
+                                                                const ImageType * other) const
 {
-  TransformPointer transform = TransformType::New();
-  transform->SetOffset(offset);
-  const SizeValueType linearIndex = this->nDIndexToLinearIndex(index);
-  auto                dOut = this->GetOutput(linearIndex);
-  const auto          cOut = static_cast<TransformOutputType *>(dOut);
-  auto                decorator = const_cast<TransformOutputType *>(cOut);
-  decorator->Set(transform);
-  auto input0 = static_cast<const ImageType *>(this->GetInput(0));
-  auto input = static_cast<const ImageType *>(this->GetInput(linearIndex));
-  this->UpdateMosaicBounds(index, transform, input, input0);
-}
+  // expected overlap in tile's index space, as determined by PhaseCorrelationImageRegistrationMethod
+  const TileInformation & information = m_TileInformation[linearIndex];
+  RegionType              region = information.m_Region;
+  RegionType              otherRegion = other->GetLargestPossibleRegion();
+  ImageIndexType          otherIndex = otherRegion.GetIndex();
+  const SpacingType       spacing = tile->GetSpacing();
+  const auto              originShift = other->GetOrigin() - tile->GetOrigin();
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    otherIndex[d] += std::round(originShift[d] / spacing[d]);
+  }
+  otherRegion.SetIndex(otherIndex);
+  if (information.m_Sums.empty() || !region.Crop(otherRegion))
+  {
+    return 0.0;
+  }
 
-template <typename TImageType, typename TCoordinate>
-void
-TileMontage<TImageType, TCoordinate>::UpdateMosaicBounds(TileIndexType         index,
-                                                         TransformConstPointer transform,
-                                                         const ImageType *     input,
-                                                         const ImageType *     input0)
-{
-  PointType           p;
-  ContinuousIndexType ci;
-  ImageIndexType      ind = input->GetLargestPossibleRegion().GetIndex();
-  input->TransformIndexToPhysicalPoint(ind, p);
-  TransformPointer inverseT = TransformType::New();
-  transform->GetInverse(inverseT);
-  p = inverseT->TransformPoint(p);
-  input0->TransformPhysicalPointToContinuousIndex(p, ci);
+  // range of the covered blocks, and the fraction of each block's pixels which are covered
+  SizeValueType                    firstBlock[ImageDimension];
+  SizeValueType                    lastBlock[ImageDimension];
+  SizeValueType                    blockStrides[ImageDimension];
+  std::vector<std::vector<double>> coverage(ImageDimension);
+  SizeValueType                    stride = 1;
   for (unsigned d = 0; d < ImageDimension; d++)
   {
-    if (index[d] == 0) // this tile is on the minimum edge
+    const IndexValueType tileStart = information.m_Region.GetIndex(d);
+    const IndexValueType tileEnd = tileStart + static_cast<IndexValueType>(information.m_Region.GetSize(d));
+    const IndexValueType start = region.GetIndex(d);
+    const IndexValueType end = start + static_cast<IndexValueType>(region.GetSize(d));
+    firstBlock[d] = (start - tileStart) / InformationBlockSize;
+    lastBlock[d] = (end - 1 - tileStart) / InformationBlockSize;
+    blockStrides[d] = stride;
+    stride *= (information.m_Region.GetSize(d) + InformationBlockSize - 1) / InformationBlockSize;
+    for (SizeValueType b = firstBlock[d]; b <= lastBlock[d]; b++)
     {
-      m_MinInner[d] = std::max(m_MinInner[d], ci[d]);
-      m_MinOuter[d] = std::min(m_MinOuter[d], ci[d]);
+      const IndexValueType blockStart = tileStart + static_cast<IndexValueType>(b * InformationBlockSize);
+      const IndexValueType blockEnd =
+        std::min<IndexValueType>(blockStart + static_cast<IndexValueType>(InformationBlockSize), tileEnd);
+      const IndexValueType covered = std::min(blockEnd, end) - std::max(blockStart, start);
+      coverage[d].push_back(double(covered) / (blockEnd - blockStart));
     }
   }
-  ind += input->GetLargestPossibleRegion().GetSize();
-  input->TransformIndexToPhysicalPoint(ind, p);
-  p = inverseT->TransformPoint(p);
-  input0->TransformPhysicalPointToContinuousIndex(p, ci);
-  for (unsigned d = 0; d < ImageDimension; d++)
+
+  double        sum = 0.0;
+  double        count = 0.0;
+  SizeValueType block[ImageDimension];
+  std::copy(firstBlock, firstBlock + ImageDimension, block);
+  while (true)
   {
-    if (index[d] == m_MontageSize[d] - 1) // this tile is on the maximum edge
+    SizeValueType linearBlock = 0;
+    double        fraction = 1.0;
+    for (unsigned d = 0; d < ImageDimension; d++)
     {
-      m_MaxOuter[d] = std::max(m_MaxOuter[d], ci[d]);
-      m_MaxInner[d] = std::min(m_MaxInner[d], ci[d]);
+      linearBlock += block[d] * blockStrides[d];
+      fraction *= coverage[d][block[d] - firstBlock[d]];
+    }
+    sum += fraction * information.m_Sums[linearBlock];
+    count += fraction * information.m_Counts[linearBlock];
+
+    unsigned d = 0;
+    while (d < ImageDimension && block[d] == lastBlock[d])
+    {
+      block[d] = firstBlock[d];
+      ++d;
+    }
+    if (d == ImageDimension)
+    {
+      break;
     }
+    ++block[d];
   }
+  return count > 0.0 ? sum * ImageDimension / count : 0.0;
 }
 
 template <typename TImageType, typename TCoordinate>
 void
-TileMontage<TImageType, TCoordinate>::GenerateOutputInformation()
+TileMontage<TImageType, TCoordinate>::ReleaseMemory(SizeValueType pairIndex, bool cheap)
 {
-  Superclass::GenerateOutputInformation();
-  for (SizeValueType i = 1; i < m_LinearMontageSize; i++)
+  std::lock_guard<std::mutex> lock(m_MemberProtector);
+  for (SizeValueType linearIndex : { m_Pairs[pairIndex].first, m_Pairs[pairIndex].second })
   {
-    this->SetNthOutput(i, this->MakeOutput(i).GetPointer());
+    if (--m_RemainingPairs[linearIndex] == 0)
+    {
+      // the preprocessor is invoked only once per tile, so escalation needs the preprocessed tile
+      const bool keepPreprocessed = cheap && m_TilePreprocessor;
+      this->ReleaseCachedTile(linearIndex, keepPreprocessed);
+      if (!keepPreprocessed && !m_Filenames[linearIndex].empty()) // release the input image too
+      {
+        this->SetInputTile(linearIndex, m_Dummy);
+      }
+    }
   }
 }
 
 template <typename TImageType, typename TCoordinate>
 void
-TileMontage<TImageType, TCoordinate>::OptimizeTiles()
+TileMontage<TImageType, TCoordinate>::ReleaseCachedTile(SizeValueType linearIndex, bool keepPreprocessed)
 {
-  // formulate global optimization as an overdetermined linear system
-  constexpr unsigned Dimension = ImageDimension;
-  using SparseMatrix = Eigen::SparseMatrix<TCoordinate, Eigen::RowMajor>;
-  SparseMatrix regCoef(m_NumberOfPairs + 1, m_LinearMontageSize);
-  regCoef.reserve(Eigen::VectorXi::Constant(m_NumberOfPairs + 1, 2)); // 2 non-zeroes per row
-  using TranslationsMatrix = Eigen::Matrix<TCoordinate, Eigen::Dynamic, Dimension>;
-  TranslationsMatrix         translations(m_NumberOfPairs + 1, Dimension);
-  std::vector<SizeValueType> equationToCandidate(m_NumberOfPairs);
-  SizeValueType              regIndex = 0;
-  double                     confidenceTotal = 0.0;
-  for (SizeValueType i = 0; i < m_LinearMontageSize * ImageDimension; i++)
+  if (m_Instrumentation)
   {
-    if (!m_TransformCandidates[i].empty())
+    using MemoryCategoryEnum = MontageInstrumentation::MemoryCategoryEnum;
+    m_Instrumentation->RemoveMemory(MemoryCategoryEnum::FFTCache,
+                                    MontageInstrumentation::GetBufferBytes(m_FFTCache[linearIndex].GetPointer()));
+    if (!keepPreprocessed)
     {
-      SizeValueType linIndex = i % m_LinearMontageSize;
-      TileIndexType currentIndex = this->LinearIndexTonDIndex(linIndex);
-      TileIndexType referenceIndex = currentIndex;
-      unsigned      dim = i / m_LinearMontageSize;
-      referenceIndex[dim] = currentIndex[dim] - 1;
-      SizeValueType refLinearIndex = this->nDIndexToLinearIndex(referenceIndex);
-
-      // construct equation: -c*refLinearIndex + c*linIndex = c*candidateOffset, c=confidence
-      const float & confidence = m_CandidateConfidences[i][0];
-      regCoef.insert(regIndex, refLinearIndex) = -confidence;
-      regCoef.insert(regIndex, linIndex) = confidence;
-      const TranslationOffset & candidateOffset = m_TransformCandidates[i][0];
-      for (unsigned d = 0; d < ImageDimension; d++)
-      {
-        translations(regIndex, d) = confidence * candidateOffset[d];
-      }
-      equationToCandidate[regIndex] = i;
-      ++regIndex;
-      assert(m_CandidateConfidences[i][0] > 0);
-      confidenceTotal += m_CandidateConfidences[i][0];
+      m_Instrumentation->RemoveMemory(MemoryCategoryEnum::Tiles,
+                                      MontageInstrumentation::GetBufferBytes(m_Tiles[linearIndex].GetPointer()));
     }
   }
-  TCoordinate confidenceAvg = confidenceTotal / m_NumberOfPairs;
-  assert(regIndex == m_NumberOfPairs);
+  m_FFTCache[linearIndex] = nullptr;
+  if (!keepPreprocessed)
+  {
+    m_Tiles[linearIndex] = nullptr; // preprocessed tile
+    m_TileInformation[linearIndex] = TileInformation();
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+MontageInstrumentation::MemoryBytes
+TileMontage<TImageType, TCoordinate>::EstimatePeakMemoryUsage()
+{
+  using MemoryCategoryEnum = MontageInstrumentation::MemoryCategoryEnum;
+  MontageInstrumentation::MemoryBytes estimate{};
+
+  this->DeterminePairs();
+  const SizeValueType numberOfPairs = m_Pairs.size();
+  if (numberOfPairs == 0)
+  {
+    return estimate;
+  }
+  const SizeValueType concurrentPairs = std::min<SizeValueType>(this->GetNumberOfWorkUnits(), numberOfPairs);
+
+  TileIndexType ind0;
+  ind0.Fill(0);
+  const ImagePointer  tile0 = this->GetImage(ind0, true);
+  const RegionType    region0 = tile0->GetLargestPossibleRegion();
+  const SizeType      tileSize = region0.GetSize();
+  const SizeValueType tileBytes = region0.GetNumberOfPixels() * sizeof(PixelType);
+  const SpacingType   spacing = tile0->GetSpacing();
 
-  regCoef.insert(regIndex, 0) = confidenceAvg; // tile 0,0...0
+  // a tile is released once all its pairs are registered, which in a grid
+  // means about one slab of tiles (all but the slowest dimension) is held at a time
+  const SizeValueType heldTiles = std::min<SizeValueType>(
+    m_LinearMontageSize, m_LinearMontageSize / m_MontageSize[ImageDimension - 1] + 1 + this->GetNumberOfWorkUnits());
+  if (m_TilePreprocessor)
+  {
+    estimate[static_cast<unsigned>(MemoryCategoryEnum::Tiles)] = heldTiles * tileBytes;
+  }
+  else if (this->IsTileOwned(0)) // each pair reads its two tiles
+  {
+    estimate[static_cast<unsigned>(MemoryCategoryEnum::Tiles)] = 2 * concurrentPairs * tileBytes;
+  }
+
+  // FFT size of the most demanding pair, determined as in PCMType::DeterminePadding()
+  typename PCMType::Pointer pcm = PCMType::New();
+  SizeType                  fftSize;
+  SizeValueType             fftPixels = 0;
+  SizeValueType             cropPixels = 0;
   for (unsigned d = 0; d < ImageDimension; d++)
   {
-    translations(regIndex, d) = 0; // should have position 0,0...0
+    if (m_MontageSize[d] < 2)
+    {
+      continue;
+    }
+    SizeType iSize = tileSize;
+    if (m_CropToOverlap)
+    {
+      TileIndexType ind1 = ind0;
+      ind1[d] = 1;
+      const ImagePointer tile1 = this->GetImage(ind1, true);
+      const auto         shift =
+        static_cast<IndexValueType>(std::abs(std::round((tile1->GetOrigin()[d] - tile0->GetOrigin()[d]) / spacing[d])));
+      iSize[d] = std::max<IndexValueType>(1, static_cast<IndexValueType>(tileSize[d]) - shift);
+      // a pair whose peak is near the edge of the reduced expansion is registered again with the usual one
+      const SizeValueType expansion = std::max(PCMType::GetOverlapExpansion(iSize[d], tileSize[d], m_PositionTolerance),
+                                               PCMType::GetOverlapExpansion(iSize[d], tileSize[d], 0));
+      iSize[d] = std::min(tileSize[d], iSize[d] + expansion);
+    }
+    SizeType pSize;
+    for (unsigned k = 0; k < ImageDimension; k++)
+    {
+      pSize[k] = iSize[k] + 2 * m_ObligatoryPadding[k];
+    }
+    pSize = pcm->RoundUpToFFTSize(pSize);
+    SizeValueType pPixels = 1;
+    SizeValueType iPixels = 1;
+    for (unsigned k = 0; k < ImageDimension; k++)
+    {
+      pPixels *= pSize[k];
+      iPixels *= iSize[k];
+    }
+    if (pPixels > fftPixels)
+    {
+      fftPixels = pPixels;
+      fftSize = pSize;
+      cropPixels = m_CropToOverlap ? iPixels : 0;
+    }
+  }
+
+  // real-to-complex FFTs keep only half of the first dimension
+  const SizeValueType halfPixels = fftPixels / fftSize[0] * (fftSize[0] / 2 + 1);
+  const SizeValueType realBytes = sizeof(RealType);
+  const SizeValueType complexBytes = 2 * realBytes;
+  const SizeValueType spectraBytes = 2 * halfPixels * complexBytes; // fixed and moving
+  SizeValueType       perPair = 2 * cropPixels * sizeof(PixelType) // cropped tiles
+                          + 2 * fftPixels * realBytes           // padded tiles
+                          + 2 * halfPixels * complexBytes       // operator and band-pass outputs
+                          + fftPixels * realBytes;              // optimizer's adjusted correlation image
+  if (m_CropToOverlap)
+  {
+    perPair += spectraBytes;
+  }
+  else // spectra are kept in the FFT cache instead
+  {
+    estimate[static_cast<unsigned>(MemoryCategoryEnum::FFTCache)] = heldTiles * halfPixels * complexBytes;
+  }
+  estimate[static_cast<unsigned>(MemoryCategoryEnum::RegistrationBuffers)] = concurrentPairs * perPair;
+  estimate[static_cast<unsigned>(MemoryCategoryEnum::CorrelationSurface)] = concurrentPairs * fftPixels * realBytes;
+  return estimate;
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::WriteOutTransform(TileIndexType index, TranslationOffset offset)
+{
+  TransformPointer transform = TransformType::New();
+  transform->SetOffset(offset);
+  const SizeValueType linearIndex = this->nDIndexToLinearIndex(index);
+  auto                dOut = this->GetOutput(linearIndex);
+  const auto          cOut = static_cast<TransformOutputType *>(dOut);
+  auto                decorator = const_cast<TransformOutputType *>(cOut);
+  decorator->Set(transform);
+  auto input0 = static_cast<const ImageType *>(this->GetInput(0));
+  auto input = static_cast<const ImageType *>(this->GetInput(linearIndex));
+  this->UpdateMosaicBounds(index, transform, input, input0);
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::UpdateMosaicBounds(TileIndexType         index,
+                                                         TransformConstPointer transform,
+                                                         const ImageType *     input,
+                                                         const ImageType *     input0)
+{
+  PointType           p;
+  ContinuousIndexType ci;
+  ImageIndexType      ind = input->GetLargestPossibleRegion().GetIndex();
+  input->TransformIndexToPhysicalPoint(ind, p);
+  TransformPointer inverseT = TransformType::New();
+  transform->GetInverse(inverseT);
+  p = inverseT->TransformPoint(p);
+  input0->TransformPhysicalPointToContinuousIndex(p, ci);
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    if (!m_GridPairs) // tiles are not arranged in a grid, so any of them can be on the edge
+    {
+      m_MinOuter[d] = std::min(m_MinOuter[d], ci[d]);
+    }
+    else if (index[d] == 0) // this tile is on the minimum edge
+    {
+      m_MinInner[d] = std::max(m_MinInner[d], ci[d]);
+      m_MinOuter[d] = std::min(m_MinOuter[d], ci[d]);
+    }
+  }
+  ind += input->GetLargestPossibleRegion().GetSize();
+  input->TransformIndexToPhysicalPoint(ind, p);
+  p = inverseT->TransformPoint(p);
+  input0->TransformPhysicalPointToContinuousIndex(p, ci);
+  for (unsigned d = 0; d < ImageDimension; d++)
+  {
+    if (!m_GridPairs)
+    {
+      m_MaxOuter[d] = std::max(m_MaxOuter[d], ci[d]);
+    }
+    else if (index[d] == m_MontageSize[d] - 1) // this tile is on the maximum edge
+    {
+      m_MaxOuter[d] = std::max(m_MaxOuter[d], ci[d]);
+      m_MaxInner[d] = std::min(m_MaxInner[d], ci[d]);
+    }
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::GenerateOutputInformation()
+{
+  Superclass::GenerateOutputInformation();
+  for (SizeValueType i = 1; i < m_LinearMontageSize; i++)
+  {
+    this->SetNthOutput(i, this->MakeOutput(i).GetPointer());
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::OptimizeTiles(bool warmStart)
+{
+  // formulate global optimization as an overdetermined linear system
+  constexpr unsigned Dimension = ImageDimension;
+  std::vector<SizeValueType> equationToCandidate; // pairs with registration candidates
+  for (SizeValueType i = 0; i < m_TransformCandidates.size(); i++)
+  {
+    if (!m_TransformCandidates[i].empty())
+    {
+      equationToCandidate.push_back(i);
+    }
+  }
+  const SizeValueType nEquations = equationToCandidate.size();
+
+  // each connected group of tiles is anchored at its lowest-index tile
+  std::vector<SizeValueType> group(m_LinearMontageSize);
+  std::iota(group.begin(), group.end(), 0);
+  auto findRoot = [&group](SizeValueType tile) {
+    while (group[tile] != tile)
+    {
+      group[tile] = group[group[tile]]; // path halving
+      tile = group[tile];
+    }
+    return tile;
+  };
+  for (SizeValueType candidateIndex : equationToCandidate)
+  {
+    const SizeValueType a = findRoot(m_Pairs[candidateIndex].first);
+    const SizeValueType b = findRoot(m_Pairs[candidateIndex].second);
+    group[std::max(a, b)] = std::min(a, b);
+  }
+  std::vector<SizeValueType> anchors;
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    if (findRoot(i) == i)
+    {
+      anchors.push_back(i);
+    }
   }
 
-  typename ImageType::SpacingType spacing = this->GetImage(this->LinearIndexTonDIndex(0), true)->GetSpacing();
+  // formulate global optimization as an overdetermined linear system
+  using SparseMatrix = Eigen::SparseMatrix<TCoordinate, Eigen::RowMajor>;
+  const SizeValueType nRows = nEquations + anchors.size();
+  SparseMatrix        regCoef(nRows, m_LinearMontageSize);
+  regCoef.reserve(Eigen::VectorXi::Constant(nRows, 2)); // 2 non-zeroes per row
+  using TranslationsMatrix = Eigen::Matrix<TCoordinate, Eigen::Dynamic, Dimension>;
+  TranslationsMatrix translations(nRows, Dimension);
+  double             confidenceTotal = 0.0;
+  SizeValueType      nRegistered = 0; // equations which are not weak stage-position constraints
+  for (SizeValueType regIndex = 0; regIndex < nEquations; regIndex++)
+  {
+    const SizeValueType i = equationToCandidate[regIndex];
+    if (m_LowInformation[i])
+    {
+      continue; // inserted below, once the average confidence is known
+    }
+    const SizeValueType refLinearIndex = m_Pairs[i].first;
+    const SizeValueType linIndex = m_Pairs[i].second;
+
+    // construct equation: -c*refLinearIndex + c*linIndex = c*candidateOffset, c=confidence
+    const float & confidence = m_CandidateConfidences[i][0];
+    regCoef.insert(regIndex, refLinearIndex) = -confidence;
+    regCoef.insert(regIndex, linIndex) = confidence;
+    const TranslationOffset & candidateOffset = m_TransformCandidates[i][0];
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      translations(regIndex, d) = confidence * candidateOffset[d];
+    }
+    assert(m_CandidateConfidences[i][0] > 0);
+    confidenceTotal += m_CandidateConfidences[i][0];
+    ++nRegistered;
+  }
+  if (nEquations == 0) // nothing to optimize, all tiles keep their expected positions
+  {
+    for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+    {
+      m_CurrentAdjustments[i].Fill(0.0);
+    }
+    return;
+  }
+  TCoordinate confidenceAvg = nRegistered > 0 ? confidenceTotal / nRegistered : 1.0;
+
+  // low-information pairs weakly keep the expected positions, like exhausted outliers
+  for (SizeValueType regIndex = 0; regIndex < nEquations; regIndex++)
+  {
+    const SizeValueType i = equationToCandidate[regIndex];
+    if (m_LowInformation[i])
+    {
+      regCoef.insert(regIndex, m_Pairs[i].first) = -0.01 * confidenceAvg;
+      regCoef.insert(regIndex, m_Pairs[i].second) = 0.01 * confidenceAvg;
+      for (unsigned d = 0; d < ImageDimension; d++)
+      {
+        translations(regIndex, d) = 0;
+      }
+    }
+  }
+
+  for (SizeValueType a = 0; a < anchors.size(); a++)
+  {
+    regCoef.insert(nEquations + a, anchors[a]) = confidenceAvg; // e.g. tile 0,0...0
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      translations(nEquations + a, d) = 0; // should have its expected position
+    }
+  }
+
+  const SpacingType                                  spacing = this->GetTileSpacing();
   Eigen::LeastSquaresConjugateGradient<SparseMatrix> solver;
   bool                                               outlierExists = true;
   unsigned                                           iteration = 0;
+  TranslationsMatrix                                 guess(m_LinearMontageSize, Dimension);
   while (outlierExists)
   {
+    MontageInstrumentation::ScopedStageTimer iterationTimer(m_Instrumentation,
+                                                            MontageInstrumentation::StageEnum::GlobalSolve);
     if (this->GetDebug())
     {
       std::cout << "\n\n"; // make it easier to spot new iteration
@@ -450,8 +1209,22 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
     regCoef.makeCompressed();
     solver.compute(regCoef);
     TranslationsMatrix solutions(m_LinearMontageSize, Dimension);
-    TranslationsMatrix residuals(m_NumberOfPairs + 1, Dimension);
-    solutions = solver.solve(translations);
+    TranslationsMatrix residuals(nRows, Dimension);
+    if (warmStart)
+    {
+      for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+      {
+        for (unsigned d = 0; d < ImageDimension; d++)
+        {
+          guess(i, d) = m_CurrentAdjustments[i][d]; // previous provisional solution
+        }
+      }
+      solutions = solver.solveWithGuess(translations, guess);
+    }
+    else
+    {
+      solutions = solver.solve(translations);
+    }
     residuals = regCoef * solutions - translations;
 
     if (this->GetDebug())
@@ -479,15 +1252,17 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
       }
     }
 
+    // assume zero mean, low-information equations contribute nothing
     TranslationsMatrix stdDev0 =
-      (translations.cwiseAbs2().colwise().sum() / m_NumberOfPairs).cwiseSqrt(); // assume zero mean
+      (translations.topRows(nEquations).cwiseAbs2().colwise().sum() / std::max<SizeValueType>(nRegistered, 1))
+        .cwiseSqrt();
     if (this->GetDebug())
     {
       std::cout << "\nstdDev0:\n" << stdDev0;
     }
 
-    std::vector<TCoordinate> outlierScore(m_NumberOfPairs, 0.0); // sum of squares
-    for (SizeValueType i = 0; i < m_NumberOfPairs; i++)
+    std::vector<TCoordinate> outlierScore(nEquations, 0.0); // sum of squares
+    for (SizeValueType i = 0; i < nEquations; i++)
     {
       for (unsigned d = 0; d < ImageDimension; d++)
       {
@@ -511,7 +1286,7 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
       std::cout << "\nresiduals:\n";
     }
 
-    for (SizeValueType i = 0; i < m_NumberOfPairs; i++)
+    for (SizeValueType i = 0; i < nEquations; i++)
     {
       TCoordinate residual = 0;
       if (this->GetDebug())
@@ -542,6 +1317,10 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
 
       // establish cost of this equation
       TCoordinate cost = residual * (1.0 + outlierScore[i]);
+      if (m_LowInformation[candidateIndex])
+      {
+        cost = 0; // there is no better candidate
+      }
 
       if (this->GetDebug())
       {
@@ -569,14 +1348,16 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
     {
       SizeValueType candidateIndex = equationToCandidate[maxIndex];
       std::cout << "Outlier detected. Eq. " << maxIndex << ", Reg. " << candidateIndex;
+      if (m_Instrumentation)
+      {
+        m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::OutliersRemoved);
+      }
 
       // calculate indices of the involved tiles
-      SizeValueType linIndex = candidateIndex % m_LinearMontageSize;
-      TileIndexType currentIndex = this->LinearIndexTonDIndex(linIndex);
-      TileIndexType referenceIndex = currentIndex;
-      unsigned      dim = candidateIndex / m_LinearMontageSize;
-      referenceIndex[dim] = currentIndex[dim] - 1;
-      std::cout << ": " << currentIndex << "->" << referenceIndex << "  T: ";
+      const SizeValueType refLinearIndex = m_Pairs[candidateIndex].first;
+      const SizeValueType linIndex = m_Pairs[candidateIndex].second;
+      std::cout << ": " << this->LinearIndexTonDIndex(linIndex) << "->" << this->LinearIndexTonDIndex(refLinearIndex)
+                << "  T: ";
 
       if (!m_TransformCandidates[candidateIndex].empty())
       {
@@ -591,11 +1372,9 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
       if (!m_TransformCandidates[candidateIndex].empty())
       {
         // get a new equation from m_TransformCandidates
-        const float &                        confidence = m_CandidateConfidences[candidateIndex][0];
-        typename SparseMatrix::InnerIterator it(regCoef, maxIndex);
-        regCoef.coeffRef(maxIndex, it.index()) = -confidence;
-        ++it;
-        regCoef.coeffRef(maxIndex, it.index()) = confidence;
+        const float & confidence = m_CandidateConfidences[candidateIndex][0];
+        regCoef.coeffRef(maxIndex, refLinearIndex) = -confidence;
+        regCoef.coeffRef(maxIndex, linIndex) = confidence;
 
         const TranslationOffset & candidateOffset = m_TransformCandidates[candidateIndex][0];
         for (unsigned d = 0; d < ImageDimension; d++)
@@ -607,10 +1386,8 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
       else
       {
         // nudge this registration towards zero adjustment
-        typename SparseMatrix::InnerIterator it(regCoef, maxIndex);
-        regCoef.coeffRef(maxIndex, it.index()) = 0.01 * regCoef.coeffRef(maxIndex, it.index());
-        ++it;
-        regCoef.coeffRef(maxIndex, it.index()) = 0.01 * regCoef.coeffRef(maxIndex, it.index());
+        regCoef.coeffRef(maxIndex, refLinearIndex) *= 0.01;
+        regCoef.coeffRef(maxIndex, linIndex) *= 0.01;
 
         for (unsigned d = 0; d < ImageDimension; d++)
         {
@@ -624,27 +1401,105 @@ TileMontage<TImageType, TCoordinate>::OptimizeTiles()
 
 template <typename TImageType, typename TCoordinate>
 void
-TileMontage<TImageType, TCoordinate>::GenerateData()
+TileMontage<TImageType, TCoordinate>::RegisterPairs(const std::vector<SizeValueType> & pairIndices,
+                                                    bool                               cheap,
+                                                    float                              progressFrom,
+                                                    float                              progressTo)
 {
-  // initialize mosaic bounds
-  auto           input0 = static_cast<const ImageType *>(this->GetInput(0));
-  ImageIndexType ind = input0->GetLargestPossibleRegion().GetIndex();
-  m_MinInner = ind;
-  m_MinOuter = ind;
-  ind += input0->GetLargestPossibleRegion().GetSize();
-  m_MaxOuter = ind;
-  m_MaxInner.Fill(NumericTraits<TCoordinate>::max());
+  m_RemainingPairs.assign(m_LinearMontageSize, 0);
+  for (SizeValueType pairIndex : pairIndices)
+  {
+    ++m_RemainingPairs[m_Pairs[pairIndex].first];
+    ++m_RemainingPairs[m_Pairs[pairIndex].second];
+  }
+  m_FinishedPairs = 0;
 
-  m_NumberOfPairs = 0; // number of equations = number of registration pairs
-  for (unsigned d = 0; d < ImageDimension; d++)
+  this->PrepareRegistration();
+  typename ThreadPool::Pointer pool = ThreadPool::GetInstance();
+  const ThreadIdType           workUnits = this->GetNumberOfWorkUnits();
+
+  // pairs are ordered by the higher of their tile indices, so each tile's pairs are consecutive
+  auto completingTile = [this, &pairIndices](SizeValueType p) {
+    return std::max(m_Pairs[pairIndices[p]].first, m_Pairs[pairIndices[p]].second);
+  };
+  std::vector<std::pair<SizeValueType, SizeValueType>> jobs; // [begin, end) ranges of pairIndices
+  for (SizeValueType begin = 0; begin < pairIndices.size();)
   {
-    m_NumberOfPairs += (m_LinearMontageSize / m_MontageSize[d]) * (m_MontageSize[d] - 1);
+    SizeValueType end = begin + 1;
+    while (end < pairIndices.size() && completingTile(end) == completingTile(begin))
+    {
+      ++end;
+    }
+    jobs.emplace_back(begin, end);
+    begin = end;
   }
 
-  TileIndexType ind0;
-  ind0.Fill(0);
-  m_FinishedPairs = 0;
-  m_CurrentAdjustments[0].Fill(0.0); // 0 translation by default
+  const unsigned nodes = m_NUMAAware ? MontageNUMA::GetNumberOfNodes() : 1;
+  if (nodes > 1) // round-robin over the nodes' blocks of tiles, each block in order
+  {
+    std::vector<std::deque<std::pair<SizeValueType, SizeValueType>>> nodeJobs(nodes);
+    for (const auto & job : jobs)
+    {
+      nodeJobs[this->GetTileNode(completingTile(job.first))].push_back(job);
+    }
+    const SizeValueType jobCount = jobs.size();
+    jobs.clear();
+    for (unsigned n = 0; jobs.size() < jobCount; n = (n + 1) % nodes)
+    {
+      if (!nodeJobs[n].empty())
+      {
+        jobs.push_back(nodeJobs[n].front());
+        nodeJobs[n].pop_front();
+      }
+    }
+  }
+
+  std::deque<std::future<void>> futures;
+  for (const auto & job : jobs)
+  {
+    // filling ThreadPool's queue with more top-level jobs
+    // than there are threads causes dead-lock, so let's be conservative
+    if (futures.size() >= workUnits)
+    {
+      futures.front().get(); // waits for the computation to finish
+      futures.pop_front();
+    }
+
+    const SizeValueType begin = job.first;
+    const SizeValueType end = job.second;
+    const int           node = this->GetTileNode(completingTile(begin));
+    futures.push_back(pool->AddWork([this, &pairIndices, begin, end, node, cheap, progressFrom, progressTo]() {
+      // tiles read and spectra computed by this job are first touched on the node
+      MontageNUMA::ScopedNodeAffinity affinity(node);
+
+      // register the tile to its paired tiles which have lower indices
+      for (SizeValueType p = begin; p < end; p++)
+      {
+        this->RegisterPair(pairIndices[p], cheap);
+        this->ReleaseMemory(pairIndices[p], cheap);
+        ++m_FinishedPairs;
+        this->UpdateProgress(progressFrom + (progressTo - progressFrom) * m_FinishedPairs / pairIndices.size());
+      }
+    }));
+  }
+
+  while (!futures.empty())
+  {
+    futures.front().get(); // waits for the computation to finish
+    futures.pop_front();
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::PrepareRegistration()
+{
+  if (m_BufferPooling && m_PoolRegistrations.empty())
+  {
+    m_PoolRegistrations.push_back(RegisterPooledPixelType<PixelType>());
+    m_PoolRegistrations.push_back(RegisterPooledPixelType<RealType>());
+    m_PoolRegistrations.push_back(RegisterPooledPixelType<std::complex<RealType>>());
+  }
 
   typename ThreadPool::Pointer pool = ThreadPool::GetInstance();
   ThreadIdType                 tpThreads = pool->GetMaximumNumberOfThreads();
@@ -653,68 +1508,611 @@ TileMontage<TImageType, TCoordinate>::GenerateData()
   {
     pool->AddThreads(workUnits - tpThreads + 1);
   }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::EndBufferPooling()
+{
+  if (!m_PoolRegistrations.empty())
+  {
+    m_PoolRegistrations.clear(); // images allocated from now on use the default pixel container
+    MontageBufferPool::GetInstance().Trim();
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::StartAcquisition()
+{
+  itkAssertOrThrowMacro(!m_TilePairs.empty() || m_MinimumOverlap <= 0.0,
+                        "Pairs can not be determined from overlaps of tiles which are not acquired yet");
+  itkAssertOrThrowMacro(!m_CandidatesRead, "Registration candidates were already read from shards");
+  this->DeterminePairs();
+
+  m_TileAcquired.assign(m_LinearMontageSize, 0);
+  m_PairRegistered.assign(m_NumberOfPairs, 0);
+  m_PairsOfTile.assign(m_LinearMontageSize, std::vector<SizeValueType>());
+  m_RemainingPairs.assign(m_LinearMontageSize, 0);
+  for (SizeValueType p = 0; p < m_NumberOfPairs; p++)
+  {
+    for (SizeValueType linearIndex : { m_Pairs[p].first, m_Pairs[p].second })
+    {
+      m_PairsOfTile[linearIndex].push_back(p);
+      ++m_RemainingPairs[linearIndex];
+    }
+  }
+  m_FinishedPairs = 0;
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    m_CurrentAdjustments[i].Fill(0.0); // provisional solutions start from the expected positions
+  }
 
-  std::vector<std::future<void>> futures(m_LinearMontageSize);
-  SizeValueType                  waited = 0;
+  // background jobs read inputs while tiles are being added, so adding a tile
+  // must only replace an existing entry, never grow the indexed inputs
+  this->SetNumberOfIndexedInputs(m_LinearMontageSize);
   for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
   {
-    // filling ThreadPool's queue with more top-level jobs
-    // than there are threads causes dead-lock, so let's be conservative
-    if (i - waited >= workUnits)
+    if (this->GetInput(i) == nullptr)
     {
-      TileIndexType currentIndex = this->LinearIndexTonDIndex(waited);
-      futures[waited].get(); // waits for the computation to finish
-      this->ReleaseMemory(currentIndex);
-      ++waited;
+      this->SetInputTile(i, m_Dummy);
     }
+  }
 
-    TileIndexType currentIndex = this->LinearIndexTonDIndex(i);
-    futures[i] = pool->AddWork([this, currentIndex]() {
-      // register i-th tile to adjacent tiles along all dimensions (lower index only)
-      TileIndexType currentTile = currentIndex; // we cannot modify currentIndex
-      for (unsigned regDim = 0; regDim < ImageDimension; regDim++)
+  this->PrepareRegistration();
+  this->ImportFFTWWisdom();
+  for (SizeValueType i = 1; i < m_LinearMontageSize; i++)
+  {
+    if (this->GetOutput(i) == nullptr) // provisional transforms are available before the first Update()
+    {
+      this->SetNthOutput(i, this->MakeOutput(i).GetPointer());
+    }
+  }
+  m_Acquiring = true;
+  this->Modified();
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::AddAcquiredTile(TileIndexType position)
+{
+  if (!m_Acquiring)
+  {
+    this->StartAcquisition();
+  }
+  const SizeValueType linearIndex = this->nDIndexToLinearIndex(position);
+  itkAssertOrThrowMacro(!m_TileAcquired[linearIndex], "Tile " << position << " was already acquired");
+  m_TileAcquired[linearIndex] = 1;
+
+  std::vector<SizeValueType> completedPairs; // whose other tile was acquired before
+  for (SizeValueType p : m_PairsOfTile[linearIndex])
+  {
+    if (m_TileAcquired[m_Pairs[p].first] && m_TileAcquired[m_Pairs[p].second])
+    {
+      completedPairs.push_back(p);
+    }
+  }
+  if (completedPairs.empty())
+  {
+    return;
+  }
+
+  // same bound as in RegisterPairs(), to avoid a dead-lock and to limit memory held by waiting tiles
+  while (m_AcquisitionJobs.size() >= this->GetNumberOfWorkUnits())
+  {
+    std::future<void> job = std::move(m_AcquisitionJobs.front());
+    m_AcquisitionJobs.pop_front();
+    job.get(); // waits for the computation to finish
+  }
+
+  const int  node = this->GetTileNode(linearIndex);
+  const bool cheap = m_TieredRegistration; // escalation needs all the pairs, so it is done by Update()
+  m_AcquisitionJobs.push_back(ThreadPool::GetInstance()->AddWork([this, completedPairs, node, cheap]() {
+    MontageNUMA::ScopedNodeAffinity affinity(node);
+    for (SizeValueType p : completedPairs)
+    {
+      this->RegisterPair(p, cheap);
+      this->ReleaseMemory(p, cheap);
+      m_PairRegistered[p] = 1;
+      ++m_FinishedPairs;
+    }
+  }));
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::AddAcquiredTile(TileIndexType position, ImageType * image)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_MemberProtector); // background jobs might be releasing other inputs
+    this->SetInputTile(position, image);
+  }
+  this->AddAcquiredTile(position);
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::AddAcquiredTile(TileIndexType position, const std::string & imageFilename)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_MemberProtector);
+    this->SetInputTile(position, imageFilename);
+  }
+  this->AddAcquiredTile(position);
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::WaitForAcquisitionJobs()
+{
+  while (!m_AcquisitionJobs.empty())
+  {
+    std::future<void> job = std::move(m_AcquisitionJobs.front());
+    m_AcquisitionJobs.pop_front();
+    job.get();
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::UpdateProvisionalTransforms()
+{
+  itkAssertOrThrowMacro(m_Acquiring, "No tiles were added by AddAcquiredTile() since the last Update()");
+  this->WaitForAcquisitionJobs();
+
+  // outlier elimination consumes candidates, which the final optimization needs
+  const std::vector<OffsetVector>    candidates = m_TransformCandidates;
+  const std::vector<ConfidencesType> confidences = m_CandidateConfidences;
+  this->OptimizeTiles(true); // starts from the previous provisional positions
+  m_TransformCandidates = candidates;
+  m_CandidateConfidences = confidences;
+
+  for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+  {
+    TransformPointer transform = TransformType::New();
+    transform->SetOffset(m_CurrentAdjustments[i]);
+    static_cast<TransformOutputType *>(this->GetOutput(i))->Set(transform);
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+typename TileMontage<TImageType, TCoordinate>::SpacingType
+TileMontage<TImageType, TCoordinate>::GetTileSpacing()
+{
+  SizeValueType linearIndex = 0;
+  while (m_Acquiring && !m_TileAcquired[linearIndex] && linearIndex + 1 < m_LinearMontageSize)
+  {
+    ++linearIndex; // tiles which are not acquired yet might not be available
+  }
+  return this->GetImage(this->LinearIndexTonDIndex(linearIndex), true)->GetSpacing();
+}
+
+template <typename TImageType, typename TCoordinate>
+std::vector<SizeValueType>
+TileMontage<TImageType, TCoordinate>::SelectPairsToEscalate()
+{
+  // outlier elimination consumes candidates, but the cheap ones are kept for unambiguous pairs
+  const std::vector<OffsetVector>    cheapCandidates = m_TransformCandidates;
+  const std::vector<ConfidencesType> cheapConfidences = m_CandidateConfidences;
+  this->OptimizeTiles();
+  m_TransformCandidates = cheapCandidates;
+  m_CandidateConfidences = cheapConfidences;
+
+  const SpacingType          spacing = this->GetTileSpacing();
+  std::vector<SizeValueType> escalated;
+  for (SizeValueType i = 0; i < m_NumberOfPairs; i++)
+  {
+    if (m_LowInformation[i])
+    {
+      continue; // a better registration would be just as spurious
+    }
+    if (m_TransformCandidates[i].empty() ||
+        (m_CandidateConfidences[i].size() > 1 &&
+         m_CandidateConfidences[i][1] > m_AmbiguityThreshold * m_CandidateConfidences[i][0]))
+    {
+      escalated.push_back(i);
+      continue;
+    }
+
+    // the solution satisfies: adjustment of moving - adjustment of fixed = offset
+    const TranslationOffset residual = m_CurrentAdjustments[m_Pairs[i].second] -
+                                       m_CurrentAdjustments[m_Pairs[i].first] - m_TransformCandidates[i][0];
+    double pixelResidual = 0.0;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      pixelResidual += (residual[d] / spacing[d]) * (residual[d] / spacing[d]);
+    }
+    if (std::sqrt(pixelResidual) > m_AbsoluteThreshold)
+    {
+      escalated.push_back(i);
+    }
+  }
+  return escalated;
+}
+
+template <typename TImageType, typename TCoordinate>
+std::vector<SizeValueType>
+TileMontage<TImageType, TCoordinate>::GetShardPairs(unsigned shardIndex, unsigned numberOfShards) const
+{
+  itkAssertOrThrowMacro(shardIndex < numberOfShards,
+                        "Shard index " << shardIndex << " must be less than the number of shards " << numberOfShards);
+
+  // split the shard count among dimensions, each prime factor going to the dimension with the longest blocks
+  SizeType blocks;
+  blocks.Fill(1);
+  unsigned remaining = numberOfShards;
+  for (unsigned factor = 2; remaining > 1; factor++)
+  {
+    while (remaining % factor == 0)
+    {
+      unsigned longest = 0;
+      for (unsigned d = 1; d < ImageDimension; d++)
       {
-        if (currentTile[regDim] > 0) // we are not at the edge along this dimension
+        if (m_MontageSize[d] * blocks[longest] > m_MontageSize[longest] * blocks[d])
         {
-          TileIndexType referenceIndex = currentTile;
-          referenceIndex[regDim] = currentTile[regDim] - 1;
-          this->RegisterPair(referenceIndex, currentTile);
-          ++m_FinishedPairs;
-          // all registrations finished = 95% of total progress
-          this->UpdateProgress(m_FinishedPairs * 0.95 / m_NumberOfPairs);
+          longest = d;
         }
       }
-    });
-    // optimize positions later, now just set the expected position (no translation)
-    m_CurrentAdjustments[waited].Fill(0.0);
+      blocks[longest] *= factor;
+      remaining /= factor;
+    }
+  }
+
+  // a pair belongs to the block of the tile which completes it, so tiles' pairs are not split
+  std::vector<SizeValueType> pairIndices;
+  for (SizeValueType p = 0; p < m_Pairs.size(); p++)
+  {
+    const TileIndexType ind = this->LinearIndexTonDIndex(std::max(m_Pairs[p].first, m_Pairs[p].second));
+    SizeValueType       shard = 0;
+    SizeValueType       stride = 1;
+    for (unsigned d = 0; d < ImageDimension; d++)
+    {
+      shard += ind[d] * blocks[d] / m_MontageSize[d] * stride;
+      stride *= blocks[d];
+    }
+    if (shard == shardIndex)
+    {
+      pairIndices.push_back(p);
+    }
   }
+  return pairIndices;
+}
 
-  for (SizeValueType i = waited; i < m_LinearMontageSize; i++)
+template <typename TImageType, typename TCoordinate>
+int
+TileMontage<TImageType, TCoordinate>::GetTileNode(SizeValueType linearIndex) const
+{
+  if (!m_NUMAAware || MontageNUMA::GetNumberOfNodes() < 2)
+  {
+    return -1;
+  }
+  return MontageNUMA::GetItemNode(linearIndex, m_LinearMontageSize);
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::ImportFFTWWisdom()
+{
+  if (m_FFTWWisdomFile.empty())
   {
-    TileIndexType currentIndex = this->LinearIndexTonDIndex(i);
-    futures[i].get(); // waits for the computation to finish
-    this->ReleaseMemory(currentIndex);
+    return;
+  }
+  bool imported = false;
+#if defined(ITK_USE_FFTWF)
+  if (std::is_same<RealType, float>::value)
+  {
+    imported = FFTWGlobalConfiguration::ImportWisdomFileFloat(m_FFTWWisdomFile);
+  }
+#endif
+#if defined(ITK_USE_FFTWD)
+  if (std::is_same<RealType, double>::value)
+  {
+    imported = FFTWGlobalConfiguration::ImportWisdomFileDouble(m_FFTWWisdomFile);
+  }
+#endif
+  itkDebugMacro("FFTW wisdom " << (imported ? "imported from " : "not imported from ") << m_FFTWWisdomFile);
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::ExportFFTWWisdom()
+{
+  if (m_FFTWWisdomFile.empty())
+  {
+    return;
+  }
+  // concurrent runs sharing the file must never see a partially written one
+  const std::string temporaryFilename = MontageTemporaryFilename(m_FFTWWisdomFile);
+  bool              exported = false;
+#if defined(ITK_USE_FFTWF)
+  if (std::is_same<RealType, float>::value)
+  {
+    exported = FFTWGlobalConfiguration::ExportWisdomFileFloat(temporaryFilename);
+  }
+#endif
+#if defined(ITK_USE_FFTWD)
+  if (std::is_same<RealType, double>::value)
+  {
+    exported = FFTWGlobalConfiguration::ExportWisdomFileDouble(temporaryFilename);
+  }
+#endif
+  if (!exported)
+  {
+    return; // FFTW is not used for this precision
+  }
+  if (std::rename(temporaryFilename.c_str(), m_FFTWWisdomFile.c_str()) != 0)
+  {
+    std::remove(temporaryFilename.c_str());
+    itkWarningMacro("Could not replace FFTW wisdom file: " << m_FFTWWisdomFile);
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+SizeValueType
+TileMontage<TImageType, TCoordinate>::TrainFFTWWisdom()
+{
+  this->DeterminePairs();
+
+  // padded sizes follow from tile metadata, so registration methods are only brought up to date in information
+  std::set<std::vector<SizeValueType>> fftSizes;
+  for (SizeValueType p = 0; p < m_NumberOfPairs; p++)
+  {
+    for (bool cheap : { false, true })
+    {
+      if (cheap && !m_TieredRegistration)
+      {
+        continue;
+      }
+      typename PCMType::Pointer pcm = this->CreateRegistrationMethod(cheap);
+      pcm->SetFixedImage(this->GetImage(this->LinearIndexTonDIndex(m_Pairs[p].first), true));
+      pcm->SetMovingImage(this->GetImage(this->LinearIndexTonDIndex(m_Pairs[p].second), true));
+      pcm->UpdateOutputInformation();
+      const SizeType             size = pcm->GetPhaseCorrelationImage()->GetLargestPossibleRegion().GetSize();
+      std::vector<SizeValueType> sizeVector(size.begin(), size.end());
+      fftSizes.insert(sizeVector);
+    }
+  }
+
+#if defined(ITK_USE_FFTWF) || defined(ITK_USE_FFTWD)
+  struct PlanRigorGuard // the global rigor is restored even if planning throws
+  {
+    const int rigor = FFTWGlobalConfiguration::GetPlanRigor();
+    ~PlanRigorGuard() { FFTWGlobalConfiguration::SetPlanRigor(rigor); }
+  } rigorGuard;
+  if (rigorGuard.rigor == FFTW_ESTIMATE) // estimated plans are not worth persisting
+  {
+    FFTWGlobalConfiguration::SetPlanRigor(FFTW_MEASURE);
+  }
+#endif
+  this->ImportFFTWWisdom(); // only new sizes are planned
+
+  using RealImageType = typename PCMType::RealImageType;
+  for (const std::vector<SizeValueType> & sizeVector : fftSizes)
+  {
+    SizeType size;
+    std::copy(sizeVector.begin(), sizeVector.end(), size.begin());
+    typename RealImageType::Pointer image = RealImageType::New();
+    image->SetRegions(size);
+    image->Allocate(true);
+
+    typename PCMType::FFTFilterType::Pointer  forward;
+    typename PCMType::IFFTFilterType::Pointer inverse;
+    PCMType::CreateFFTFilters(m_FFTBackend, forward, inverse);
+    forward->SetInput(image);
+    inverse->SetInput(forward->GetOutput());
+    inverse->SetActualXDimensionIsOdd(size[0] % 2 != 0);
+    inverse->Update();
+  }
+
+  this->ExportFFTWWisdom();
+  return fftSizes.size();
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::RegisterShard(unsigned            shardIndex,
+                                                    unsigned            numberOfShards,
+                                                    const std::string & shardFilename)
+{
+  this->DeterminePairs();
+  const std::vector<SizeValueType> pairIndices = this->GetShardPairs(shardIndex, numberOfShards);
+  this->ImportFFTWWisdom();
+  this->RegisterPairs(pairIndices, false, 0.0f, 1.0f);
+  this->EndBufferPooling();
+  this->ExportFFTWWisdom();
+
+  const std::string temporaryFilename = shardFilename + ".tmp";
+  std::ofstream     shard(temporaryFilename);
+  if (!shard)
+  {
+    itkExceptionMacro("Could not open for writing: " << temporaryFilename);
+  }
+  shard << std::setprecision(std::numeric_limits<TCoordinate>::max_digits10);
+  shard << "# TileMontage registration shard\n";
+  shard << "# pairIndex fixedTile movingTile lowInformation candidateCount (confidence offset)...\n";
+  shard << "Dimension " << ImageDimension << '\n';
+  shard << "Shard " << shardIndex << " of " << numberOfShards << '\n';
+  shard << "Pairs " << m_Pairs.size() << '\n';
+  for (SizeValueType p : pairIndices)
+  {
+    shard << p << ' ' << m_Pairs[p].first << ' ' << m_Pairs[p].second << ' ' << int(m_LowInformation[p]) << ' '
+          << m_TransformCandidates[p].size();
+    for (SizeValueType c = 0; c < m_TransformCandidates[p].size(); c++)
+    {
+      shard << ' ' << m_CandidateConfidences[p][c];
+      for (unsigned d = 0; d < ImageDimension; d++)
+      {
+        shard << ' ' << m_TransformCandidates[p][c][d];
+      }
+    }
+    shard << '\n';
+  }
+  shard.close();
+  if (!shard || std::rename(temporaryFilename.c_str(), shardFilename.c_str()) != 0)
+  {
+    itkExceptionMacro("Could not write shard file: " << shardFilename);
+  }
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::ReadShards(const std::vector<std::string> & shardFilenames)
+{
+  this->DeterminePairs();
+  std::vector<char> covered(m_Pairs.size(), 0);
+  for (const std::string & shardFilename : shardFilenames)
+  {
+    std::ifstream shard(shardFilename);
+    if (!shard)
+    {
+      itkExceptionMacro("Could not open for reading: " << shardFilename);
+    }
+    std::string   line;
+    std::string   keyword;
+    unsigned      dimension = 0;
+    SizeValueType numberOfPairs = 0;
+    while (std::getline(shard, line) && (line.empty() || line[0] == '#'))
+    {
+    }
+    std::istringstream(line) >> keyword >> dimension;
+    std::getline(shard, line); // shard index and count, informative only
+    shard >> keyword >> numberOfPairs;
+    if (dimension != ImageDimension || numberOfPairs != m_Pairs.size())
+    {
+      itkExceptionMacro("Shard " << shardFilename << " has dimension " << dimension << " and " << numberOfPairs
+                                 << " pairs, but this montage has dimension " << ImageDimension << " and "
+                                 << m_Pairs.size() << " pairs");
+    }
+
+    SizeValueType p;
+    while (shard >> p)
+    {
+      SizeValueType fixed, moving, candidateCount;
+      int           lowInformation;
+      shard >> fixed >> moving >> lowInformation >> candidateCount;
+      if (!shard || p >= m_Pairs.size() || m_Pairs[p].first != fixed || m_Pairs[p].second != moving)
+      {
+        itkExceptionMacro("Pair " << p << " (" << fixed << ", " << moving << ") in shard " << shardFilename
+                                  << " does not match the pairs of this montage");
+      }
+      m_LowInformation[p] = lowInformation != 0;
+      m_TransformCandidates[p].resize(candidateCount);
+      m_CandidateConfidences[p].resize(candidateCount);
+      for (SizeValueType c = 0; c < candidateCount; c++)
+      {
+        shard >> m_CandidateConfidences[p][c];
+        for (unsigned d = 0; d < ImageDimension; d++)
+        {
+          shard >> m_TransformCandidates[p][c][d];
+        }
+      }
+      if (!shard)
+      {
+        itkExceptionMacro("Shard " << shardFilename << " is truncated at pair " << p);
+      }
+      covered[p] = 1;
+    }
+  }
+
+  for (SizeValueType p = 0; p < m_Pairs.size(); p++)
+  {
+    if (!covered[p])
+    {
+      itkExceptionMacro("Pair " << p << " (" << m_Pairs[p].first << ", " << m_Pairs[p].second
+                                << ") is not in any of the shards");
+    }
+  }
+  m_CandidatesRead = true;
+  this->Modified();
+}
+
+template <typename TImageType, typename TCoordinate>
+void
+TileMontage<TImageType, TCoordinate>::GenerateData()
+{
+  // initialize mosaic bounds
+  auto           input0 = static_cast<const ImageType *>(this->GetInput(0));
+  ImageIndexType ind = input0->GetLargestPossibleRegion().GetIndex();
+  m_MinInner = ind;
+  m_MinOuter = ind;
+  ind += input0->GetLargestPossibleRegion().GetSize();
+  m_MaxOuter = ind;
+  m_MaxInner.Fill(NumericTraits<TCoordinate>::max());
+
+  if (!m_CandidatesRead && !m_Acquiring) // acquisition has determined pairs, see AddAcquiredTile()
+  {
+    this->DeterminePairs(); // number of equations = number of registration pairs
+    for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
+    {
+      // optimize positions later, now just set the expected position (no translation)
+      m_CurrentAdjustments[i].Fill(0.0);
+    }
+  }
+
+  std::vector<SizeValueType> allPairs; // all the pairs which are not registered yet
+  if (m_Acquiring)
+  {
+    this->WaitForAcquisitionJobs();
+    for (SizeValueType p = 0; p < m_NumberOfPairs; p++)
+    {
+      if (!m_PairRegistered[p])
+      {
+        allPairs.push_back(p);
+      }
+    }
+    m_Acquiring = false; // the remaining tiles must be available now
+  }
+  else
+  {
+    allPairs.resize(m_NumberOfPairs);
+    std::iota(allPairs.begin(), allPairs.end(), 0);
+    if (!m_CandidatesRead)
+    {
+      this->ImportFFTWWisdom(); // acquisition has imported it
+    }
+  }
+
+  if (m_CandidatesRead) // pairs were determined and registered by shards, see ReadShards()
+  {
+    m_CandidatesRead = false;
+    this->UpdateProgress(0.95f);
+  }
+  else if (m_TieredRegistration)
+  {
+    this->RegisterPairs(allPairs, true, 0.0f, 0.5f);
+    const std::vector<SizeValueType> escalated = this->SelectPairsToEscalate();
+    if (m_Instrumentation)
+    {
+      m_Instrumentation->Increment(MontageInstrumentation::CounterEnum::PairsEscalated, escalated.size());
+    }
+    this->RegisterPairs(escalated, false, 0.5f, 0.95f);
+    this->ExportFFTWWisdom();
+  }
+  else
+  {
+    this->RegisterPairs(allPairs, false, 0.0f, 0.95f); // all registrations finished = 95% of total progress
+    this->ExportFFTWWisdom();
   }
 
   this->OptimizeTiles();
 
   // clear rest of the cache after montaging is finished
-  RegionType reg0;
   for (SizeValueType i = 0; i < m_LinearMontageSize; i++)
   {
     TileIndexType tileIndex = this->LinearIndexTonDIndex(i);
     WriteOutTransform(tileIndex, m_CurrentAdjustments[i]);
-    m_FFTCache[i] = nullptr;
+    this->ReleaseCachedTile(i);
     if (!m_Filenames[i].empty()) // release the input image too
     {
       this->SetInputTile(tileIndex, m_Dummy);
     }
-    if (m_Tiles[i])
-    {
-      m_Tiles[i]->SetBufferedRegion(reg0);
-      m_Tiles[i]->Allocate(false);
-    }
   }
+  if (!m_GridPairs) // an irregular mosaic is not entirely covered by any box smaller than its bounding box
+  {
+    m_MinInner = m_MinOuter;
+    m_MaxInner = m_MaxOuter;
+  }
+  this->EndBufferPooling();
   this->UpdateProgress(1.0f);
 }
 
@@ -19,6 +19,8 @@ itk_module(Montage
     ITKIOImageBase
     ITKImageFrequency
     ITKDoubleConversion
+  PRIVATE_DEPENDS
+    ITKZLIB
   TEST_DEPENDS
     ITKIOTransformInsightLegacy
     # ITKIOHDF5 # hdf5 is another format which supports streaming
@@ -0,0 +1,220 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkMontageBufferPool.h"
+#include "itkMacro.h"
+#include "itkMontageNUMA.h"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#endif
+
+namespace itk
+{
+namespace
+{
+thread_local MontageBufferPool * threadPool = nullptr;
+
+#if defined(__linux__)
+constexpr SizeValueType HugePageBytes = 2 * 1024 * 1024;
+#endif
+} // namespace
+
+MontageBufferPool &
+MontageBufferPool::GetInstance()
+{
+  // never destroyed, as images holding its buffers may outlive static destruction
+  static MontageBufferPool * instance = new MontageBufferPool;
+  return *instance;
+}
+
+MontageBufferPool *
+MontageBufferPool::GetThreadPool()
+{
+  return threadPool;
+}
+
+MontageBufferPool::Scope::Scope(bool enabled)
+  : m_Previous(threadPool)
+{
+  threadPool = enabled ? &GetInstance() : nullptr;
+}
+
+MontageBufferPool::Scope::~Scope()
+{
+  threadPool = m_Previous;
+}
+
+SizeValueType
+MontageBufferPool::GetSizeClass(SizeValueType bytes)
+{
+  if (bytes <= 4)
+  {
+    return 4;
+  }
+  // quarters of the power of two just below bytes
+  SizeValueType power = 1;
+  while (power <= (bytes - 1) / 2)
+  {
+    power *= 2;
+  }
+  const SizeValueType step = power / 4;
+  return (bytes + step - 1) / step * step;
+}
+
+void *
+MontageBufferPool::AllocateSystemBuffer(SizeValueType bytes)
+{
+#if defined(__linux__)
+  if (bytes >= HugePageBytes)
+  {
+    void * buffer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+#  if defined(MADV_HUGEPAGE)
+    madvise(buffer, bytes, MADV_HUGEPAGE); // only advice, a failure is harmless
+#  endif
+    return buffer;
+  }
+#endif
+  return ::operator new(bytes);
+}
+
+void
+MontageBufferPool::FreeSystemBuffer(void * buffer, SizeValueType bytes)
+{
+#if defined(__linux__)
+  if (bytes >= HugePageBytes)
+  {
+    munmap(buffer, bytes);
+    return;
+  }
+#endif
+  (void)bytes;
+  ::operator delete(buffer);
+}
+
+void *
+MontageBufferPool::Acquire(SizeValueType bytes)
+{
+  // pages of a fresh buffer are placed on the node of the thread which first touches them
+  const FreeListKey key(MontageNUMA::GetBoundNode(), GetSizeClass(bytes));
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Trimmed = false;
+    auto it = m_FreeBuffers.find(key);
+    if (it != m_FreeBuffers.end() && !it->second.empty())
+    {
+      void * buffer = it->second.back();
+      it->second.pop_back();
+      m_FreeBytes -= key.second;
+      m_BuffersInUse[buffer] = key;
+      ++m_NumberOfReuses;
+      return buffer;
+    }
+  }
+
+  void *                      buffer = AllocateSystemBuffer(key.second); // without holding the lock
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_BuffersInUse[buffer] = key;
+  ++m_NumberOfAllocations;
+  return buffer;
+}
+
+void
+MontageBufferPool::Release(void * buffer)
+{
+  FreeListKey key;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto                        it = m_BuffersInUse.find(buffer);
+    if (it == m_BuffersInUse.end())
+    {
+      itkGenericExceptionMacro("Buffer " << buffer << " was not acquired from the pool");
+    }
+    key = it->second;
+    m_BuffersInUse.erase(it);
+    if (!m_Trimmed)
+    {
+      m_FreeBuffers[key].push_back(buffer);
+      m_FreeBytes += key.second;
+      return;
+    }
+  }
+  FreeSystemBuffer(buffer, key.second); // pooling has ended, see Trim()
+}
+
+void
+MontageBufferPool::Trim()
+{
+  std::map<FreeListKey, std::vector<void *>> freeBuffers;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    freeBuffers.swap(m_FreeBuffers);
+    m_FreeBytes = 0;
+    m_Trimmed = true;
+  }
+  for (const auto & freeList : freeBuffers)
+  {
+    for (void * buffer : freeList.second)
+    {
+      FreeSystemBuffer(buffer, freeList.first.second);
+    }
+  }
+}
+
+void
+MontageBufferPool::SetMinimumBytes(SizeValueType bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MinimumBytes = bytes;
+}
+
+SizeValueType
+MontageBufferPool::GetMinimumBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MinimumBytes;
+}
+
+SizeValueType
+MontageBufferPool::GetNumberOfAllocations() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_NumberOfAllocations;
+}
+
+SizeValueType
+MontageBufferPool::GetNumberOfReuses() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_NumberOfReuses;
+}
+
+SizeValueType
+MontageBufferPool::GetFreeBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_FreeBytes;
+}
+
+} // namespace itk
@@ -0,0 +1,381 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkMontageInstrumentation.h"
+
+#include <fstream>
+
+namespace itk
+{
+namespace
+{
+const char *
+StageName(const MontageInstrumentationEnums::Stage value)
+{
+  switch (value)
+  {
+    case MontageInstrumentationEnums::Stage::TileRead:
+      return "TileRead";
+    case MontageInstrumentationEnums::Stage::TilePreprocessing:
+      return "TilePreprocessing";
+    case MontageInstrumentationEnums::Stage::Padding:
+      return "Padding";
+    case MontageInstrumentationEnums::Stage::ForwardFFT:
+      return "ForwardFFT";
+    case MontageInstrumentationEnums::Stage::Operator:
+      return "Operator";
+    case MontageInstrumentationEnums::Stage::BandPass:
+      return "BandPass";
+    case MontageInstrumentationEnums::Stage::InverseFFT:
+      return "InverseFFT";
+    case MontageInstrumentationEnums::Stage::PeakSearch:
+      return "PeakSearch";
+    case MontageInstrumentationEnums::Stage::SubPixelInterpolation:
+      return "SubPixelInterpolation";
+    case MontageInstrumentationEnums::Stage::GlobalSolve:
+      return "GlobalSolve";
+    case MontageInstrumentationEnums::Stage::Merge:
+      return "Merge";
+    default:
+      return nullptr;
+  }
+}
+
+const char *
+CounterName(const MontageInstrumentationEnums::Counter value)
+{
+  switch (value)
+  {
+    case MontageInstrumentationEnums::Counter::TilesRead:
+      return "TilesRead";
+    case MontageInstrumentationEnums::Counter::BytesRead:
+      return "BytesRead";
+    case MontageInstrumentationEnums::Counter::TileCacheHits:
+      return "TileCacheHits";
+    case MontageInstrumentationEnums::Counter::FFTCacheHits:
+      return "FFTCacheHits";
+    case MontageInstrumentationEnums::Counter::FFTCacheMisses:
+      return "FFTCacheMisses";
+    case MontageInstrumentationEnums::Counter::PairsRegistered:
+      return "PairsRegistered";
+    case MontageInstrumentationEnums::Counter::OutliersRemoved:
+      return "OutliersRemoved";
+    case MontageInstrumentationEnums::Counter::LowInformationPairs:
+      return "LowInformationPairs";
+    case MontageInstrumentationEnums::Counter::PairsEscalated:
+      return "PairsEscalated";
+    default:
+      return nullptr;
+  }
+}
+
+const char *
+MemoryCategoryName(const MontageInstrumentationEnums::MemoryCategory value)
+{
+  switch (value)
+  {
+    case MontageInstrumentationEnums::MemoryCategory::Tiles:
+      return "Tiles";
+    case MontageInstrumentationEnums::MemoryCategory::FFTCache:
+      return "FFTCache";
+    case MontageInstrumentationEnums::MemoryCategory::RegistrationBuffers:
+      return "RegistrationBuffers";
+    case MontageInstrumentationEnums::MemoryCategory::CorrelationSurface:
+      return "CorrelationSurface";
+    case MontageInstrumentationEnums::MemoryCategory::MergeOutput:
+      return "MergeOutput";
+    default:
+      return nullptr;
+  }
+}
+} // namespace
+
+/** Define how to print enumerations */
+std::ostream &
+operator<<(std::ostream & out, const MontageInstrumentationEnums::Stage value)
+{
+  const char * name = StageName(value);
+  if (name == nullptr)
+  {
+    return out << "INVALID VALUE FOR Stage";
+  }
+  return out << "MontageInstrumentationEnums::Stage::" << name;
+}
+
+std::ostream &
+operator<<(std::ostream & out, const MontageInstrumentationEnums::Counter value)
+{
+  const char * name = CounterName(value);
+  if (name == nullptr)
+  {
+    return out << "INVALID VALUE FOR Counter";
+  }
+  return out << "MontageInstrumentationEnums::Counter::" << name;
+}
+
+std::ostream &
+operator<<(std::ostream & out, const MontageInstrumentationEnums::MemoryCategory value)
+{
+  const char * name = MemoryCategoryName(value);
+  if (name == nullptr)
+  {
+    return out << "INVALID VALUE FOR MemoryCategory";
+  }
+  return out << "MontageInstrumentationEnums::MemoryCategory::" << name;
+}
+
+
+MontageInstrumentation::MontageInstrumentation()
+{
+  this->Reset();
+}
+
+
+void
+MontageInstrumentation::AddStageTime(StageEnum stage, double seconds)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  StageStatistics &           s = m_Stages[static_cast<unsigned>(stage)];
+  ++s.count;
+  s.totalSeconds += seconds;
+  s.maxSeconds = std::max(s.maxSeconds, seconds);
+}
+
+
+void
+MontageInstrumentation::AddPairRecord(SizeValueType fixed, SizeValueType moving, const StageTimes & seconds)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_PairRecords.push_back({ fixed, moving, seconds });
+}
+
+
+void
+MontageInstrumentation::AddFFTSize(const std::vector<SizeValueType> & size)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  ++m_FFTSizes[size];
+}
+
+
+void
+MontageInstrumentation::UpdateHighWaterMarks(MemoryCategoryEnum category)
+{
+  const unsigned c = static_cast<unsigned>(category);
+  m_MemoryHighWaterMarks[c] = std::max(m_MemoryHighWaterMarks[c], m_MemoryInUse[c]);
+  m_TotalMemoryHighWaterMark = std::max(m_TotalMemoryHighWaterMark, GetTotal(m_MemoryInUse));
+}
+
+
+void
+MontageInstrumentation::AddMemory(MemoryCategoryEnum category, SizeValueType bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MemoryInUse[static_cast<unsigned>(category)] += bytes;
+  this->UpdateHighWaterMarks(category);
+}
+
+
+void
+MontageInstrumentation::RemoveMemory(MemoryCategoryEnum category, SizeValueType bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  SizeValueType &             inUse = m_MemoryInUse[static_cast<unsigned>(category)];
+  inUse -= std::min(inUse, bytes);
+}
+
+
+void
+MontageInstrumentation::SetMemoryInUse(MemoryCategoryEnum category, SizeValueType bytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MemoryInUse[static_cast<unsigned>(category)] = bytes;
+  this->UpdateHighWaterMarks(category);
+}
+
+
+MontageInstrumentation::MemoryBytes
+MontageInstrumentation::GetMemoryInUse() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MemoryInUse;
+}
+
+
+MontageInstrumentation::MemoryBytes
+MontageInstrumentation::GetMemoryHighWaterMarks() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MemoryHighWaterMarks;
+}
+
+
+SizeValueType
+MontageInstrumentation::GetTotalMemoryHighWaterMark() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_TotalMemoryHighWaterMark;
+}
+
+
+SizeValueType
+MontageInstrumentation::GetTotal(const MemoryBytes & bytes)
+{
+  SizeValueType total = 0;
+  for (SizeValueType b : bytes)
+  {
+    total += b;
+  }
+  return total;
+}
+
+
+MontageInstrumentation::StageStatistics
+MontageInstrumentation::GetStageStatistics(StageEnum stage) const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Stages[static_cast<unsigned>(stage)];
+}
+
+
+std::map<std::vector<SizeValueType>, SizeValueType>
+MontageInstrumentation::GetFFTSizes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_FFTSizes;
+}
+
+
+std::vector<MontageInstrumentation::PairRecord>
+MontageInstrumentation::GetPairRecords() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_PairRecords;
+}
+
+
+void
+MontageInstrumentation::Reset()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Stages.fill(StageStatistics());
+  for (auto & counter : m_Counters)
+  {
+    counter = 0;
+  }
+  m_FFTSizes.clear();
+  m_PairRecords.clear();
+  m_MemoryHighWaterMarks = m_MemoryInUse;
+  m_TotalMemoryHighWaterMark = GetTotal(m_MemoryInUse);
+}
+
+
+void
+MontageInstrumentation::WriteJSON(std::ostream & out) const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  out << "{\n  \"stages\": {";
+  for (unsigned i = 0; i < NumberOfStages; i++)
+  {
+    const StageStatistics & s = m_Stages[i];
+    out << (i > 0 ? "," : "") << "\n    \"" << StageName(static_cast<StageEnum>(i)) << "\": {\"count\": " << s.count
+        << ", \"totalSeconds\": " << s.totalSeconds << ", \"maxSeconds\": " << s.maxSeconds << "}";
+  }
+
+  out << "\n  },\n  \"counters\": {";
+  for (unsigned i = 0; i < NumberOfCounters; i++)
+  {
+    out << (i > 0 ? "," : "") << "\n    \"" << CounterName(static_cast<CounterEnum>(i))
+        << "\": " << m_Counters[i].load();
+  }
+
+  out << "\n  },\n  \"memory\": {";
+  for (unsigned i = 0; i < NumberOfMemoryCategories; i++)
+  {
+    out << (i > 0 ? "," : "") << "\n    \"" << MemoryCategoryName(static_cast<MemoryCategoryEnum>(i))
+        << "\": {\"inUseBytes\": " << m_MemoryInUse[i] << ", \"highWaterBytes\": " << m_MemoryHighWaterMarks[i]
+        << "}";
+  }
+  out << ",\n    \"totalHighWaterBytes\": " << m_TotalMemoryHighWaterMark;
+
+  out << "\n  },\n  \"fftSizes\": [";
+  bool first = true;
+  for (const auto & fftSize : m_FFTSizes)
+  {
+    out << (first ? "" : ",") << "\n    {\"size\": [";
+    for (unsigned d = 0; d < fftSize.first.size(); d++)
+    {
+      out << (d > 0 ? ", " : "") << fftSize.first[d];
+    }
+    out << "], \"count\": " << fftSize.second << "}";
+    first = false;
+  }
+
+  out << "\n  ],\n  \"pairs\": [";
+  for (size_t p = 0; p < m_PairRecords.size(); p++)
+  {
+    const PairRecord & pair = m_PairRecords[p];
+    out << (p > 0 ? "," : "") << "\n    {\"fixed\": " << pair.fixed << ", \"moving\": " << pair.moving;
+    for (unsigned i = 0; i < NumberOfStages; i++)
+    {
+      if (pair.seconds[i] > 0.0) // stages which do not apply to pairs are omitted
+      {
+        out << ", \"" << StageName(static_cast<StageEnum>(i)) << "\": " << pair.seconds[i];
+      }
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+
+void
+MontageInstrumentation::WriteJSON(const std::string & fileName) const
+{
+  std::ofstream out(fileName);
+  if (!out)
+  {
+    itkExceptionMacro("Could not open " << fileName << " for writing");
+  }
+  this->WriteJSON(out);
+}
+
+
+void
+MontageInstrumentation::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (unsigned i = 0; i < NumberOfStages; i++)
+  {
+    os << indent << static_cast<StageEnum>(i) << ": " << m_Stages[i].count << " times, " << m_Stages[i].totalSeconds
+       << " s" << std::endl;
+  }
+  for (unsigned i = 0; i < NumberOfCounters; i++)
+  {
+    os << indent << static_cast<CounterEnum>(i) << ": " << m_Counters[i].load() << std::endl;
+  }
+  for (unsigned i = 0; i < NumberOfMemoryCategories; i++)
+  {
+    os << indent << static_cast<MemoryCategoryEnum>(i) << ": " << m_MemoryInUse[i] << " bytes in use, "
+       << m_MemoryHighWaterMarks[i] << " bytes at most" << std::endl;
+  }
+  os << indent << "Total memory high-water mark: " << m_TotalMemoryHighWaterMark << " bytes" << std::endl;
+  os << indent << "FFT sizes: " << m_FFTSizes.size() << std::endl;
+  os << indent << "Pair records: " << m_PairRecords.size() << std::endl;
+}
+} // end namespace itk
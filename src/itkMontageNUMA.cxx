@@ -0,0 +1,168 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkMontageNUMA.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
+namespace itk
+{
+namespace
+{
+// parses a list like "0-3,8-11"
+std::vector<unsigned>
+ParseCPUList(const std::string & list)
+{
+  std::vector<unsigned> cpus;
+  std::istringstream    in(list);
+  std::string           range;
+  while (std::getline(in, range, ','))
+  {
+    const std::string::size_type dash = range.find('-');
+    try
+    {
+      const unsigned first = std::stoul(range.substr(0, dash));
+      const unsigned last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+      for (unsigned cpu = first; cpu <= last; cpu++)
+      {
+        cpus.push_back(cpu);
+      }
+    }
+    catch (const std::exception &) // e.g. an empty list of a memory-only node
+    {
+    }
+  }
+  return cpus;
+}
+
+// CPUs of each node which has any, read once
+const std::vector<std::vector<unsigned>> &
+NodeCPUs()
+{
+  static const std::vector<std::vector<unsigned>> nodes = []() {
+    std::vector<std::vector<unsigned>> result;
+#if defined(__linux__)
+    // node numbers can have gaps, so a few missing ones do not end the search
+    for (unsigned node = 0, missing = 0; missing < 64; node++)
+    {
+      std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      std::string   line;
+      if (!cpuList || !std::getline(cpuList, line))
+      {
+        ++missing;
+        continue;
+      }
+      missing = 0;
+      std::vector<unsigned> cpus = ParseCPUList(line);
+      if (!cpus.empty())
+      {
+        result.push_back(cpus);
+      }
+    }
+#endif
+    return result;
+  }();
+  return nodes;
+}
+
+thread_local int boundNode = -1; // see ScopedNodeAffinity
+} // namespace
+
+unsigned
+MontageNUMA::GetNumberOfNodes()
+{
+  return std::max<unsigned>(1, NodeCPUs().size());
+}
+
+std::vector<unsigned>
+MontageNUMA::GetNodeCPUs(unsigned node)
+{
+  if (NodeCPUs().size() < 2 || node >= NodeCPUs().size())
+  {
+    return {};
+  }
+  return NodeCPUs()[node];
+}
+
+int
+MontageNUMA::GetBoundNode()
+{
+  return boundNode;
+}
+
+MontageNUMA::ScopedNodeAffinity::ScopedNodeAffinity(int node)
+{
+  if (node < 0)
+  {
+    return;
+  }
+  const std::vector<unsigned> cpus = GetNodeCPUs(node);
+  if (cpus.empty())
+  {
+    return;
+  }
+#if defined(__linux__)
+  cpu_set_t previous;
+  if (sched_getaffinity(0, sizeof(previous), &previous) != 0)
+  {
+    return;
+  }
+  cpu_set_t nodeSet;
+  CPU_ZERO(&nodeSet);
+  for (unsigned cpu : cpus)
+  {
+    if (cpu < CPU_SETSIZE)
+    {
+      CPU_SET(cpu, &nodeSet);
+    }
+  }
+  // only the allowed CPUs of the node, e.g. within a cgroup's cpuset
+  CPU_AND(&nodeSet, &nodeSet, &previous);
+  if (CPU_COUNT(&nodeSet) == 0 || sched_setaffinity(0, sizeof(nodeSet), &nodeSet) != 0)
+  {
+    return;
+  }
+  m_PreviousAffinity.resize(sizeof(previous));
+  std::memcpy(m_PreviousAffinity.data(), &previous, sizeof(previous));
+  m_Bound = true;
+  m_PreviousNode = boundNode;
+  boundNode = node;
+#endif
+}
+
+MontageNUMA::ScopedNodeAffinity::~ScopedNodeAffinity()
+{
+#if defined(__linux__)
+  if (m_Bound)
+  {
+    cpu_set_t previous;
+    std::memcpy(&previous, m_PreviousAffinity.data(), sizeof(previous));
+    sched_setaffinity(0, sizeof(previous), &previous);
+    boundNode = m_PreviousNode;
+  }
+#endif
+}
+
+} // namespace itk
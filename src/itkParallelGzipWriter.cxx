@@ -0,0 +1,147 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkParallelGzipWriter.h"
+
+#include "itkMacro.h"
+#include "itkMultiThreaderBase.h"
+#include "itk_zlib.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+ParallelGzipWriter::ParallelGzipWriter(const std::string & fileName, const std::string & header)
+  : m_File(fileName, std::ios::binary | std::ios::trunc)
+  , m_FileName(fileName)
+{
+  if (!m_File)
+  {
+    itkGenericExceptionMacro("Could not open " << fileName << " for writing");
+  }
+  m_File.write(header.data(), header.size());
+}
+
+ParallelGzipWriter::~ParallelGzipWriter()
+{
+  if (m_Pending.valid())
+  {
+    m_Pending.wait(); // its data might be destroyed right after us
+  }
+}
+
+void
+ParallelGzipWriter::SetChunkBytes(SizeValueType bytes)
+{
+  // zlib counts input bytes in unsigned int
+  itkAssertOrThrowMacro(bytes > 0 && bytes <= (SizeValueType(1) << 30), "Chunk size must be between 1 byte and 1 GiB");
+  m_ChunkBytes = bytes;
+}
+
+void
+ParallelGzipWriter::SetCompressionLevel(int level)
+{
+  itkAssertOrThrowMacro(level >= 0 && level <= 9, "Compression level must be between 0 and 9");
+  m_CompressionLevel = level;
+}
+
+std::string
+ParallelGzipWriter::CompressMember(const void * data, SizeValueType bytes, int level)
+{
+  z_stream stream{};
+  // 16 added to the window bits requests a gzip header and trailer instead of a zlib one
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    itkGenericExceptionMacro("Could not initialize zlib compression");
+  }
+
+  std::string member(deflateBound(&stream, static_cast<uLong>(bytes)), '\0');
+  stream.next_in = static_cast<Bytef *>(const_cast<void *>(data));
+  stream.avail_in = static_cast<uInt>(bytes);
+  stream.next_out = reinterpret_cast<Bytef *>(&member[0]);
+  stream.avail_out = static_cast<uInt>(member.size());
+  const int status = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END)
+  {
+    itkGenericExceptionMacro("zlib compression failed with status " << status);
+  }
+  member.resize(stream.total_out);
+  return member;
+}
+
+void
+ParallelGzipWriter::CompressAndWrite(const char * data, SizeValueType bytes)
+{
+  const SizeValueType        numberOfChunks = (bytes + m_ChunkBytes - 1) / m_ChunkBytes;
+  std::vector<std::string>   members(numberOfChunks);
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    numberOfChunks,
+    [&](SizeValueType c) {
+      const SizeValueType start = c * m_ChunkBytes;
+      members[c] = CompressMember(data + start, std::min(m_ChunkBytes, bytes - start), m_CompressionLevel);
+    },
+    nullptr);
+
+  for (const std::string & member : members)
+  {
+    m_File.write(member.data(), member.size());
+  }
+  if (!m_File)
+  {
+    itkGenericExceptionMacro("Writing into " << m_FileName << " failed");
+  }
+}
+
+void
+ParallelGzipWriter::Write(const void * data, SizeValueType bytes, const LightObject * owner)
+{
+  if (m_Pending.valid())
+  {
+    m_Pending.get(); // rethrows an error of the previous block
+  }
+  if (bytes == 0)
+  {
+    return;
+  }
+
+  LightObject::ConstPointer keepAlive = owner;
+  const char *              block = static_cast<const char *>(data);
+  m_Pending = std::async(std::launch::async, [this, block, bytes, keepAlive]() {
+    this->CompressAndWrite(block, bytes);
+  });
+}
+
+void
+ParallelGzipWriter::Close()
+{
+  if (m_Pending.valid())
+  {
+    m_Pending.get();
+  }
+  m_File.close();
+  if (m_File.fail())
+  {
+    itkGenericExceptionMacro("Closing " << m_FileName << " failed");
+  }
+}
+
+} // namespace itk
@@ -37,4 +37,22 @@ operator<<(std::ostream & out, const PhaseCorrelationImageRegistrationMethodEnum
     }
   }();
 }
+
+std::ostream &
+operator<<(std::ostream & out, const PhaseCorrelationImageRegistrationMethodEnums::FFTBackend value)
+{
+  return out << [value] {
+    switch (value)
+    {
+      case PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::Default:
+        return "PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::Default";
+      case PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::VNL:
+        return "PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::VNL";
+      case PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::FFTW:
+        return "PhaseCorrelationImageRegistrationMethodEnums::FFTBackend::FFTW";
+      default:
+        return "INVALID VALUE FOR FFTBackend";
+    }
+  }();
+}
 } // end namespace itk
@@ -34,6 +34,8 @@ operator<<(std::ostream & out, const PhaseCorrelationOptimizerEnums::PeakInterpo
         return "PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::Cosine";
       case PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::WeightedMeanPhase:
         return "PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::WeightedMeanPhase";
+      case PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::UpsampledDFT:
+        return "PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::UpsampledDFT";
       // case PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::PhaseFrequencySlope:
       // return "PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::PhaseFrequencySlope";
       default:
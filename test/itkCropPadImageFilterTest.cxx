@@ -0,0 +1,164 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkConstantPadImageFilter.h"
+#include "itkCropPadImageFilter.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMirrorPadImageFilter.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// cropping, conversion and padding in a single pass match the separate filters
+int
+itkCropPadImageFilterTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using RealImageType = itk::Image<float, Dimension>;
+  using CropPadType = itk::CropPadImageFilter<ImageType, RealImageType>;
+  using RoIType = itk::RegionOfInterestImageFilter<ImageType, ImageType>;
+  using ConstantPadType = itk::ConstantPadImageFilter<ImageType, RealImageType>;
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(ImageType::SizeType{ { 4, 3 } });
+  image->Allocate();
+  itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetLargestPossibleRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    it.Set(it.GetIndex()[0] + 10 * it.GetIndex()[1]);
+  }
+
+  const ImageType::RegionType roi({ { 1, 0 } }, { { 2, 3 } });
+  const ImageType::SizeType   lower{ { 3, 1 } };
+  const ImageType::SizeType   upper{ { 2, 2 } };
+
+  CropPadType::Pointer cropPad = CropPadType::New();
+  cropPad->SetInput(image);
+  cropPad->SetRegionOfInterest(roi);
+  cropPad->SetPadLowerBound(lower);
+  cropPad->SetPadUpperBound(upper);
+  cropPad->Update();
+
+  RoIType::Pointer roiFilter = RoIType::New();
+  roiFilter->SetInput(image);
+  roiFilter->SetRegionOfInterest(roi);
+  ConstantPadType::Pointer pad = ConstantPadType::New();
+  pad->SetInput(roiFilter->GetOutput());
+  pad->SetPadLowerBound(lower);
+  pad->SetPadUpperBound(upper);
+  pad->Update();
+
+  const RealImageType * fused = cropPad->GetOutput();
+  const RealImageType * separate = pad->GetOutput();
+  if (fused->GetLargestPossibleRegion() != separate->GetLargestPossibleRegion() ||
+      fused->GetOrigin() != separate->GetOrigin())
+  {
+    std::cerr << "Fused crop and pad has region " << fused->GetLargestPossibleRegion() << " and origin "
+              << fused->GetOrigin() << " instead of " << separate->GetLargestPossibleRegion() << " and "
+              << separate->GetOrigin() << std::endl;
+    return EXIT_FAILURE;
+  }
+  itk::ImageRegionConstIteratorWithIndex<RealImageType> fIt(fused, fused->GetLargestPossibleRegion());
+  for (; !fIt.IsAtEnd(); ++fIt)
+  {
+    if (fIt.Get() != separate->GetPixel(fIt.GetIndex()))
+    {
+      std::cerr << "Fused zero padding differs at " << fIt.GetIndex() << ": " << fIt.Get() << " instead of "
+                << separate->GetPixel(fIt.GetIndex()) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // mirrored about the edges of the region, attenuated by city-block distance from it
+  cropPad->MirrorOn();
+  cropPad->SetDecayBase(0.5);
+  cropPad->Update();
+  const std::vector<std::pair<RealImageType::IndexType, float>> expected = {
+    { { { 0, 0 } }, 1.0f },    // first pixel of the region
+    { { { 1, 2 } }, 22.0f },   // last pixel of the region
+    { { { -1, 0 } }, 0.5f },   // repeated edge
+    { { { 2, 0 } }, 1.0f },    // pixel (2, 0), 1 step away
+    { { { -3, -1 } }, 0.125f } // pixel (2, 0), 4 steps away
+  };
+  for (const auto & e : expected)
+  {
+    const float value = cropPad->GetOutput()->GetPixel(e.first);
+    if (std::abs(value - e.second) > 1e-6f)
+    {
+      std::cerr << "Mirror padding at " << e.first << " is " << value << " instead of " << e.second << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // decaying mirror padding matches MirrorPadImageFilter over whole images, including repeated reflections
+  using MirrorPadType = itk::MirrorPadImageFilter<ImageType, RealImageType>;
+  struct CropPadCase
+  {
+    ImageType::RegionType roi;
+    ImageType::SizeType   lower;
+    ImageType::SizeType   upper;
+  };
+  const std::vector<CropPadCase> cases = {
+    { roi, lower, upper },
+    { image->GetLargestPossibleRegion(), { { 2, 2 } }, { { 1, 0 } } },
+    { ImageType::RegionType({ { 0, 1 } }, { { 3, 2 } }), { { 0, 5 } }, { { 7, 1 } } },
+    { ImageType::RegionType({ { 2, 1 } }, { { 1, 1 } }), { { 2, 1 } }, { { 3, 2 } } },
+  };
+  cropPad->SetDecayBase(0.75);
+  for (const CropPadCase & c : cases)
+  {
+    cropPad->SetRegionOfInterest(c.roi);
+    cropPad->SetPadLowerBound(c.lower);
+    cropPad->SetPadUpperBound(c.upper);
+    cropPad->Update();
+
+    roiFilter->SetRegionOfInterest(c.roi);
+    MirrorPadType::Pointer mirrorPad = MirrorPadType::New();
+    mirrorPad->SetInput(roiFilter->GetOutput());
+    mirrorPad->SetPadLowerBound(c.lower);
+    mirrorPad->SetPadUpperBound(c.upper);
+    mirrorPad->SetDecayBase(0.75);
+    mirrorPad->Update();
+
+    const RealImageType * mirrored = cropPad->GetOutput();
+    const RealImageType * reference = mirrorPad->GetOutput();
+    if (mirrored->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion())
+    {
+      std::cerr << "Fused mirror padding of " << c.roi << " has region " << mirrored->GetLargestPossibleRegion()
+                << " instead of " << reference->GetLargestPossibleRegion() << std::endl;
+      return EXIT_FAILURE;
+    }
+    itk::ImageRegionConstIteratorWithIndex<RealImageType> mIt(mirrored, mirrored->GetLargestPossibleRegion());
+    for (; !mIt.IsAtEnd(); ++mIt)
+    {
+      const float expectedValue = reference->GetPixel(mIt.GetIndex());
+      if (std::abs(mIt.Get() - expectedValue) > 1e-4f * std::max(1.0f, std::abs(expectedValue)))
+      {
+        std::cerr << "Fused mirror padding of " << c.roi << " differs at " << mIt.GetIndex() << ": " << mIt.Get()
+                  << " instead of " << expectedValue << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
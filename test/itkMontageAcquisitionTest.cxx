@@ -0,0 +1,90 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMontageInstrumentation.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTestingMacros.h"
+#include "itkTileMontage.h"
+#include <iostream>
+#include <string>
+
+// pairs are registered while tiles are being acquired, and the final update only optimizes
+int
+itkMontageAcquisitionTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using CounterEnum = itk::MontageInstrumentation::CounterEnum;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 3 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.25);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(4000);
+  const auto tileSource = generator->GetTileSource();
+  const auto stage = generator->GetStageConfiguration();
+
+  itk::MontageInstrumentation::Pointer instrumentation = itk::MontageInstrumentation::New();
+  MontageType::Pointer                 montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetInstrumentation(instrumentation);
+
+  // checks tiles [0, acquired), the others should keep their expected positions
+  auto checkPositions = [&](itk::SizeValueType acquired, const char * when) {
+    return checkTranslations(montage, generator, 1.0, std::string(when) + ", live acquisition", acquired);
+  };
+
+  constexpr itk::SizeValueType firstRow = 3;
+  for (itk::SizeValueType t = 0; t < firstRow; t++)
+  {
+    montage->AddAcquiredTile(stage.LinearIndexToNDIndex(t), tileSource(t, false, ImageType::RegionType()));
+  }
+  ITK_TRY_EXPECT_EXCEPTION(montage->AddAcquiredTile(stage.LinearIndexToNDIndex(0)));
+  montage->UpdateProvisionalTransforms();
+  if (!checkPositions(firstRow, "After the first row"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  for (itk::SizeValueType t = firstRow; t < stage.LinearSize(); t++)
+  {
+    montage->AddAcquiredTile(stage.LinearIndexToNDIndex(t), tileSource(t, false, ImageType::RegionType()));
+  }
+  montage->UpdateProvisionalTransforms();
+  const itk::SizeValueType pairs = montage->GetPairs().size();
+  if (instrumentation->GetCounter(CounterEnum::PairsRegistered) != pairs ||
+      !checkPositions(stage.LinearSize(), "After all the tiles"))
+  {
+    std::cerr << instrumentation->GetCounter(CounterEnum::PairsRegistered) << " of " << pairs
+              << " pairs were registered during acquisition" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  montage->Update();
+  if (instrumentation->GetCounter(CounterEnum::PairsRegistered) != pairs)
+  {
+    std::cerr << "Update registered pairs again, " << instrumentation->GetCounter(CounterEnum::PairsRegistered)
+              << " registrations of " << pairs << " pairs" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return checkPositions(stage.LinearSize(), "After update") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMontageBufferPool.h"
+#include "itkPooledImportImageContainer.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+#include <iostream>
+
+// pooled buffers are reused by later pairs, and give the same registration results
+int
+itkMontageBufferPoolTest(int, char *[])
+{
+  itk::MontageBufferPool & pool = itk::MontageBufferPool::GetInstance();
+  struct MinimumBytesGuard // the pool is process-wide, so the default is restored
+  {
+    itk::MontageBufferPool & pool;
+    const itk::SizeValueType bytes;
+    ~MinimumBytesGuard() { pool.SetMinimumBytes(bytes); }
+  } guard{ pool, pool.GetMinimumBytes() };
+  pool.SetMinimumBytes(1024); // tiles of this test are small
+
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 3 } });
+  generator->SetAmplitude(4000);
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->BufferPoolingOn();
+  const itk::SizeValueType reuses = pool.GetNumberOfReuses();
+  montage->Update();
+
+  if (pool.GetNumberOfReuses() == reuses)
+  {
+    std::cerr << "Registration did not reuse any pooled buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (pool.GetFreeBytes() != 0)
+  {
+    std::cerr << "Free buffers were not trimmed after Update(): " << pool.GetFreeBytes() << " bytes" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // outside of a scope, buffers come from the system even for a registered pixel type
+  using RealImageType = itk::Image<MontageType::RealType, Dimension>;
+  using PooledContainerType = itk::PooledImportImageContainer<itk::SizeValueType, MontageType::RealType>;
+  {
+    PooledContainerType::Registration registration;
+    RealImageType::Pointer            outside = RealImageType::New();
+    outside->SetRegions(RealImageType::SizeType{ { 64, 64 } });
+    const itk::SizeValueType allocations = pool.GetNumberOfAllocations();
+    outside->Allocate();
+    outside = nullptr;
+    if (pool.GetNumberOfAllocations() != allocations || pool.GetFreeBytes() != 0)
+    {
+      std::cerr << "An image allocated outside of a pooling scope used the pool" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // after Update(), the pooled container is no longer registered
+  RealImageType::Pointer after = RealImageType::New();
+  if (dynamic_cast<PooledContainerType *>(after->GetPixelContainer()) != nullptr)
+  {
+    std::cerr << "Images created after Update() still use the pooled pixel container" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return checkTranslations(montage, generator, 1.0, "Registration with pooled buffers") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,63 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTestingMacros.h"
+#include "itkTileMontage.h"
+#include <iostream>
+
+// FFT backend can be chosen at run time, and it determines the parallelism
+int
+itkMontageFFTBackendTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using PCMType = MontageType::PCMType;
+  using FFTBackendEnum = PCMType::FFTBackendEnum;
+
+  const PCMType::FFTBackendCapabilities vnl = PCMType::GetFFTBackendCapabilities(FFTBackendEnum::VNL);
+  if (vnl.Implementation != FFTBackendEnum::VNL || vnl.MultiThreaded || vnl.SizeGreatestPrimeFactor < 2)
+  {
+    std::cerr << "Unexpected capabilities of VNL backend" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 2 } });
+  generator->SetAmplitude(4000);
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->SetFFTBackend(FFTBackendEnum::VNL);
+  if (montage->GetNumberOfWorkUnits() != itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads())
+  {
+    std::cerr << "Single threaded FFT should register pairs in parallel, but there are "
+              << montage->GetNumberOfWorkUnits() << " work units" << std::endl;
+    return EXIT_FAILURE;
+  }
+  montage->SetNumberOfWorkUnits(3);
+  montage->SetFFTBackend(FFTBackendEnum::VNL); // unchanged backend keeps the explicit number of work units
+  ITK_TEST_SET_GET_VALUE(3u, montage->GetNumberOfWorkUnits());
+  montage->Update();
+
+  return checkTranslations(montage, generator, 1.0, "VNL backend") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
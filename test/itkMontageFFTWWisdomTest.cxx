@@ -0,0 +1,113 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkTestingMacros.h"
+#include "itkTileMontage.h"
+#include "itksys/SystemTools.hxx"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(ITK_USE_FFTWF)
+#  include "fftw3.h"
+#endif
+
+// wisdom is trained once per tile configuration, and reused by later registrations
+int
+itkMontageFFTWWisdomTest(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <outputDirectory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string outputDirectory = argv[1];
+
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 2 } });
+  generator->SetAmplitude(4000);
+  const std::string wisdomFile = outputDirectory + "/fftwWisdom.txt";
+  std::remove(wisdomFile.c_str());
+
+  MontageType::Pointer trainer = MontageType::New();
+  trainer->SetMontageSize(generator->GetMontageSize());
+  trainer->SetTileSource(generator->GetTileSource());
+  trainer->SetFFTWWisdomFile(wisdomFile);
+  trainer->SetTieredRegistration(true);
+  const itk::SizeValueType sizes = trainer->TrainFFTWWisdom();
+  if (sizes < 2) // overlaps are cropped, and horizontal ones differ from vertical ones
+  {
+    std::cerr << "Training planned FFTs of only " << sizes << " sizes" << std::endl;
+    return EXIT_FAILURE;
+  }
+#if defined(ITK_USE_FFTWF)
+  if (!itksys::SystemTools::FileExists(wisdomFile, true))
+  {
+    std::cerr << "FFTW wisdom was not exported to " << wisdomFile << std::endl;
+    return EXIT_FAILURE;
+  }
+#endif
+
+#if defined(ITK_USE_FFTWF)
+  auto readLines = [](const std::string & filename) {
+    std::ifstream            file(filename);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);)
+    {
+      lines.push_back(line);
+    }
+    return lines;
+  };
+  const std::vector<std::string> trained = readLines(wisdomFile);
+  if (trained.size() < 2) // just the header
+  {
+    std::cerr << "FFTW wisdom exported to " << wisdomFile << " holds no plans" << std::endl;
+    return EXIT_FAILURE;
+  }
+  fftwf_forget_wisdom(); // only the file can bring the trained plans back
+#endif
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->SetFFTWWisdomFile(wisdomFile);
+  montage->Update();
+
+#if defined(ITK_USE_FFTWF)
+  // registration plans with estimate rigor, so measured plans in the exported wisdom were imported, not replanned
+  const std::vector<std::string> exported = readLines(wisdomFile);
+  for (const std::string & line : trained)
+  {
+    if (std::find(exported.begin(), exported.end(), line) == exported.end())
+    {
+      std::cerr << "Trained FFTW wisdom was not reused, " << wisdomFile << " lost: " << line << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+#endif
+  return EXIT_SUCCESS;
+}
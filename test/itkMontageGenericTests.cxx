@@ -19,6 +19,7 @@
 #include "itkPhaseCorrelationOptimizer.h"
 #include "itkPhaseCorrelationImageRegistrationMethod.h"
 #include "itkPhaseCorrelationOperator.h"
+#include "itkMontageInstrumentation.h"
 #include "itkTestingMacros.h"
 #include "itkTileMergeImageFilter.h"
 #include "itkTileMontage.h"
@@ -62,6 +63,8 @@ itkMontageGenericTests(int, char ** const)
   MergingTypeF::Pointer mtF = MergingTypeF::New();
   ITK_EXERCISE_BASIC_OBJECT_METHODS(mtF, TileMergeImageFilter, TileMontage);
   ITK_TRY_EXPECT_EXCEPTION(mtF->Update()); // inputs not set!
+  itk::MontageInstrumentation::Pointer instrumentation = itk::MontageInstrumentation::New();
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(instrumentation, MontageInstrumentation, Object);
 
   // exercise nD index conversions
   SizeType      size = { 2, 3, 4, 5 };
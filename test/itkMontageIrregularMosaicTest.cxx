@@ -0,0 +1,120 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// montages a mosaic with an irregular outline, listed as a sequence of tiles,
+// whose pairs are determined from tile positions
+int
+itkMontageIrregularMosaicTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 4, 4 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.2);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(4000);
+
+  // three corners of the grid were not acquired
+  std::vector<itk::SizeValueType> acquired;
+  for (itk::SizeValueType t = 0; t < generator->GetLinearMontageSize(); t++)
+  {
+    if (t != 3 && t != 12 && t != 15)
+    {
+      acquired.push_back(t);
+    }
+  }
+  const auto stage = generator->GetStageConfiguration();
+  const auto truth = generator->GetTrueConfiguration();
+  auto       gridDistance = [&stage](itk::SizeValueType a, itk::SizeValueType b) {
+    const auto ia = stage.LinearIndexToNDIndex(a);
+    const auto ib = stage.LinearIndexToNDIndex(b);
+    return std::abs(static_cast<long>(ia[0]) - static_cast<long>(ib[0])) +
+           std::abs(static_cast<long>(ia[1]) - static_cast<long>(ib[1]));
+  };
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize({ { acquired.size(), 1 } });
+  montage->SetTileSource(
+    [generator, acquired](itk::SizeValueType i, bool metadataOnly, const ImageType::RegionType & r) {
+      return generator->GenerateTile(acquired[i], metadataOnly, r);
+    });
+  montage->SetMinimumOverlap(0.1); // excludes diagonal neighbors, which overlap by 0.04
+  montage->Update();
+
+  // only adjacent acquired tiles are registered
+  itk::SizeValueType adjacentPairs = 0;
+  for (itk::SizeValueType a = 0; a < acquired.size(); a++)
+  {
+    for (itk::SizeValueType b = a + 1; b < acquired.size(); b++)
+    {
+      adjacentPairs += gridDistance(acquired[a], acquired[b]) == 1;
+    }
+  }
+  if (montage->GetPairs().size() != adjacentPairs)
+  {
+    std::cerr << "Registered " << montage->GetPairs().size() << " pairs instead of " << adjacentPairs << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (const auto & pair : montage->GetPairs())
+  {
+    if (gridDistance(acquired[pair.first], acquired[pair.second]) != 1)
+    {
+      std::cerr << "Tiles " << acquired[pair.first] << " and " << acquired[pair.second] << " are not adjacent"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto checkOffset = [&](itk::SizeValueType i, itk::SizeValueType anchor) {
+    const itk::SizeValueType t = acquired[i];
+    return checkTranslation(montage->GetOutputTransform({ { i, 0 } })->GetOffset(),
+                            expectedTranslation(stage, truth, t, acquired[anchor]),
+                            1.0,
+                            "Irregular mosaic registration put tile " + std::to_string(t));
+  };
+  for (itk::SizeValueType i = 0; i < acquired.size(); i++)
+  {
+    if (!checkOffset(i, 0))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // explicit pairs forming two groups, each of which is anchored at its lowest-index tile
+  montage->SetTilePairs({ { 0, 1 }, { 2, 5 } });
+  montage->Update();
+  if (!checkOffset(1, 0) || !checkOffset(5, 2) || !checkOffset(2, 2) ||
+      montage->GetOutputTransform({ { 7, 0 } })->GetOffset().GetNorm() != 0.0)
+  {
+    std::cerr << "Explicit tile pairs were not positioned as expected" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMontageInstrumentation.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+#include <iostream>
+#include <string>
+
+// pairs involving blank tiles are not registered, and keep stage positions
+int
+itkMontageLowInformationTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using CounterEnum = itk::MontageInstrumentation::CounterEnum;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 3 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.25);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(4000);
+
+  // the last column is background
+  auto isBlank = [](itk::SizeValueType t) { return t % 3 == 2; };
+  itk::MontageInstrumentation::Pointer instrumentation = itk::MontageInstrumentation::New();
+  MontageType::Pointer                 montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(
+    [generator, isBlank](itk::SizeValueType t, bool metadataOnly, const ImageType::RegionType & r) {
+      ImageType::Pointer tile = generator->GenerateTile(t, metadataOnly, r);
+      if (!metadataOnly && isBlank(t))
+      {
+        tile->FillBuffer(100);
+      }
+      return tile;
+    });
+  montage->SetInformationThreshold(100.0);
+  montage->SetInstrumentation(instrumentation);
+  montage->Update();
+
+  itk::SizeValueType lowInformationPairs = 0;
+  for (itk::SizeValueType p = 0; p < montage->GetPairs().size(); p++)
+  {
+    const auto & pair = montage->GetPairs()[p];
+    if (montage->IsLowInformationPair(p) != (isBlank(pair.first) || isBlank(pair.second)))
+    {
+      std::cerr << "Pair " << pair.first << "-" << pair.second << " has wrong low information status" << std::endl;
+      return EXIT_FAILURE;
+    }
+    lowInformationPairs += montage->IsLowInformationPair(p);
+  }
+  if (lowInformationPairs != 5 || instrumentation->GetCounter(CounterEnum::LowInformationPairs) != 5 ||
+      instrumentation->GetCounter(CounterEnum::PairsRegistered) != 7)
+  {
+    std::cerr << "Expected 5 low information pairs and 7 registered ones" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto stage = generator->GetStageConfiguration();
+  const auto truth = generator->GetTrueConfiguration();
+  for (itk::SizeValueType t = 0; t < stage.LinearSize(); t++)
+  {
+    const auto offset = montage->GetOutputTransform(stage.LinearIndexToNDIndex(t))->GetOffset();
+    if (isBlank(t)) // follows its textured neighbor
+    {
+      const auto neighborOffset = montage->GetOutputTransform(stage.LinearIndexToNDIndex(t - 1))->GetOffset();
+      if ((offset - neighborOffset).GetNorm() > 0.5)
+      {
+        std::cerr << "Blank tile " << t << " has translation " << offset << " instead of " << neighborOffset
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    if (!checkTranslation(offset, expectedTranslation(stage, truth, t), 1.0, "Textured tile " + std::to_string(t)))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
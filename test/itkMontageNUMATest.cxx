@@ -0,0 +1,97 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMontageNUMA.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+
+// NUMA-aware scheduling changes where work runs, not its results
+int
+itkMontageNUMATest(int, char *[])
+{
+  const unsigned nodes = itk::MontageNUMA::GetNumberOfNodes();
+  for (itk::SizeValueType t = 0; t < 10; t++)
+  {
+    if (itk::MontageNUMA::GetItemNode(t, 10) >= nodes)
+    {
+      std::cerr << "Tile " << t << " was assigned to node " << itk::MontageNUMA::GetItemNode(t, 10) << " of " << nodes
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  {
+    itk::MontageNUMA::ScopedNodeAffinity unbound(-1);
+    if (unbound.IsBound())
+    {
+      std::cerr << "Negative node should not bind the thread" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 4, 3 } });
+  generator->SetAmplitude(4000);
+
+  // tiles are read and preprocessed by registration jobs, which must run on the CPUs of their node
+  std::atomic<unsigned> misplaced(0);
+  MontageType::Pointer  montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->NUMAAwareOn();
+  montage->SetTilePreprocessor([nodes, &misplaced](ImageType * tile, itk::SizeValueType) {
+    const int node = itk::MontageNUMA::GetBoundNode(); // binding can fail, e.g. within a restrictive cpuset
+    if (nodes < 2 && node >= 0)
+    {
+      ++misplaced;
+    }
+#if defined(__linux__)
+    else if (node >= 0)
+    {
+      const std::vector<unsigned> cpus = itk::MontageNUMA::GetNodeCPUs(node);
+      if (std::find(cpus.begin(), cpus.end(), static_cast<unsigned>(sched_getcpu())) == cpus.end())
+      {
+        ++misplaced;
+      }
+    }
+#endif
+    return ImageType::Pointer(tile);
+  });
+  montage->Update();
+  if (misplaced > 0)
+  {
+    std::cerr << misplaced.load() << " tiles were preprocessed outside of their job's node, of " << nodes
+              << " nodes" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return checkTranslations(montage, generator, 1.0, "NUMA-aware montage") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
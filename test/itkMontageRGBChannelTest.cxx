@@ -0,0 +1,162 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageRegionIterator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkMontageInstrumentation.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkRGBPixel.h"
+#include "itkTestingMacros.h"
+#include "itkTileMontage.h"
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+// registers two overlapping RGB tiles cut out of the same random image
+// the tiles are at their expected positions, so no translation should be found
+int
+rgbMontageTest(int channel)
+{
+  constexpr unsigned Dimension = 2;
+  using PixelType = itk::RGBPixel<unsigned char>;
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using RoIType = itk::RegionOfInterestImageFilter<ImageType, ImageType>;
+  using RandomType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+
+  RandomType::Pointer rng = RandomType::New();
+  rng->SetSeed(1983);
+  ImageType::Pointer    whole = ImageType::New();
+  ImageType::RegionType wholeRegion({ { 0, 0 } }, { { 112, 64 } });
+  whole->SetRegions(wholeRegion);
+  whole->Allocate();
+  itk::ImageRegionIterator<ImageType> it(whole, wholeRegion);
+  for (; !it.IsAtEnd(); ++it)
+  {
+    PixelType p;
+    for (unsigned c = 0; c < 3; c++)
+    {
+      p[c] = rng->GetIntegerVariate(255);
+    }
+    it.Set(p);
+  }
+
+  MontageType::Pointer montage = MontageType::New();
+  ITK_TEST_SET_GET_VALUE(-1, montage->GetRegistrationChannel());
+  ITK_TRY_EXPECT_EXCEPTION(montage->SetRegistrationChannel(3)); // RGB has only channels 0..2
+  ITK_TEST_SET_GET_VALUE(-1, montage->GetRegistrationChannel());
+  montage->SetRegistrationChannel(channel);
+  ITK_TEST_SET_GET_VALUE(channel, montage->GetRegistrationChannel());
+  montage->SetMontageSize({ { 2, 1 } });
+  for (unsigned t = 0; t < 2; t++)
+  {
+    RoIType::Pointer roi = RoIType::New();
+    roi->SetInput(whole);
+    const ImageType::IndexType tileStart = { { static_cast<itk::IndexValueType>(48 * t), 0 } };
+    roi->SetRegionOfInterest(ImageType::RegionType(tileStart, { { 64, 64 } }));
+    roi->Update();
+    montage->SetInputTile(t, roi->GetOutput());
+  }
+  std::atomic<unsigned> preprocessed(0);
+  montage->SetTilePreprocessor([&preprocessed](ImageType * tile, itk::SizeValueType) {
+    ++preprocessed;
+    return ImageType::Pointer(tile);
+  });
+  using InstrumentationType = itk::MontageInstrumentation;
+  InstrumentationType::Pointer instrumentation = InstrumentationType::New();
+  montage->SetInstrumentation(instrumentation);
+  const InstrumentationType::MemoryBytes estimate = montage->EstimatePeakMemoryUsage();
+  montage->Update();
+  if (preprocessed != 2)
+  {
+    std::cerr << "Tile preprocessor was invoked " << preprocessed << " times instead of once per tile" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  using StageEnum = InstrumentationType::StageEnum;
+  using CounterEnum = InstrumentationType::CounterEnum;
+  for (StageEnum stage : { StageEnum::TilePreprocessing,
+                           StageEnum::Padding,
+                           StageEnum::ForwardFFT,
+                           StageEnum::Operator,
+                           StageEnum::InverseFFT,
+                           StageEnum::PeakSearch,
+                           StageEnum::GlobalSolve })
+  {
+    if (instrumentation->GetStageStatistics(stage).count == 0)
+    {
+      std::cerr << "Instrumentation did not time " << stage << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (instrumentation->GetCounter(CounterEnum::PairsRegistered) != 1 ||
+      instrumentation->GetPairRecords().size() != 1 || instrumentation->GetCounter(CounterEnum::TilesRead) != 0)
+  {
+    std::cerr << "Unexpected instrumentation counters:" << std::endl;
+    instrumentation->Print(std::cerr);
+    return EXIT_FAILURE;
+  }
+  using MemoryCategoryEnum = InstrumentationType::MemoryCategoryEnum;
+  for (MemoryCategoryEnum category :
+       { MemoryCategoryEnum::RegistrationBuffers, MemoryCategoryEnum::CorrelationSurface })
+  {
+    const auto c = static_cast<unsigned>(category);
+    if (estimate[c] == 0 || instrumentation->GetMemoryHighWaterMarks()[c] == 0 ||
+        instrumentation->GetMemoryInUse()[c] != 0)
+    {
+      std::cerr << "Unexpected accounting of " << category << " memory:" << std::endl;
+      instrumentation->Print(std::cerr);
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostringstream json;
+  instrumentation->WriteJSON(json);
+  if (json.str().find("\"PeakSearch\"") == std::string::npos)
+  {
+    std::cerr << "Instrumentation JSON is missing stages:" << std::endl << json.str();
+    return EXIT_FAILURE;
+  }
+
+  const auto offset = montage->GetOutputTransform({ { 1, 0 } })->GetOffset();
+  if (offset.GetNorm() > 0.5)
+  {
+    std::cerr << "RGB montage with registration channel " << channel << " has unexpected translation " << offset
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+} // namespace
+
+// multi-component tiles are registered without a scalar copy
+int
+itkMontageRGBChannelTest(int, char *[])
+{
+  int result = EXIT_SUCCESS;
+  for (int channel : { -1, 1 })
+  {
+    if (rgbMontageTest(channel) == EXIT_FAILURE)
+    {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,96 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkPhaseCorrelationImageRegistrationMethod.h"
+#include "itkPhaseCorrelationOptimizer.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTestingMacros.h"
+#include <iostream>
+#include <string>
+
+// with a position tolerance, only a window of the correlation surface is computed and searched
+int
+itkMontageSearchWindowTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using PCMType = itk::PhaseCorrelationImageRegistrationMethod<ImageType, ImageType>;
+  using OptimizerType = itk::PhaseCorrelationOptimizer<float, Dimension>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 2, 1 } });
+  generator->SetTileSize({ { 256, 256 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.3);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(1000);
+  const GeneratorType::TileSourceType source = generator->GetTileSource();
+  const ImageType::Pointer            fixed = source(0, false, ImageType::RegionType());
+  const ImageType::Pointer            moving = source(1, false, ImageType::RegionType());
+
+  const auto expected = expectedTranslation(generator->GetStageConfiguration(), generator->GetTrueConfiguration(), 1);
+
+  PCMType::OffsetVector offsets[2];
+  for (bool prune : { false, true })
+  {
+    OptimizerType::Pointer optimizer = OptimizerType::New();
+    optimizer->SetPixelDistanceTolerance(2);
+    PCMType::Pointer pcm = PCMType::New();
+    pcm->SetOptimizer(optimizer);
+    pcm->SetFixedImage(fixed);
+    pcm->SetMovingImage(moving);
+    pcm->SetFFTBackend(PCMType::FFTBackendEnum::VNL); // the pruned transform is VNL's
+    ITK_TEST_SET_GET_VALUE(false, pcm->GetPruneInverseFFT()); // the whole surface is computed by default
+    pcm->SetPruneInverseFFT(prune);
+    pcm->Update();
+
+    const ImageType::RegionType surface = pcm->GetPhaseCorrelationImage()->GetLargestPossibleRegion();
+    const itk::SizeValueType    windowPixels = optimizer->GetSearchWindow().GetNumberOfPixels();
+    const itk::SizeValueType    surfacePixels = surface.GetNumberOfPixels();
+    if (optimizer->GetAdjustedInput()->GetBufferedRegion().GetNumberOfPixels() != windowPixels ||
+        windowPixels >= surfacePixels)
+    {
+      std::cerr << "Search window of " << windowPixels << " pixels is not smaller than the surface of " << surfacePixels
+                << " pixels, or it is not the only searched part" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const bool surfaceComputed = pcm->GetPhaseCorrelationImage()->GetBufferPointer() != nullptr;
+    if (surfaceComputed == prune)
+    {
+      std::cerr << "The whole correlation surface is " << (surfaceComputed ? "" : "not ")
+                << "computed when pruning is " << (prune ? "enabled" : "disabled") << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    offsets[prune] = pcm->GetOffsets();
+    const std::string label = std::string("Registration ") + (prune ? "with" : "without") + " pruning put tile 1";
+    if (!checkTranslation(offsets[prune][0], expected, 1.0, label))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (offsets[0][0].EuclideanDistanceTo(offsets[1][0]) > 0.01)
+  {
+    std::cerr << "Pruning moved the peak from " << offsets[0][0] << " to " << offsets[1][0] << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
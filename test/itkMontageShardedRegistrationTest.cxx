@@ -0,0 +1,104 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTestingMacros.h"
+#include "itkTileMontage.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// registers shards separately, as separate processes would, then optimizes positions once
+int
+itkMontageShardedRegistrationTest(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <outputDirectory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string outputDirectory = argv[1];
+
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  constexpr unsigned numberOfShards = 3;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 4, 3 } });
+  generator->SetAmplitude(4000);
+
+  std::vector<std::string> shardFilenames;
+  std::vector<char>        pairCovered;
+  for (unsigned shard = 0; shard < numberOfShards; shard++)
+  {
+    shardFilenames.push_back(outputDirectory + "/shard_" + std::to_string(shard) + ".txt");
+    MontageType::Pointer montage = MontageType::New();
+    montage->SetMontageSize(generator->GetMontageSize());
+    montage->SetTileSource(generator->GetTileSource());
+    montage->RegisterShard(shard, numberOfShards, shardFilenames.back());
+
+    pairCovered.resize(montage->GetPairs().size(), 0);
+    for (itk::SizeValueType p : montage->GetShardPairs(shard, numberOfShards))
+    {
+      if (pairCovered[p]++)
+      {
+        std::cerr << "Pair " << p << " is in more than one shard" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  if (std::count(pairCovered.begin(), pairCovered.end(), 1) != static_cast<std::ptrdiff_t>(pairCovered.size()))
+  {
+    std::cerr << "Shards do not cover all the pairs" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // shards are spatial blocks of tiles: with 4 shards, 2 x 2 blocks of the 4 x 3 grid
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->RegisterShard(0, 4, outputDirectory + "/block_shard_0.txt");
+  for (unsigned shard = 0; shard < 4; shard++)
+  {
+    for (itk::SizeValueType p : montage->GetShardPairs(shard, 4))
+    {
+      const auto &             pair = montage->GetPairs()[p];
+      const auto               tile = std::max(pair.first, pair.second);
+      const itk::SizeValueType block = (tile % 4) / 2 + 2 * ((tile / 4) / 2);
+      if (block != shard)
+      {
+        std::cerr << "Pair " << p << " completed by tile " << tile << " is in shard " << shard << " instead of "
+                  << block << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  ITK_TRY_EXPECT_EXCEPTION(montage->ReadShards({ shardFilenames[0], shardFilenames[2] })); // shard 1 is missing
+  montage->ReadShards(shardFilenames);
+  montage->Update();
+
+  return checkTranslations(montage, generator, 1.0, "Sharded registration") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkMontageInstrumentation.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+// cheap registration of all pairs, followed by full registration of the ambiguous ones
+int
+itkMontageTieredRegistrationTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using CounterEnum = itk::MontageInstrumentation::CounterEnum;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 4, 4 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.25);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(4000);
+  generator->SetNoiseAmplitude(200);
+
+  itk::MontageInstrumentation::Pointer instrumentation = itk::MontageInstrumentation::New();
+  MontageType::Pointer                 montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->TieredRegistrationOn();
+  montage->SetInstrumentation(instrumentation);
+  std::vector<std::atomic<unsigned>> preprocessed(generator->GetLinearMontageSize()); // zero-initialized
+  montage->SetTilePreprocessor([&preprocessed](ImageType * tile, itk::SizeValueType t) {
+    ++preprocessed[t];
+    return ImageType::Pointer(tile);
+  });
+  montage->Update();
+
+  for (itk::SizeValueType t = 0; t < preprocessed.size(); t++)
+  {
+    if (preprocessed[t] != 1) // escalation must reuse the preprocessed tile
+    {
+      std::cerr << "Tile " << t << " was preprocessed " << preprocessed[t].load() << " times" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const itk::SizeValueType pairs = montage->GetPairs().size();
+  const itk::SizeValueType escalated = instrumentation->GetCounter(CounterEnum::PairsEscalated);
+  if (escalated > pairs || instrumentation->GetCounter(CounterEnum::PairsRegistered) != pairs + escalated)
+  {
+    std::cerr << escalated << " of " << pairs << " pairs were escalated, and "
+              << instrumentation->GetCounter(CounterEnum::PairsRegistered) << " registrations done" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return checkTranslations(montage, generator, 1.0, "Tiered registration") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkPhaseCorrelationImageRegistrationMethod.h"
+#include "itkPhaseCorrelationOptimizer.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// a position tolerance limits overlap expansion, unless the peak ends up near the edge of the reduced overlap
+int
+itkMontageToleranceCropTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using PCMType = itk::PhaseCorrelationImageRegistrationMethod<ImageType, ImageType>;
+  using OptimizerType = itk::PhaseCorrelationOptimizer<float, Dimension>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 2, 1 } });
+  generator->SetTileSize({ { 256, 256 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.3);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(1000);
+
+  // surface size, and whether the translation was found
+  auto registerPair = [&](itk::SizeValueType tolerance, ImageType::SizeType & surfaceSize) {
+    const GeneratorType::TileSourceType source = generator->GetTileSource();
+
+    OptimizerType::Pointer optimizer = OptimizerType::New();
+    optimizer->SetPixelDistanceTolerance(tolerance);
+    PCMType::Pointer pcm = PCMType::New();
+    pcm->SetOptimizer(optimizer);
+    pcm->SetFixedImage(source(0, false, ImageType::RegionType()));
+    pcm->SetMovingImage(source(1, false, ImageType::RegionType()));
+    pcm->Update();
+    surfaceSize = pcm->GetPhaseCorrelationImage()->GetLargestPossibleRegion().GetSize();
+
+    const auto expected = expectedTranslation(generator->GetStageConfiguration(), generator->GetTrueConfiguration(), 1);
+    const std::string label = "Registration with tolerance " + std::to_string(tolerance) + " put tile 1";
+    return checkTranslation(pcm->GetOffsets()[0], expected, 1.0, label);
+  };
+
+  // jitter within the tolerance, the overlap is expanded less than usual
+  GeneratorType::ArrayType jitter;
+  jitter.Fill(1.0);
+  generator->SetJitter(jitter);
+  ImageType::SizeType usualSize, reducedSize;
+  if (!registerPair(0, usualSize) || !registerPair(2, reducedSize))
+  {
+    return EXIT_FAILURE;
+  }
+  if (reducedSize[0] >= usualSize[0])
+  {
+    std::cerr << "Tolerance did not reduce correlation surface size " << usualSize << ", got " << reducedSize
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // jitter beyond the reduced overlap expansion, registration falls back to the usual expansion
+  jitter.Fill(4.0);
+  generator->SetJitter(jitter);
+  for (uint64_t seed = 0; seed < 16; seed++)
+  {
+    generator->SetSeed(seed);
+    const auto stage = generator->GetStageConfiguration();
+    const auto truth = generator->GetTrueConfiguration();
+    const double shift = (stage.Tiles[1].Position[0] - truth.Tiles[1].Position[0]) -
+                         (stage.Tiles[0].Position[0] - truth.Tiles[0].Position[0]);
+    if (std::abs(shift) < 3.0) // tolerance 1 expands the overlap by 2 pixels
+    {
+      continue;
+    }
+
+    ImageType::SizeType fallbackSize;
+    if (!registerPair(1, fallbackSize))
+    {
+      return EXIT_FAILURE;
+    }
+    if (fallbackSize != usualSize)
+    {
+      std::cerr << "Translation of " << shift << " pixels did not fall back to the usual surface size " << usualSize
+                << ", got " << fallbackSize << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  std::cerr << "None of the seeds produced a translation large enough to test the fallback" << std::endl;
+  return EXIT_FAILURE;
+}
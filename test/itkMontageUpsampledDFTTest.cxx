@@ -0,0 +1,49 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkPhaseCorrelationOptimizer.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTileMontage.h"
+
+// sub-pixel peak refinement via a locally upsampled inverse DFT
+int
+itkMontageUpsampledDFTTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<float, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using PeakInterpolationEnum = itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 2 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.3);
+  generator->SetOverlap(overlap);
+  generator->SetAmplitude(1000);
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->SetPeakInterpolationMethod(PeakInterpolationEnum::UpsampledDFT);
+  montage->SetUpsamplingFactor(20);
+  montage->Update();
+
+  return checkTranslations(montage, generator, 0.5, "UpsampledDFT") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
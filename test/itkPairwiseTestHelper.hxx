@@ -111,6 +111,7 @@ calculateError(const itk::TileConfiguration<Dimension> &
     itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::Parabolic,
     itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::Cosine,
     itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::WeightedMeanPhase,
+    itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::UpsampledDFT,
   };
 
   for (auto peakMethod : interpolationMethods)
@@ -240,6 +241,7 @@ pairwiseTests(const itk::TileConfiguration<Dimension> & stageTiles,
       itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::Parabolic,
       itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::Cosine,
       itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::WeightedMeanPhase,
+      itk::PhaseCorrelationOptimizerEnums::PeakInterpolationMethod::UpsampledDFT,
     };
     for (auto m : interpolationMethods)
     {
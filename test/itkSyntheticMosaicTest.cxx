@@ -0,0 +1,94 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkSyntheticMosaicTestHelper.hxx"
+#include "itkTestingMacros.h"
+#include "itkTileMergeImageFilter.h"
+#include "itkTileMontage.h"
+#include <iostream>
+
+// montages a lazily generated mosaic, and compares the result to the known positions
+int
+itkSyntheticMosaicTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MontageType = itk::TileMontage<ImageType>;
+  using MergeType = itk::TileMergeImageFilter<ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(generator, SyntheticMosaicGenerator, Object);
+  generator->SetMontageSize({ { 3, 3 } });
+  generator->SetTileSize({ { 64, 64 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.25);
+  generator->SetOverlap(overlap);
+  GeneratorType::ArrayType jitter;
+  jitter.Fill(3.0);
+  generator->SetJitter(jitter);
+  generator->SetAmplitude(4000);
+
+  // tiles are reproducible, and partial tiles match the whole ones
+  ImageType::RegionType       reg0;
+  ImageType::Pointer          whole = generator->GenerateTile(4, false, reg0);
+  const ImageType::RegionType part({ { 10, 20 } }, { { 30, 5 } });
+  ImageType::Pointer          partial = generator->GenerateTile(4, false, part);
+  const ImageType::IndexType  probe = { { 25, 22 } };
+  if (partial->GetBufferedRegion() != part || partial->GetPixel(probe) != whole->GetPixel(probe) ||
+      generator->GenerateTile(4, false, reg0)->GetPixel(probe) != whole->GetPixel(probe))
+  {
+    std::cerr << "Synthetic tiles are not reproducible" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  MontageType::Pointer montage = MontageType::New();
+  montage->SetMontageSize(generator->GetMontageSize());
+  montage->SetTileSource(generator->GetTileSource());
+  montage->Update();
+
+  if (!checkTranslations(montage, generator, 1.0, "Synthetic mosaic registration"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  MergeType::Pointer merge = MergeType::New();
+  merge->SetMontage(montage);
+  merge->Update();
+  if (merge->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels() == 0)
+  {
+    std::cerr << "Synthetic mosaic was not merged" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // outliers are injected at the requested rate
+  generator->SetMontageSize({ { 100, 100 } });
+  generator->SetOutlierFraction(0.1);
+  itk::SizeValueType outliers = 0;
+  for (itk::SizeValueType t = 0; t < generator->GetLinearMontageSize(); t++)
+  {
+    outliers += generator->IsOutlier(t);
+  }
+  if (outliers < 800 || outliers > 1200)
+  {
+    std::cerr << "Unexpected number of outliers: " << outliers << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkSyntheticMosaicTestHelper_hxx
+#define itkSyntheticMosaicTestHelper_hxx
+
+#include "itkIntTypes.h"
+#include "itkSmartPointer.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+
+// translation which registration should find for tile t relative to the anchor tile, undoing the generated jitter
+template <typename TConfiguration>
+typename TConfiguration::PointType::VectorType
+expectedTranslation(const TConfiguration & stage,
+                    const TConfiguration & truth,
+                    itk::SizeValueType     t,
+                    itk::SizeValueType     anchor = 0)
+{
+  return (stage.Tiles[t].Position - truth.Tiles[t].Position) -
+         (stage.Tiles[anchor].Position - truth.Tiles[anchor].Position);
+}
+
+// label describes what was put where, e.g. "Tiered registration put tile 3"
+template <typename TOffset, typename TExpected>
+bool
+checkTranslation(const TOffset & offset, const TExpected & expected, double tolerance, const std::string & label)
+{
+  for (unsigned d = 0; d < TExpected::Dimension; d++)
+  {
+    if (std::abs(offset[d] - expected[d]) > tolerance)
+    {
+      std::cerr << label << " at translation " << offset << " instead of " << expected << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// compares the translations of all the montage's tiles to the generated jitter, relative to the first tile.
+// Tiles from notAcquired on have not been registered, and must keep their stage positions.
+template <typename TMontage, typename TGenerator>
+bool
+checkTranslations(const itk::SmartPointer<TMontage> &   montage,
+                  const itk::SmartPointer<TGenerator> & generator,
+                  double                                tolerance,
+                  const std::string &                   label,
+                  itk::SizeValueType                    notAcquired = std::numeric_limits<itk::SizeValueType>::max())
+{
+  const auto stage = generator->GetStageConfiguration();
+  const auto truth = generator->GetTrueConfiguration();
+  for (itk::SizeValueType t = 0; t < stage.LinearSize(); t++)
+  {
+    auto expected = expectedTranslation(stage, truth, t);
+    if (t >= notAcquired)
+    {
+      expected.Fill(0.0);
+    }
+    const auto offset = montage->GetOutputTransform(stage.LinearIndexToNDIndex(t))->GetOffset();
+    if (!checkTranslation(offset, expected, tolerance, label + " put tile " + std::to_string(t)))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif // itkSyntheticMosaicTestHelper_hxx
@@ -0,0 +1,114 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkTileConfiguration.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// text and binary tile configurations are read back exactly
+int
+itkTileConfigurationTest(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <outputDirectory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string outputDirectory = argv[1];
+
+  using TileConfig = itk::TileConfiguration<3>;
+  TileConfig written;
+  written.AxisSizes = { { 3, 2, 2 } };
+  written.Tiles.resize(written.LinearSize());
+  for (size_t t = 0; t < written.Tiles.size(); t++)
+  {
+    written.Tiles[t].FileName = "tile_" + std::to_string(t) + ".nrrd";
+    const TileConfig::TileIndexType ind = written.LinearIndexToNDIndex(t);
+    for (unsigned d = 0; d < 3; d++)
+    {
+      written.Tiles[t].Position[d] = ind[d] * 100.0 / 3.0 + 0.1 * d;
+    }
+  }
+
+  for (const std::string extension : { ".txt", ".bin" })
+  {
+    const std::string filename = outputDirectory + "/TileConfiguration" + extension;
+    if (extension == ".txt")
+    {
+      written.Write(filename);
+    }
+    else
+    {
+      written.WriteBinary(filename);
+    }
+
+    unsigned dimension = 0;
+    if (TileConfig::TryParse(filename, dimension) != written.Tiles[0].FileName || dimension != 3)
+    {
+      std::cerr << "TryParse failed for " << filename << std::endl;
+      return EXIT_FAILURE;
+    }
+    TileConfig read;
+    read.Parse(filename);
+    if (read.AxisSizes != written.AxisSizes || read.Tiles.size() != written.Tiles.size())
+    {
+      std::cerr << "Axis sizes " << read.AxisSizes << " read from " << filename << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (size_t t = 0; t < written.Tiles.size(); t++)
+    {
+      if (read.Tiles[t].FileName != written.Tiles[t].FileName || read.Tiles[t].Position != written.Tiles[t].Position)
+      {
+        std::cerr << "Tile " << t << " read from " << filename << " differs" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // once the first slice establishes the grid, positions of the later tiles do not affect their indices
+  const std::string jitteredFilename = outputDirectory + "/TileConfigurationJittered.txt";
+  written.Tiles[10].Position[1] += 60.0; // moved further along y than along x from the previous tile
+  written.Write(jitteredFilename);
+  TileConfig jittered;
+  jittered.Parse(jitteredFilename);
+  if (jittered.AxisSizes != written.AxisSizes)
+  {
+    std::cerr << "Axis sizes " << jittered.AxisSizes << " read from " << jitteredFilename << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // axis sizes whose product overflows are rejected instead of wrapping around
+  const std::string corruptedFilename = outputDirectory + "/TileConfigurationCorrupted.bin";
+  written.AxisSizes = { { 1ull << 22, 1ull << 21, 1ull << 21 } };
+  written.Tiles.resize(1);
+  written.WriteBinary(corruptedFilename);
+  TileConfig corrupted;
+  try
+  {
+    corrupted.Parse(corruptedFilename);
+    std::cerr << "Axis sizes " << corrupted.AxisSizes << " read from " << corruptedFilename << std::endl;
+    return EXIT_FAILURE;
+  }
+  catch (const std::runtime_error &)
+  {
+    // expected
+  }
+
+  return EXIT_SUCCESS;
+}
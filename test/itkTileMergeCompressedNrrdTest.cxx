@@ -0,0 +1,155 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkRGBAPixel.h"
+#include "itkRGBPixel.h"
+#include "itkTileMergeImageFilter.h"
+#include <iostream>
+#include <string>
+
+namespace
+{
+// merges two blank tiles into a compressed NRRD file, and returns the pixel type ImageIO reads from it
+template <typename TPixel>
+itk::IOPixelEnum
+compressedNrrdPixelType(const std::string & fileName)
+{
+  using ImageType = itk::Image<TPixel, 2>;
+  using MergeType = itk::TileMergeImageFilter<ImageType>;
+
+  typename MergeType::Pointer merge = MergeType::New();
+  merge->SetMontageSize({ { 2, 1 } });
+  for (unsigned t = 0; t < 2; t++)
+  {
+    typename ImageType::Pointer tile = ImageType::New();
+    tile->SetRegions(typename ImageType::SizeType{ { 8, 8 } });
+    typename ImageType::PointType origin;
+    origin[0] = 6.0 * t;
+    origin[1] = 0.0;
+    tile->SetOrigin(origin);
+    tile->Allocate(true);
+    merge->SetInputTile(t, tile);
+    typename MergeType::TransformPointer identity = MergeType::TransformType::New();
+    merge->SetTileTransform({ { t, 0 } }, identity);
+  }
+  merge->WriteCompressedNrrd(fileName);
+
+  itk::ImageIOBase::Pointer io = itk::ImageIOFactory::CreateImageIO(fileName.c_str(), itk::IOFileModeEnum::ReadMode);
+  io->SetFileName(fileName);
+  io->ReadImageInformation();
+  return io->GetPixelType();
+}
+} // namespace
+
+// merges two overlapping tiles of a random image into a compressed NRRD file, slab by slab,
+// and compares the file to the original image
+int
+itkTileMergeCompressedNrrdTest(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <outputDirectory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string outputPath = argv[1];
+
+  constexpr unsigned Dimension = 2;
+  using PixelType = unsigned short;
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using MergeType = itk::TileMergeImageFilter<ImageType, double>;
+  using RoIType = itk::RegionOfInterestImageFilter<ImageType, ImageType>;
+  using RandomType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+
+  RandomType::Pointer rng = RandomType::New();
+  rng->SetSeed(1985);
+  ImageType::Pointer    whole = ImageType::New();
+  ImageType::RegionType wholeRegion({ { 0, 0 } }, { { 101, 67 } });
+  whole->SetRegions(wholeRegion);
+  ImageType::SpacingType spacing;
+  spacing[0] = 0.5;
+  spacing[1] = 2.0;
+  whole->SetSpacing(spacing);
+  ImageType::PointType origin;
+  origin[0] = -3.0;
+  origin[1] = 7.5;
+  whole->SetOrigin(origin);
+  whole->Allocate();
+  itk::ImageRegionIterator<ImageType> it(whole, wholeRegion);
+  for (; !it.IsAtEnd(); ++it)
+  {
+    it.Set(rng->GetIntegerVariate(4095));
+  }
+
+  MergeType::Pointer merge = MergeType::New();
+  merge->SetMontageSize({ { 2, 1 } });
+  for (unsigned t = 0; t < 2; t++)
+  {
+    RoIType::Pointer roi = RoIType::New();
+    roi->SetInput(whole);
+    const ImageType::IndexType tileStart = { { static_cast<itk::IndexValueType>(40 * t), 0 } };
+    roi->SetRegionOfInterest(ImageType::RegionType(tileStart, { { 64 - 3 * t, 67 } }));
+    roi->Update();
+    merge->SetInputTile(t, roi->GetOutput());
+    MergeType::TransformPointer identity = MergeType::TransformType::New();
+    merge->SetTileTransform({ { t, 0 } }, identity);
+  }
+  const std::string fileName = outputPath + "/itkMontageCompressed.nrrd";
+  merge->WriteCompressedNrrd(fileName, 10); // the last of 7 slabs is thinner
+
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fileName);
+  reader->Update();
+  ImageType::Pointer written = reader->GetOutput();
+  if (written->GetLargestPossibleRegion().GetSize() != wholeRegion.GetSize() ||
+      written->GetSpacing() != spacing || written->GetOrigin().EuclideanDistanceTo(origin) > 1e-9)
+  {
+    std::cerr << "Compressed image has size " << written->GetLargestPossibleRegion().GetSize() << ", spacing "
+              << written->GetSpacing() << " and origin " << written->GetOrigin() << " instead of "
+              << wholeRegion.GetSize() << ", " << spacing << " and " << origin << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  itk::ImageRegionConstIteratorWithIndex<ImageType> wIt(written, written->GetLargestPossibleRegion());
+  for (; !wIt.IsAtEnd(); ++wIt)
+  {
+    if (wIt.Get() != whole->GetPixel(wIt.GetIndex()))
+    {
+      std::cerr << "Compressed image differs from the original image at " << wIt.GetIndex() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // only color pixels are written as colors
+  using IOPixelEnum = itk::IOPixelEnum;
+  const std::string kindsName = outputPath + "/itkMontageCompressedKinds.nrrd";
+  if (!MergeType::CanWriteCompressedNrrd() ||
+      compressedNrrdPixelType<itk::RGBPixel<unsigned char>>(kindsName) != IOPixelEnum::RGB ||
+      compressedNrrdPixelType<itk::RGBAPixel<unsigned char>>(kindsName) != IOPixelEnum::RGBA ||
+      compressedNrrdPixelType<itk::Vector<float, 3>>(kindsName) != IOPixelEnum::VECTOR)
+  {
+    std::cerr << "Compressed NRRD files have wrong pixel kinds" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIterator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkTileMergeImageFilter.h"
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// merges two overlapping tiles of a random image into a 3-level pyramid,
+// and compares the levels to the original image and its block averages
+int
+itkTileMergePyramidTest(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <outputDirectory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string outputPath = argv[1];
+
+  constexpr unsigned Dimension = 2;
+  using PixelType = unsigned short;
+  using ImageType = itk::Image<PixelType, Dimension>;
+  using MergeType = itk::TileMergeImageFilter<ImageType, double>;
+  using RoIType = itk::RegionOfInterestImageFilter<ImageType, ImageType>;
+  using RandomType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+
+  RandomType::Pointer rng = RandomType::New();
+  rng->SetSeed(1984);
+  ImageType::Pointer    whole = ImageType::New();
+  ImageType::RegionType wholeRegion({ { 0, 0 } }, { { 101, 67 } }); // odd sizes exercise partial blocks
+  whole->SetRegions(wholeRegion);
+  whole->Allocate();
+  itk::ImageRegionIterator<ImageType> it(whole, wholeRegion);
+  for (; !it.IsAtEnd(); ++it)
+  {
+    it.Set(rng->GetIntegerVariate(4095));
+  }
+
+  MergeType::Pointer merge = MergeType::New();
+  merge->SetMontageSize({ { 2, 1 } });
+  for (unsigned t = 0; t < 2; t++)
+  {
+    RoIType::Pointer roi = RoIType::New();
+    roi->SetInput(whole);
+    const ImageType::IndexType tileStart = { { static_cast<itk::IndexValueType>(40 * t), 0 } };
+    roi->SetRegionOfInterest(ImageType::RegionType(tileStart, { { 64 - 3 * t, 67 } }));
+    roi->Update();
+    merge->SetInputTile(t, roi->GetOutput());
+    MergeType::TransformPointer identity = MergeType::TransformType::New();
+    merge->SetTileTransform({ { t, 0 } }, identity);
+  }
+  const std::string prefix = outputPath + "/itkMontagePyramid_";
+  merge->WriteMultiResolutionPyramid(prefix, 3, 10); // thickness is rounded up to 12
+
+  auto readLevel = [&prefix](unsigned level) {
+    ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(prefix + std::to_string(level) + ".mha");
+    reader->Update();
+    return ImageType::Pointer(reader->GetOutput());
+  };
+  ImageType::Pointer level0 = readLevel(0);
+  ImageType::Pointer level1 = readLevel(1);
+  ImageType::Pointer level2 = readLevel(2);
+  const ImageType::SizeType expectedSize2 = { { 26, 17 } };
+  if (level0->GetLargestPossibleRegion().GetSize() != wholeRegion.GetSize() ||
+      level2->GetLargestPossibleRegion().GetSize() != expectedSize2)
+  {
+    std::cerr << "Pyramid levels have unexpected sizes: " << level0->GetLargestPossibleRegion().GetSize() << " and "
+              << level2->GetLargestPossibleRegion().GetSize() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  itk::ImageRegionConstIteratorWithIndex<ImageType> l1It(level1, level1->GetLargestPossibleRegion());
+  for (; !l1It.IsAtEnd(); ++l1It)
+  {
+    double     sum = 0.0;
+    unsigned   count = 0;
+    const auto ind = l1It.GetIndex();
+    for (unsigned n = 0; n < 4; n++)
+    {
+      ImageType::IndexType wInd = { { 2 * ind[0] + (n & 1), 2 * ind[1] + (n >> 1) } };
+      if (wholeRegion.IsInside(wInd))
+      {
+        if (level0->GetPixel(wInd) != whole->GetPixel(wInd))
+        {
+          std::cerr << "Pyramid level 0 differs from the original image at " << wInd << std::endl;
+          return EXIT_FAILURE;
+        }
+        sum += whole->GetPixel(wInd);
+        ++count;
+      }
+    }
+    if (l1It.Get() != static_cast<PixelType>(std::round(sum / count)))
+    {
+      std::cerr << "Pyramid level 1 has " << l1It.Get() << " instead of " << sum / count << " at " << ind << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // partial blocks of level 1 are weighted, so level 2 averages the original pixels, up to rounding
+  itk::ImageRegionConstIteratorWithIndex<ImageType> l2It(level2, level2->GetLargestPossibleRegion());
+  for (; !l2It.IsAtEnd(); ++l2It)
+  {
+    double     sum = 0.0;
+    unsigned   count = 0;
+    const auto ind = l2It.GetIndex();
+    for (unsigned n = 0; n < 16; n++)
+    {
+      ImageType::IndexType wInd = { { 4 * ind[0] + (n & 3), 4 * ind[1] + (n >> 2) } };
+      if (wholeRegion.IsInside(wInd))
+      {
+        sum += whole->GetPixel(wInd);
+        ++count;
+      }
+    }
+    if (std::abs(l2It.Get() - sum / count) > 1.0) // levels 1 and 2 are each rounded
+    {
+      std::cerr << "Pyramid level 2 has " << l2It.Get() << " instead of " << sum / count << " at " << ind << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // the output held only the last slab, the whole image is generated again
+  merge->Update();
+  if (merge->GetOutput()->GetBufferedRegion() != merge->GetOutput()->GetLargestPossibleRegion())
+  {
+    std::cerr << "After writing the pyramid, update buffered only " << merge->GetOutput()->GetBufferedRegion()
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
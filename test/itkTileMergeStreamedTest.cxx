@@ -0,0 +1,90 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkStreamingImageFilter.h"
+#include "itkSyntheticMosaicGenerator.h"
+#include "itkTileMergeImageFilter.h"
+#include <atomic>
+#include <iostream>
+
+// merges a synthetic mosaic in streamed requests, which should read each tile pixel once
+int
+itkTileMergeStreamedTest(int, char *[])
+{
+  constexpr unsigned Dimension = 2;
+  using ImageType = itk::Image<unsigned short, Dimension>;
+  using GeneratorType = itk::SyntheticMosaicGenerator<ImageType>;
+  using MergeType = itk::TileMergeImageFilter<ImageType>;
+  using StreamerType = itk::StreamingImageFilter<ImageType, ImageType>;
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetMontageSize({ { 3, 2 } });
+  generator->SetTileSize({ { 48, 40 } });
+  GeneratorType::ArrayType overlap;
+  overlap.Fill(0.25);
+  generator->SetOverlap(overlap);
+  const GeneratorType::TileSourceType source = generator->GetTileSource();
+
+  std::atomic<itk::SizeValueType> pixelsRead(0);
+  auto createMerge = [&]() {
+    MergeType::Pointer merge = MergeType::New();
+    merge->SetMontageSize({ { 3, 2 } });
+    merge->SetTileSource(
+      [&source, &pixelsRead](itk::SizeValueType t, bool metadataOnly, const ImageType::RegionType & region) {
+        ImageType::Pointer tile = source(t, metadataOnly, region);
+        pixelsRead += tile->GetBufferedRegion().GetNumberOfPixels();
+        return tile;
+      });
+    for (itk::SizeValueType t = 0; t < generator->GetLinearMontageSize(); t++)
+    {
+      MergeType::TransformPointer identity = MergeType::TransformType::New();
+      merge->SetTileTransform({ { t % 3, t / 3 } }, identity);
+    }
+    return merge;
+  };
+
+  MergeType::Pointer whole = createMerge();
+  whole->Update();
+
+  pixelsRead = 0;
+  MergeType::Pointer    streamed = createMerge();
+  StreamerType::Pointer streamer = StreamerType::New();
+  streamer->SetInput(streamed->GetOutput());
+  streamer->SetNumberOfStreamDivisions(7);
+  streamer->Update();
+
+  const itk::SizeValueType tilePixels = generator->GetLinearMontageSize() * 48 * 40;
+  if (pixelsRead != tilePixels)
+  {
+    std::cerr << "Streamed merge read " << pixelsRead.load() << " tile pixels instead of " << tilePixels << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ImageType::RegionType                       region = whole->GetOutput()->GetLargestPossibleRegion();
+  itk::ImageRegionConstIteratorWithIndex<ImageType> wIt(whole->GetOutput(), region);
+  for (; !wIt.IsAtEnd(); ++wIt)
+  {
+    if (wIt.Get() != streamer->GetOutput()->GetPixel(wIt.GetIndex()))
+    {
+      std::cerr << "Streamed merge differs from the whole one at " << wIt.GetIndex() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
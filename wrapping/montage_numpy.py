@@ -0,0 +1,148 @@
+# ==========================================================================
+#
+#   Copyright NumFOCUS
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#          http://www.apache.org/licenses/LICENSE-2.0.txt
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+#
+# ==========================================================================
+
+"""Montaging of tiles held in NumPy arrays, without copying them.
+
+Tiles are wrapped into ITK images with itk.image_view_from_array, which shares
+the arrays' memory via the buffer protocol, and the mosaic is returned as a view
+of the merged image's buffer (itk.array_view_from_image), which keeps the image
+alive. Tile arrays must be C-contiguous to be shared, otherwise they are copied.
+
+Positions are in index space (pixels), with axes in ITK order (x, y, z),
+while arrays have NumPy order (z, y, x). Tiles are listed in the linear order
+of the montage grid, with x varying fastest.
+
+No Python code runs during Update(), but ITK's wrappers only release the GIL
+around wrapped calls when ITK was built with ITK_PYTHON_RELEASE_GIL, as ITK Python
+packages are. Otherwise, register_arrays and merge_arrays block all other Python
+threads until they return. update_releases_gil() tells which is the case,
+so callers can run them in a worker thread, or a separate process otherwise.
+
+Example:
+
+    from itk import montage_numpy
+    transforms = montage_numpy.register_arrays(tiles, positions, (4, 3))
+    mosaic = montage_numpy.merge_arrays(tiles, positions, (4, 3), transforms)
+"""
+
+import sys
+import threading
+
+import itk
+import numpy as np
+
+_update_releases_gil = None
+
+
+def _tile_views(arrays, positions, spacing):
+    views = []
+    for array, position in zip(arrays, positions):
+        view = itk.image_view_from_array(np.ascontiguousarray(array))
+        dimension = view.GetImageDimension()
+        tile_spacing = [1.0] * dimension if spacing is None else list(spacing)
+        view.SetSpacing(tile_spacing)
+        view.SetOrigin([float(p) * s for p, s in zip(position, tile_spacing)])
+        views.append(view)
+    if len(views) == 0:
+        raise ValueError("At least one tile is required")
+    return views
+
+
+def _nd_index(linear_index, montage_size):
+    index = []
+    for size in montage_size:
+        index.append(int(linear_index % size))
+        linear_index //= size
+    return index
+
+
+def _set_tiles(process_object, montage_size, views):
+    process_object.SetMontageSize([int(s) for s in montage_size])
+    for linear_index, view in enumerate(views):
+        process_object.SetInputTile(linear_index, view)
+
+
+def register_arrays(arrays, positions, montage_size, spacing=None, number_of_work_units=0):
+    """Registers the tiles, and returns their translations as a list
+    of (x, y, z) tuples in physical units, relative to the first tile."""
+    views = _tile_views(arrays, positions, spacing)
+    montage = itk.TileMontage[type(views[0]), itk.F].New()
+    _set_tiles(montage, montage_size, views)
+    if number_of_work_units > 0:
+        montage.SetNumberOfWorkUnits(number_of_work_units)
+    montage.Update()
+
+    translations = []
+    for linear_index in range(len(views)):
+        transform = montage.GetOutputTransform(_nd_index(linear_index, montage_size))
+        translations.append(tuple(transform.GetOffset()))
+    return translations
+
+
+def merge_arrays(arrays, positions, montage_size, translations=None, spacing=None, crop_to_fill=False):
+    """Merges the tiles into a mosaic, returned as a NumPy view of the merged image.
+    Translations are as returned by register_arrays. If they are not given,
+    tiles are merged at their positions."""
+    views = _tile_views(arrays, positions, spacing)
+    dimension = views[0].GetImageDimension()
+    merge = itk.TileMergeImageFilter[type(views[0]), itk.D].New()
+    _set_tiles(merge, montage_size, views)
+    merge.SetCropToFill(crop_to_fill)
+    if translations is not None:
+        for linear_index, translation in enumerate(translations):
+            transform = itk.TranslationTransform[itk.D, dimension].New()
+            transform.SetOffset([float(t) for t in translation])
+            merge.SetTileTransform(_nd_index(linear_index, montage_size), transform)
+    merge.Update()
+    return itk.array_view_from_image(merge.GetOutput())
+
+
+def update_releases_gil():
+    """Whether other Python threads run while a wrapped Update() executes.
+
+    Determined once, by counting in a Python thread while a small mosaic is merged.
+    The switch interval is raised meanwhile, so the counting thread can only take
+    the GIL while Update() has released it."""
+    global _update_releases_gil
+    if _update_releases_gil is None:
+        tiles = [np.zeros((256, 256), dtype=np.float32)] * 2
+        views = _tile_views(tiles, [(0, 0), (192, 0)], None)
+        merge = itk.TileMergeImageFilter[type(views[0]), itk.D].New()
+        _set_tiles(merge, (2, 1), views)
+
+        count = [0]
+        done = threading.Event()
+
+        def counter():
+            while not done.is_set():
+                count[0] += 1
+
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(0.25)
+        thread = threading.Thread(target=counter)
+        try:
+            thread.start()
+            before = count[0]
+            merge.Update()
+            after = count[0]
+        finally:
+            done.set()
+            thread.join()
+            sys.setswitchinterval(interval)
+        _update_releases_gil = after > before
+    return _update_releases_gil
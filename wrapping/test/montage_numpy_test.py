@@ -0,0 +1,68 @@
+# ==========================================================================
+#
+#   Copyright NumFOCUS
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#          http://www.apache.org/licenses/LICENSE-2.0.txt
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+#
+# ==========================================================================
+
+import sys
+
+import itk
+import numpy as np
+
+sys.path.insert(0, sys.argv[1])  # wrapping directory, with montage_numpy.py
+import montage_numpy
+
+# tiles are cut from a random blocky texture at jittered positions
+rng = np.random.default_rng(1983)
+scene = np.kron(rng.random((14, 20)), np.ones((4, 4))) + 0.1 * rng.random((56, 80))
+scene = (scene / scene.max() * 60000).astype(np.uint16)
+
+montage_size = (3, 2)  # x, y
+tile_shape = (32, 32)  # y, x
+stage, truth, tiles = [], [], []
+for y in range(montage_size[1]):
+    for x in range(montage_size[0]):
+        position = (x * 16, y * 16)
+        jitter = rng.integers(-2, 3, size=2) if (x, y) != (0, 0) else np.zeros(2, dtype=int)
+        true_position = (position[0] + 2 + jitter[0], position[1] + 2 + jitter[1])
+        stage.append(position)
+        truth.append(true_position)
+        rows = slice(true_position[1], true_position[1] + tile_shape[0])
+        columns = slice(true_position[0], true_position[0] + tile_shape[1])
+        tiles.append(scene[rows, columns])
+tiles = [np.ascontiguousarray(t) for t in tiles]
+
+translations = montage_numpy.register_arrays(tiles, stage, montage_size)
+for t, translation in enumerate(translations):
+    for d in range(2):
+        expected = (stage[t][d] - truth[t][d]) - (stage[0][d] - truth[0][d])
+        if abs(translation[d] - expected) > 1.0:
+            print("Tile", t, "has translation", translation, "instead of expected", expected)
+            sys.exit(1)
+
+mosaic = montage_numpy.merge_arrays(tiles, stage, montage_size, translations)
+if mosaic.ndim != 2 or mosaic.shape[0] < tile_shape[0] or mosaic.shape[1] < tile_shape[1]:
+    print("Unexpected mosaic shape", mosaic.shape)
+    sys.exit(1)
+if mosaic.flags.owndata:
+    print("Mosaic is a copy, instead of a view of the merged image")
+    sys.exit(1)
+
+# the GIL is released during Update() only if ITK was built with ITK_PYTHON_RELEASE_GIL
+releases_gil = montage_numpy.update_releases_gil()
+if not isinstance(releases_gil, bool) or montage_numpy.update_releases_gil() != releases_gil:
+    print("GIL release check is not a stable boolean:", releases_gil)
+    sys.exit(1)
+print("Update() releases the GIL:", releases_gil)